@@ -0,0 +1,17 @@
+# Turns a SPIR-V binary into the words of a uint32_t array initializer:
+# cmake -DINPUT=<shader.spv> -DOUTPUT=<shader.spv.inc> -P embed_spirv.cmake
+
+file(READ "${INPUT}" contents HEX)
+string(LENGTH "${contents}" length)
+math(EXPR remainder "${length} % 8")
+if(length EQUAL 0 OR NOT remainder EQUAL 0)
+	message(FATAL_ERROR "${INPUT} is not SPIR-V, its size is not a multiple of 4 bytes")
+endif()
+
+# glslc writes the words in the byte order of the host, little endian on everything we build for
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " words "${contents}")
+# Eight words per line, CMake regular expressions have no {n}
+string(REPEAT "0x[0-9a-f]+u, " 8 line_pattern)
+string(REGEX REPLACE "(${line_pattern})" "\\1\n" words "${words}")
+
+file(WRITE "${OUTPUT}" "${words}\n")
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifndef GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_VULKAN
+#endif // !GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+
+#include "tfwi_vulkan_pipeline_layouts.hpp"
+#include "tfwi_vulkan_shaders.hpp"
+
+/*
+* The compute counterpart of createGraphicsPipeline: one compute shader, with
+* its descriptor set layout and push constant block taken from its
+* reflection. Compute pipelines have no render pass or fixed function
+* state, so they do not depend on the swap chain and live as long as the
+* device. The layouts belong to the PipelineLayoutCache.
+*/
+class ComputePipeline {
+public:
+	void create(
+		VkDevice device,
+		PipelineLayoutCache& layouts,
+		ShaderBinary shaderBinary,
+		const ShaderReflection& reflection);
+	void destroy();
+
+	// Binds the pipeline and the descriptor set, then pushes "pushConstants" (may be null)
+	void bind(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, const void* pushConstants) const;
+
+	// Dispatches enough workgroups of "localSize" invocations to cover "invocationCount"
+	static void dispatch(VkCommandBuffer commandBuffer, uint32_t invocationCount, uint32_t localSize);
+
+	VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+	VkPipelineLayout getPipelineLayout() const { return pipelineLayout; }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	uint32_t pushConstantSize = 0;
+};
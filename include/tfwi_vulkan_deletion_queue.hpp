@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+/*
+* Defers the destruction of Vulkan objects until the GPU is done with them.
+*
+* Every entry is tagged with the value of the frame timeline semaphore after
+* which nothing references the object anymore. Entries are destroyed in
+* submission order once the timeline has reached their value, so retiring
+* e.g. a swap chain never requires vkDeviceWaitIdle.
+*/
+class DeletionQueue {
+public:
+	typedef std::function<void()> Deleter;
+
+	void push(uint64_t retireValue, Deleter deleter);
+
+	// Runs every deleter whose retire value the timeline has reached
+	void flush(uint64_t completedValue);
+
+	// Only safe once the device is idle
+	void flushAll();
+
+	bool empty() const { return entries.empty(); }
+
+private:
+	typedef struct Entry {
+		uint64_t retireValue;
+		Deleter deleter;
+	} Entry;
+
+	std::deque<Entry> entries;
+};
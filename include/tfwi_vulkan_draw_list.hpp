@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+/*
+* A draw's sort key packs what it binds, most significant first:
+*
+*	pass (4 bits) | pipeline (12) | descriptor set (12) | mesh (12) | depth (24)
+*
+* Sorting by it groups the draws of a pass by pipeline, then by descriptor
+* set, then by mesh, so consecutive draws mostly share their state and the
+* recorder can skip the binds. Depth comes last and only orders draws which
+* bind the same things (front to back for opaque, back to front for
+* blended geometry, whichever the caller quantizes).
+*/
+typedef struct DrawKeyFields {
+	uint32_t pass;
+	uint32_t pipeline;
+	uint32_t descriptorSet;
+	uint32_t mesh;
+	uint32_t depth;
+} DrawKeyFields;
+
+// Pipeline, descriptor set and mesh ids all have 12 bits
+const uint32_t maxDrawKeyId = (1u << 12) - 1;
+
+// Throws if a field does not fit into its bits
+uint64_t encodeDrawKey(const DrawKeyFields& fields);
+DrawKeyFields decodeDrawKey(uint64_t key);
+// Maps [0, 1] (clamped) onto the 24 depth bits
+uint32_t quantizeDrawDepth(float depth);
+
+typedef struct DrawListEntry {
+	uint64_t key;
+	// Index of the draw in the caller's list
+	uint32_t draw;
+} DrawListEntry;
+
+/*
+* The draws of one frame, sorted by their keys with a least significant
+* digit radix sort: one byte per pass, stable, so draws with equal keys
+* keep the order they were added in. All eight histograms are counted in a
+* single sweep, and a byte every key has in common (e.g. the pass while
+* there is only one) costs no pass at all. Both buffers are kept, a steady
+* frame does not allocate.
+*/
+class DrawList {
+public:
+	void clear() { entries.clear(); }
+	void add(uint64_t key, uint32_t draw) { entries.push_back({ key, draw }); }
+	void sort();
+
+	const std::vector<DrawListEntry>& getEntries() const { return entries; }
+	size_t size() const { return entries.size(); }
+
+private:
+	std::vector<DrawListEntry> entries;
+	std::vector<DrawListEntry> scratch;
+};
+
+/*
+* Small ids for the handles a draw binds (pipelines, descriptor sets, vertex
+* buffers), which are too wide for the fields of a draw key. Equal handles
+* get equal ids, so the sort groups draws by what they actually bind.
+* Recreated objects come with new handles: trim() starts over once the ids
+* run out, between two sorts, so the ids of one draw list stay consistent.
+*/
+class DrawIdTable {
+public:
+	// 0 for a null handle, otherwise 1 to maxDrawKeyId; throws if one draw list binds more handles than that
+	uint32_t get(uint64_t handle);
+	void trim();
+
+private:
+	std::unordered_map<uint64_t, uint32_t> ids;
+};
+
+enum class DrawState : uint32_t {
+	Pipeline,
+	DescriptorSet,
+	VertexBuffer,
+	IndexBuffer,
+	Count
+};
+
+/*
+* Remembers what the command buffer being recorded has bound, so the
+* recorder only issues a vkCmdBind* when the state actually changes, and
+* counts the binds it issued and skipped. Independent of Vulkan: states are
+* identified by plain 64-bit ids, e.g. the handles.
+*/
+class DrawStateTracker {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// Nothing is bound, at the start of every render pass
+	void reset();
+	// True if "id" is not bound to "state" yet, the caller has to bind it then
+	bool bind(DrawState state, uint64_t id);
+	void countDraw() { drawsThisPeriod++; }
+	// A draw skipped because its pipeline (and any fallback) is still being built
+	void countWaitingDraw() { waitingDrawsThisPeriod++; }
+	void endFrame() { framesThisPeriod++; }
+
+	// Prints the average draws and binds per frame since the last report, at most once per reportPeriod
+	void report(std::ostream& out, Clock::time_point now);
+
+private:
+	static const size_t stateCount = static_cast<size_t>(DrawState::Count);
+
+	const Clock::duration reportPeriod = std::chrono::seconds(1);
+
+	std::array<uint64_t, stateCount> bound{};
+	std::array<bool, stateCount> valid{};
+
+	// Statistics of the current report period
+	Clock::time_point lastReport;
+	std::array<uint64_t, stateCount> bindsThisPeriod{};
+	std::array<uint64_t, stateCount> skippedThisPeriod{};
+	uint64_t drawsThisPeriod = 0;
+	uint64_t waitingDrawsThisPeriod = 0;
+	uint32_t framesThisPeriod = 0;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/*
+* Picks the resolution the scene is rendered at, independent of Vulkan.
+*
+* The renderer measures the GPU time of every frame with timestamps and feeds
+* it to onGpuFrameTime(). The controller scales both axes of the render
+* target by the same factor, so the pixel count (and roughly the GPU cost)
+* goes with scale^2: a frame taking twice the target would need the scale
+* divided by sqrt(2).
+*
+* Measurements arrive a few frames late and are noisy, so the controller
+* smooths them, ignores small deviations, lowers the scale faster than it
+* raises it, and waits for a frame rendered at the new scale before it
+* changes the scale again.
+*/
+class DynamicResolutionController {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// GPU time per frame to aim for, in seconds
+	void setTargetFrameTime(double seconds) { targetFrameTime = seconds; }
+	double getTargetFrameTime() const { return targetFrameTime; }
+	void setScaleRange(double minimum, double maximum);
+
+	// Measured GPU time of a frame rendered at "frameScale", in seconds
+	void onGpuFrameTime(double seconds, double frameScale);
+
+	double getScale() const { return scale; }
+	// Render size for an output size at the current scale, never 0
+	void getRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const;
+
+	// Prints the scale and GPU time, at most once per reportPeriod
+	void report(std::ostream& out, Clock::time_point now);
+
+private:
+	const double smoothing = 0.2;
+	// Relative deviation from the target that is left alone
+	const double deadband = 0.05;
+	// Largest relative scale change per adjustment, down and up
+	const double maxDecrease = 0.15;
+	const double maxIncrease = 0.03;
+	// Changes smaller than this are not worth a visible resolution switch
+	const double minStep = 0.01;
+	const Clock::duration reportPeriod = std::chrono::seconds(1);
+
+	double targetFrameTime = 1.0 / 60.0;
+	double minScale = 0.5;
+	double maxScale = 1.0;
+	double scale = 1.0;
+	double gpuTime = 0.0;
+
+	Clock::time_point lastReport;
+	double gpuTimeSum = 0.0;
+	uint32_t samplesThisPeriod = 0;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "tfwi_vulkan_primitives.hpp"
+
+enum class DrawPipeline : uint32_t {
+	Scene,		// The indexed quad, vertexBuffer/indexBuffer
+	Particles	// The particle points, straight from the storage buffer
+};
+
+// One draw of the scene pass
+typedef struct DrawCommand {
+	DrawPipeline pipeline;
+	uint32_t indexed;		// vkCmdDrawIndexed instead of vkCmdDraw
+	uint32_t count;			// Index or vertex count
+	uint32_t instanceCount;
+	uint32_t lod;			// Indexed scene mesh draw, at the view's level of detail instead of "count" indices
+} DrawCommand;
+
+/*
+* Everything a frame's content depends on. Live frames derive it from the
+* clock and the window, replayed frames read it back from a capture file, so
+* a replay renders exactly the frames of the captured run.
+*/
+typedef struct FrameInputs {
+	double time = 0.0;			// Seconds since the first frame, drives the animation
+	float deltaTime = 0.0f;		// Simulation step
+	uint32_t width = 0;			// Swap chain extent, a change is a resize event
+	uint32_t height = 0;
+	UniformBufferObject ubo{};
+	std::vector<DrawCommand> draws;
+} FrameInputs;
+
+/*
+* Capture files are a small header followed by one record per frame:
+*
+*	time (f64), deltaTime (f32), width (u32), height (u32),
+*	ubo (sizeof(UniformBufferObject) bytes), draw count (u32), draws
+*
+* in the byte order of the machine that wrote them. The header stores the
+* UBO size so a build with a different layout refuses old captures.
+*/
+class FrameCaptureWriter {
+public:
+	void open(const std::string& path);
+	bool isOpen() const { return file.is_open(); }
+	void write(const FrameInputs& frame);
+	void close();
+
+	uint64_t getFrameCount() const { return frameCount; }
+
+private:
+	std::ofstream file;
+	uint64_t frameCount = 0;
+};
+
+class FrameCaptureReader {
+public:
+	void open(const std::string& path);
+	bool isOpen() const { return file.is_open(); }
+	// Returns false once every frame has been read
+	bool read(FrameInputs& frame);
+
+	uint64_t getFrameCount() const { return frameCount; }
+
+private:
+	std::ifstream file;
+	std::string path;
+	uint64_t frameCount = 0;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+
+/*
+* Frame pacing and latency bookkeeping, independent of Vulkan.
+*
+* The renderer reports when input was sampled, when a frame was submitted and
+* when it retired on the GPU or was actually presented. From that the pacer
+* keeps running estimates of the CPU time (input to submit), the GPU time
+* (submit to retire) and the interval between presents.
+*
+* In low-latency mode the renderer waits for the previous frame and then
+* sleeps for getFrameStartDelay() before sampling input, so the new frame is
+* finished just before the display can take it instead of sitting in a queue.
+*/
+class FramePacer {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	/*
+	* With VK_KHR_present_wait frames complete when they are presented,
+	* otherwise when they retire on the GPU.
+	*/
+	void setPresentTimesMeasured(bool measured) { presentTimesMeasured = measured; }
+	bool arePresentTimesMeasured() const { return presentTimesMeasured; }
+
+	// How long to sleep after the previous frame completed before starting the next one
+	Clock::duration getFrameStartDelay() const;
+
+	void onInputSampled(Clock::time_point when);
+	void onSubmitted(uint64_t frameValue, Clock::time_point when);
+	// The GPU finished executing the frame
+	void onRetired(uint64_t frameValue, Clock::time_point when);
+	// The presentation engine showed the frame (only known with VK_KHR_present_wait)
+	void onPresented(uint64_t frameValue, Clock::time_point when);
+
+	// Prints the averages of the last report period, at most once per reportPeriod
+	void report(std::ostream& out, Clock::time_point now);
+
+	uint64_t getOldestPendingFrame() const;
+	bool hasPendingFrames() const { return !pending.empty(); }
+
+	// Frames still pending after a swap chain recreation will never be presented
+	void forgetPendingFrames() { pending.clear(); }
+
+private:
+	typedef struct PendingFrame {
+		uint64_t frameValue;
+		Clock::time_point submitted;
+		bool retired = false;
+	} PendingFrame;
+
+	typedef struct Accumulator {
+		double sum = 0.0;
+		uint32_t count = 0;
+
+		void add(double value) { sum += value; count++; }
+		double average() const { return count > 0 ? sum / count : 0.0; }
+	} Accumulator;
+
+	const double smoothing = 0.1;
+	const Clock::duration safetyMargin = std::chrono::milliseconds(1);
+	const Clock::duration reportPeriod = std::chrono::seconds(1);
+
+	bool presentTimesMeasured = false;
+	std::deque<PendingFrame> pending;
+	Clock::time_point inputSampled;
+	Clock::time_point lastCompletion;
+	Clock::time_point lastReport;
+
+	// Exponential moving averages, in seconds
+	double cpuTime = 0.0;
+	double gpuTime = 0.0;
+	double completionInterval = 0.0;
+
+	Accumulator inputToSubmit;
+	Accumulator submitToRetire;
+	Accumulator submitToPresent;
+	uint32_t framesThisPeriod = 0;
+
+	PendingFrame* findPending(uint64_t frameValue);
+	void onCompleted(Clock::time_point when);
+	void updateAverage(double& average, double sample) const;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifndef GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_VULKAN
+#endif // !GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+
+#include "tfwi_vulkan_frame_recorder.hpp"
+#include "tfwi_vulkan_memory_tracker.hpp"
+
+/*
+* Copies rendered frames back to the host without stalling the GPU.
+*
+* Every recorded frame copies its output image into the next slot of a ring
+* of host visible buffers which stay mapped for their whole life. Nothing
+* waits for the copy: harvest() runs once per frame and hands the slots whose
+* frame has retired on the frame timeline to the FrameRecorder, typically
+* framesInFlight frames later. With one slot more than frames in flight, a
+* slot is always harvested before the ring comes back to it.
+*
+* Slot buffers grow on demand, so a resize only reallocates the slots that
+* are reused at the new size.
+*/
+class FrameReadback {
+public:
+	// 4 byte per pixel formats only, the recorder writes 8 bit RGBA/BGRA
+	static bool isFormatSupported(VkFormat format);
+
+	void create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, DeviceMemoryTracker& memoryTracker,
+		uint32_t slotCount, FrameRecorder& recorder);
+	// The device must be idle, or every slot harvested
+	void destroy();
+
+	/*
+	* Records the copy of "image" (in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) into
+	* the next slot. "frameValue" is the frame timeline value the command
+	* buffer's submission signals.
+	*/
+	void recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent2D extent, uint64_t frameValue);
+
+	// Passes every copy of a frame up to "completedFrameValue" to the recorder, oldest frame first
+	void harvest(uint64_t completedFrameValue);
+
+	uint64_t getCopiedFrameCount() const { return copiedFrames; }
+
+private:
+	typedef struct Slot {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize capacity = 0;
+		void* mapped = nullptr;
+		// Timeline value of the frame whose copy is in flight, 0 if none
+		uint64_t frameValue = 0;
+		VkExtent2D extent = { 0, 0 };
+		bool bgra = true;
+		// Cached memory is faster to read on the host, but needs an invalidate first
+		bool coherent = false;
+	} Slot;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	DeviceMemoryTracker* memoryTracker = nullptr;
+	FrameRecorder* recorder = nullptr;
+	std::vector<Slot> slots;
+	size_t nextSlot = 0;
+	// Slot of the oldest copy not harvested yet, harvest() goes on from there
+	size_t oldestSlot = 0;
+	uint64_t copiedFrames = 0;
+
+	void resizeSlot(Slot& slot, VkDeviceSize size);
+	void releaseSlot(Slot& slot);
+};
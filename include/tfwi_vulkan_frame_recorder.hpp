@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tfwi_vulkan_logger.hpp"
+
+enum class RecordingFormat {
+	Raw,	// Every frame appended to one file, tightly packed 8 bit RGBA/BGRA rows
+	Png		// One file per frame
+};
+
+typedef struct RecordedFrame {
+	uint64_t index = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// Byte order of the pixels, the swap chain is usually BGRA
+	bool bgra = true;
+	std::vector<uint8_t> pixels;
+} RecordedFrame;
+
+/*
+* Writes read back frames to disk on a background thread, independent of
+* Vulkan.
+*
+* submit() never blocks the render loop: when the writer falls behind by more
+* than maxQueuedFrames, the frame is dropped and counted instead. Pixel
+* buffers of written frames are kept for reuse, get them with acquirePixels()
+* so steady recording does not allocate.
+*
+* Raw recordings go to "path" as long as the frame size stays the same and to
+* "path.1", "path.2"... after every resize; each can be played back with e.g.
+* ffmpeg -f rawvideo -pix_fmt bgra -s <width>x<height> -i <file>. PNG
+* recordings write "path_<frame index>.png", handy as golden images.
+*
+* A file that can't be opened or written ends the recording: the error goes
+* to the logger and every later frame is discarded, only frames which
+* reached the disk count as written.
+*/
+class FrameRecorder {
+public:
+	FrameRecorder() = default;
+	~FrameRecorder();
+	FrameRecorder(const FrameRecorder&) = delete;
+	FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+	// "logger" has to outlive the recorder
+	void open(const std::string& path, RecordingFormat format, Logger& logger);
+	bool isOpen() const { return writer.joinable(); }
+	// Writes everything still queued, then stops the writer thread
+	void close();
+
+	// Returns an empty (but possibly preallocated) pixel buffer
+	std::vector<uint8_t> acquirePixels();
+	// Returns false if the frame was dropped because the writer is behind, or discarded after a write error
+	bool submit(RecordedFrame&& frame);
+
+	uint64_t getWrittenFrameCount() const;
+	uint64_t getDroppedFrameCount() const;
+	// True once a write error stopped the recording
+	bool hasFailed() const;
+
+private:
+	const size_t maxQueuedFrames = 8;
+
+	std::string path;
+	RecordingFormat format = RecordingFormat::Raw;
+	Logger* logger = nullptr;
+
+	mutable std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::deque<RecordedFrame> queue;
+	std::vector<std::vector<uint8_t>> sparePixels;
+	bool stopping = false;
+	bool failed = false;
+	uint64_t writtenFrames = 0;
+	uint64_t droppedFrames = 0;
+	std::thread writer;
+
+	// Only touched by the writer thread
+	std::ofstream rawFile;
+	std::string rawPath;
+	uint32_t rawWidth = 0;
+	uint32_t rawHeight = 0;
+	uint32_t rawSegment = 0;
+
+	void writerLoop();
+	// Both return false and log why if the frame did not reach the disk
+	bool writeRaw(const RecordedFrame& frame);
+	bool writePng(const RecordedFrame& frame);
+};
+
+// Encodes 8 bit RGBA (or BGRA) pixels as an uncompressed PNG
+std::vector<uint8_t> encodePng(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra);
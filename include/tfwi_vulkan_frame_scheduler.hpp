@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/*
+* Decides when the render loop draws a frame, independent of Vulkan.
+*
+* Continuous mode draws back to back, as fast as the swap chain allows or
+* at most setMaxFrameRate() frames per second. In on-demand mode a frame is
+* only drawn once something invalidated the last one: input, a resize, a
+* scene edit, or the refresh timer. In between, the loop blocks in the
+* window system for getIdleTimeout() instead of spinning, so an idle window
+* costs no CPU or GPU time at all.
+*
+* While suspended (the window is minimized) no frame is ever due and the
+* loop sleeps until the window system wakes it up.
+*/
+class FrameScheduler {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	void setOnDemand(bool onDemand) { this->onDemand = onDemand; }
+	bool isOnDemand() const { return onDemand; }
+	// 0 does not limit the frame rate
+	void setMaxFrameRate(double framesPerSecond);
+	// On-demand frames are drawn at least this often, zero only draws when invalidated
+	void setRefreshInterval(Clock::duration interval) { refreshInterval = interval; }
+
+	// Something visible changed, the next frame is due right away
+	void invalidate() { invalidated = true; }
+	void setSuspended(bool suspended);
+	bool isSuspended() const { return suspended; }
+
+	bool isFrameDue(Clock::time_point now) const;
+	// How long the loop may wait for events before a frame is due, Clock::duration::max() for no limit
+	Clock::duration getIdleTimeout(Clock::time_point now) const;
+
+	/*
+	* Sleeps until the frame rate cap allows the next frame. The OS sleep
+	* overshoots by up to a scheduler tick, so it wakes up early and spins
+	* for the last spinThreshold.
+	*/
+	void waitForFrameSlot();
+	void onFrameDrawn(Clock::time_point now);
+
+	// Prints how many frames were drawn since the last report, at most once per reportPeriod
+	void report(std::ostream& out, Clock::time_point now);
+
+private:
+	const Clock::duration spinThreshold = std::chrono::microseconds(1500);
+	const Clock::duration reportPeriod = std::chrono::seconds(1);
+
+	bool onDemand = false;
+	bool invalidated = true;
+	bool suspended = false;
+	Clock::duration minFrameInterval = Clock::duration::zero();
+	Clock::duration refreshInterval = Clock::duration::zero();
+
+	Clock::time_point lastFrameSlot;
+	Clock::time_point lastFrameDrawn;
+
+	// Statistics of the current report period
+	Clock::time_point lastReport;
+	uint32_t framesThisPeriod = 0;
+};
@@ -5,13 +5,18 @@
 #include <stdexcept>
 #include <cstdlib>
 #include <cstdint>
+#include <cstddef>
+#include <cmath>
 #include <vector>
 #include <set>
+#include <map>
 #include <string>
 #include <algorithm>
 #include <optional>
 #include <fstream>
 #include <chrono>
+#include <memory>
+#include <thread>
 
 // 3rd Party Libraries
 #define GLFW_INCLUDE_VULKAN
@@ -26,4 +31,26 @@
 
 // Application Libraries
 #include "tfwi_vulkan_gfx_config.hpp"
-#include "tfwi_vulkan_primitives.hpp"
\ No newline at end of file
+#include "tfwi_vulkan_compute.hpp"
+#include "tfwi_vulkan_deletion_queue.hpp"
+#include "tfwi_vulkan_draw_list.hpp"
+#include "tfwi_vulkan_dynamic_resolution.hpp"
+#include "tfwi_vulkan_frame_capture.hpp"
+#include "tfwi_vulkan_frame_pacer.hpp"
+#include "tfwi_vulkan_frame_readback.hpp"
+#include "tfwi_vulkan_frame_recorder.hpp"
+#include "tfwi_vulkan_frame_scheduler.hpp"
+#include "tfwi_vulkan_job_system.hpp"
+#include "tfwi_vulkan_logger.hpp"
+#include "tfwi_vulkan_memory_tracker.hpp"
+#include "tfwi_vulkan_mesh_lod.hpp"
+#include "tfwi_vulkan_pipeline_cache.hpp"
+#include "tfwi_vulkan_pipeline_layouts.hpp"
+#include "tfwi_vulkan_primitives.hpp"
+#include "tfwi_vulkan_render_graph.hpp"
+#include "tfwi_vulkan_scene.hpp"
+#include "tfwi_vulkan_settings.hpp"
+#include "tfwi_vulkan_shader_reflection.hpp"
+#include "tfwi_vulkan_shaders.hpp"
+#include "tfwi_vulkan_startup_timer.hpp"
+#include "tfwi_vulkan_task_graph.hpp"
\ No newline at end of file
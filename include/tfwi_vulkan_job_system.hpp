@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+* Bump allocator for scratch memory which only lives until the end of the
+* frame. Allocating is a pointer increment, reset() frees everything at once
+* and keeps the blocks, so a steady frame never calls into the heap.
+*/
+class FrameAllocator {
+public:
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	// Value initialized, never destroyed
+	template<typename T>
+	T* allocateArray(size_t count) {
+		static_assert(std::is_trivially_destructible<T>::value, "Frame allocations are never destroyed!");
+		T* array = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+		for (size_t i = 0; i < count; i++) {
+			new (&array[i]) T();
+		}
+		return array;
+	}
+
+	void reset();
+	size_t getCapacity() const;
+
+private:
+	typedef struct Block {
+		std::unique_ptr<uint8_t[]> memory;
+		size_t size;
+	} Block;
+
+	const size_t blockSize = 64 * 1024;
+
+	std::vector<Block> blocks;
+	size_t currentBlock = 0;
+	size_t offset = 0;
+};
+
+class JobCounter;
+
+typedef struct Job {
+	std::function<void()> work;
+	// Counts the job until it has finished, may be null
+	JobCounter* counter = nullptr;
+} Job;
+
+/*
+* Number of unfinished jobs run with it. Jobs can wait for a counter to
+* reach zero (JobSystem::run's dependency), the frame loop with
+* JobSystem::wait(). A counter may be reused once it reached zero.
+*/
+class JobCounter {
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool isDone() const { return pending.load() == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<uint32_t> pending{ 0 };
+	std::mutex mutex;
+	// Jobs which depend on this counter, started when it reaches zero
+	std::vector<Job> waiting;
+	// First exception thrown by one of the jobs
+	std::exception_ptr error;
+};
+
+/*
+* A fixed pool of worker threads for the per-frame CPU work, independent of
+* Vulkan.
+*
+* The thread which called start() is worker 0, it runs jobs while it waits
+* for them. Every worker pushes the jobs it creates to the back of its own
+* deque and takes its next job from there, so related work stays on one
+* core; a worker that ran dry steals from the front of the others' deques.
+* The deques are guarded by one mutex each, which is only ever contended
+* by a thief. Idle workers sleep on a condition variable.
+*
+* Only the thread which started the system and its workers may use it.
+*/
+class JobSystem {
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::function<void()> Work;
+
+	JobSystem() = default;
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// threadCount includes the calling thread, 0 uses one per hardware thread
+	void start(uint32_t threadCount);
+	// Every job has to be done by now
+	void stop();
+
+	uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+	// 0 for the thread which started the system
+	uint32_t getWorkerIndex() const;
+
+	/*
+	* Queues "work" on the calling worker. "counter" (if any) counts it until
+	* it has finished. With a "dependency", the job only starts once that
+	* counter reached zero; it is skipped if one of the jobs counted by it
+	* threw, and the exception is handed on to "counter".
+	*/
+	void run(Work work, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+	// Runs jobs until "counter" reached zero, then rethrows the first exception of its jobs
+	void wait(JobCounter& counter);
+
+	/*
+	* Calls function(first, last) for consecutive ranges of at most batchSize
+	* out of [0, count), in parallel, and returns once all have finished.
+	* The calling thread takes the first range itself.
+	*/
+	template<typename Function>
+	void parallelFor(uint32_t count, uint32_t batchSize, const Function& function);
+
+	// Scratch memory of the calling worker, valid until the next beginFrame()
+	FrameAllocator& getFrameAllocator();
+	// Resets every worker's frame allocator, no job may be running
+	void beginFrame();
+
+	// Prints how many jobs ran (and were stolen) since the last report, at most once per reportPeriod
+	void report(std::ostream& out, Clock::time_point now);
+
+private:
+	typedef struct Worker {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+		FrameAllocator frameAllocator;
+		std::thread thread;
+		std::atomic<uint64_t> executedJobs{ 0 };
+		std::atomic<uint64_t> stolenJobs{ 0 };
+	} Worker;
+
+	const Clock::duration reportPeriod = std::chrono::seconds(1);
+
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	// Jobs sitting in any deque
+	std::atomic<uint32_t> queuedJobs{ 0 };
+	std::atomic<uint32_t> sleepingWorkers{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	// Statistics of the current report period
+	Clock::time_point lastReport;
+	uint64_t reportedJobs = 0;
+	uint64_t reportedSteals = 0;
+
+	void push(Job&& job);
+	bool tryRunJob(uint32_t workerIndex);
+	void finish(Job& job, std::exception_ptr error);
+	void workerLoop(uint32_t workerIndex);
+};
+
+template<typename Function>
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize, const Function& function) {
+	batchSize = std::max(batchSize, 1u);
+	if (count <= batchSize || workers.size() <= 1) {
+		if (count > 0) {
+			function(0, count);
+		}
+		return;
+	}
+
+	JobCounter counter;
+	for (uint32_t first = batchSize; first < count; first += batchSize) {
+		uint32_t last = std::min(count, first + batchSize);
+		run([&function, first, last]() { function(first, last); }, &counter);
+	}
+
+	// The other ranges reference "function" and "counter", they have to finish before unwinding
+	std::exception_ptr error;
+	try {
+		function(0, batchSize);
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	try {
+		wait(counter);
+	}
+	catch (...) {
+		if (!error) {
+			error = std::current_exception();
+		}
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
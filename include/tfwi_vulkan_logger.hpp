@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "tfwi_vulkan_mpsc_ring.hpp"
+
+enum class LogSeverity {
+	Verbose,
+	Info,
+	Warning,
+	Error
+};
+
+enum class LogCategory {
+	General,
+	Validation,
+	Performance,	// VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT
+	Renderer
+};
+
+typedef struct LogStats {
+	uint64_t written = 0;
+	uint64_t filtered = 0;		// Below the minimum severity or muted
+	uint64_t suppressed = 0;	// Over the rate limit
+	uint64_t dropped = 0;		// The ring was full
+	uint64_t performanceWarnings = 0;
+} LogStats;
+
+/*
+* Asynchronous log sink, independent of Vulkan.
+*
+* log() can be called from any thread, including from inside driver calls
+* (the validation layer callback): it filters, copies the message into a
+* lock-free ring and returns, without locking or allocating. A background
+* thread formats and writes the messages.
+*
+* The writer groups messages by message id (or by text for messages without
+* one) and only writes the first rateLimit of each group per second, so a
+* validation error repeated every draw call does not flood the output. How
+* many were suppressed is written once the window has passed.
+*/
+class Logger {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static const size_t maxMessageLength = 480;
+	static const size_t maxMutedIds = 64;
+
+	explicit Logger(std::ostream& out = std::cerr);
+	// Writes everything still queued
+	~Logger();
+
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+
+	void setMinimumSeverity(LogSeverity severity) { minimumSeverity.store(static_cast<int>(severity), std::memory_order_relaxed); }
+	LogSeverity getMinimumSeverity() const { return static_cast<LogSeverity>(minimumSeverity.load(std::memory_order_relaxed)); }
+	// Messages with this id are counted but never queued
+	void muteMessageId(int32_t messageId);
+	// Per message id and second, 0 disables the limit
+	void setRateLimit(uint32_t messagesPerSecond) { rateLimit.store(messagesPerSecond, std::memory_order_relaxed); }
+
+	void log(LogSeverity severity, LogCategory category, int32_t messageId, const char* text);
+	void log(LogSeverity severity, LogCategory category, const std::string& text) { log(severity, category, 0, text.c_str()); }
+
+	LogStats getStats() const;
+
+	// Prints the counters when something changed, at most once per reportPeriod
+	void report(std::ostream& out, Clock::time_point now);
+
+private:
+	typedef struct Message {
+		LogSeverity severity;
+		LogCategory category;
+		int32_t messageId;
+		char text[maxMessageLength];
+	} Message;
+
+	typedef struct RateWindow {
+		Clock::time_point start;
+		uint32_t written = 0;
+		uint64_t suppressed = 0;
+		int32_t messageId = 0;
+	} RateWindow;
+
+	const std::chrono::seconds rateWindowLength = std::chrono::seconds(1);
+	const Clock::duration reportPeriod = std::chrono::seconds(1);
+	const std::chrono::milliseconds idleSleep = std::chrono::milliseconds(2);
+
+	std::ostream& out;
+	MpscRing<Message> ring;
+	std::thread writer;
+	std::atomic<bool> running{ true };
+
+	std::atomic<int> minimumSeverity{ static_cast<int>(LogSeverity::Warning) };
+	std::atomic<uint32_t> rateLimit{ 5 };
+	std::array<std::atomic<int32_t>, maxMutedIds> mutedIds{};
+	std::atomic<size_t> mutedIdCount{ 0 };
+	std::mutex muteMutex; // Only serializes muteMessageId calls
+
+	std::atomic<uint64_t> written{ 0 };
+	std::atomic<uint64_t> filtered{ 0 };
+	std::atomic<uint64_t> suppressed{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+	std::atomic<uint64_t> performanceWarnings{ 0 };
+
+	// Writer thread only
+	std::unordered_map<uint64_t, RateWindow> rateWindows;
+
+	// Report bookkeeping, only touched by the thread calling report()
+	Clock::time_point lastReport;
+	LogStats lastReportedStats;
+
+	bool isMuted(int32_t messageId) const;
+	void writerLoop();
+	void write(const Message& message, Clock::time_point now);
+	void flushRateWindows(Clock::time_point now, bool all);
+};
+
+const char* getLogSeverityName(LogSeverity severity);
+const char* getLogCategoryName(LogCategory category);
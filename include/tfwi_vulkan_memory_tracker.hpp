@@ -0,0 +1,132 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_VULKAN
+#endif // !GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+
+// What an allocation is used for, only for bookkeeping
+enum class MemoryUsage : uint32_t {
+	Vertex,
+	Index,
+	Uniform,
+	Staging,
+	Readback,
+	Storage,
+	RenderTarget,
+	Other,
+	Count
+};
+
+const char* getMemoryUsageName(MemoryUsage usage);
+
+typedef struct MemoryHeapBudget {
+	VkDeviceSize size = 0;
+	VkMemoryHeapFlags flags = 0;
+	/*
+	* How much of the heap this process may use and uses. With VK_EXT_memory_budget
+	* both come from the driver (and include allocations the tracker never saw,
+	* like swap chain images), otherwise the budget is a fixed share of the heap
+	* size and the usage is what went through the tracker.
+	*/
+	VkDeviceSize budget = 0;
+	VkDeviceSize usage = 0;
+	// Allocated through the tracker
+	VkDeviceSize tracked = 0;
+	uint32_t allocationCount = 0;
+} MemoryHeapBudget;
+
+/*
+* Wraps vkAllocateMemory/vkFreeMemory and keeps track of every allocation by
+* heap, memory type and usage tag.
+*
+* updateBudget() should run once per frame. It refreshes the driver's view of
+* each heap when VK_EXT_memory_budget is enabled; between two queries the
+* usage is extrapolated from the allocations made since.
+*
+* Pressure callbacks fire once when a heap's usage crosses the pressure
+* threshold, and again only after it dropped back below it by some margin.
+* They also fire right before an allocation is retried after running out of
+* device memory, which is the moment caches and streaming should evict.
+* Callbacks run on the allocating thread without the tracker's lock held, so
+* they may free memory through the tracker.
+*/
+class DeviceMemoryTracker {
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::function<void(uint32_t heapIndex, const MemoryHeapBudget& heap)> PressureCallback;
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+		bool budgetExtensionEnabled);
+
+	// Same result as vkAllocateMemory, "memory" is only written on success
+	VkResult allocate(const VkMemoryAllocateInfo& allocInfo, MemoryUsage usage, VkDeviceMemory* memory);
+	// Frees memory returned by allocate(), VK_NULL_HANDLE is ignored
+	void free(VkDeviceMemory memory);
+
+	void updateBudget();
+
+	void addPressureCallback(PressureCallback callback);
+	// Fraction of the budget above which a heap is under pressure
+	void setPressureThreshold(double threshold) { pressureThreshold = threshold; }
+
+	bool isBudgetExtensionEnabled() const { return budgetExtensionEnabled; }
+	uint32_t getHeapCount() const { return memoryProperties.memoryHeapCount; }
+	MemoryHeapBudget getHeapBudget(uint32_t heapIndex) const;
+	VkDeviceSize getMemoryTypeUsage(uint32_t memoryTypeIndex) const;
+	VkDeviceSize getUsageTotal(MemoryUsage usage) const;
+
+	// Prints usage against budget of every heap and the usage tag totals, at most once per reportPeriod
+	void report(std::ostream& out, Clock::time_point now);
+
+private:
+	typedef struct Allocation {
+		VkDeviceSize size;
+		uint32_t memoryTypeIndex;
+		MemoryUsage usage;
+	} Allocation;
+
+	typedef struct HeapState {
+		MemoryHeapBudget budget;
+		// Driver usage and tracked bytes when the driver was last asked, to extrapolate its usage
+		VkDeviceSize reportedUsage = 0;
+		VkDeviceSize trackedAtQuery = 0;
+		bool underPressure = false;
+	} HeapState;
+
+	// Without VK_EXT_memory_budget, assume a bit of every heap belongs to someone else
+	const double estimatedBudgetShare = 0.8;
+	// A heap under pressure recovers only this far below the threshold
+	const double pressureHysteresis = 0.05;
+	const Clock::duration reportPeriod = std::chrono::seconds(1);
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	bool budgetExtensionEnabled = false;
+	double pressureThreshold = 0.9;
+
+	mutable std::mutex mutex;
+	std::unordered_map<VkDeviceMemory, Allocation> allocations;
+	std::vector<HeapState> heaps;
+	std::vector<VkDeviceSize> memoryTypeUsage;
+	VkDeviceSize usageTotals[static_cast<size_t>(MemoryUsage::Count)] = {};
+	std::vector<PressureCallback> pressureCallbacks;
+	Clock::time_point lastReport;
+
+	// Called with the lock held
+	void queryBudget();
+	void refreshUsage(HeapState& heap) const;
+	bool checkPressure(HeapState& heap);
+
+	void notifyPressure(const std::vector<uint32_t>& heapIndices);
+};
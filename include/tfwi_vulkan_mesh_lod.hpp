@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif // !GLM_FORCE_RADIANS
+
+#ifndef GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif // !GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <glm/glm.hpp>
+
+// One level of detail: a range of MeshLodChain::getIndices()
+typedef struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// How far (in mesh units) this level's surface may be from the full detail one, 0 for level 0
+	float error;
+} MeshLod;
+
+typedef struct MeshLodOptions {
+	uint32_t maxLevels = 8;
+	// Each level aims for this fraction of the previous level's triangles
+	float reduction = 0.5f;
+	// No level deviates more than this fraction of the mesh's bounding radius
+	float maxRelativeError = 0.25f;
+	// A level has to drop at least this fraction of the previous one's triangles, or the chain ends
+	float minReduction = 0.1f;
+} MeshLodOptions;
+
+/*
+* Simplified index buffers of one triangle mesh, from full detail (level 0)
+* to coarsest, independent of Vulkan.
+*
+* Levels come from quadric edge collapse (Garland and Heckbert): every
+* vertex accumulates the planes of its triangles, and an edge collapse is
+* rated by the distance of the merged vertex from all of them. Collapses
+* only move a vertex onto its neighbor, so every level indexes the original
+* vertices and the vertex buffer is shared by all of them. Edges with only
+* one triangle (mesh borders and attribute seams) add planes perpendicular
+* to their triangle, so outlines survive much longer than interior detail.
+* Each level continues where the previous one stopped, and its error is
+* measured against the full detail mesh.
+*/
+class MeshLodChain {
+public:
+	MeshLodChain() = default;
+	MeshLodChain(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const MeshLodOptions& options = MeshLodOptions{});
+
+	// Every level back to back, finest first
+	const std::vector<uint32_t>& getIndices() const { return indices; }
+	uint32_t getLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+	const MeshLod& getLevel(uint32_t level) const { return levels[level]; }
+
+	// Bounding sphere of the vertices the mesh uses
+	const glm::vec3& getCenter() const { return center; }
+	float getRadius() const { return radius; }
+
+	/*
+	* The coarsest level whose error, at "pixelsPerUnit", stays within
+	* "threshold" pixels. Going coarser than "currentLevel" needs the error to
+	* stay within (1 - hysteresis) * threshold, so a mesh sitting right at a
+	* switching distance does not pop between two levels every frame.
+	*/
+	uint32_t selectLevel(float pixelsPerUnit, float threshold, uint32_t currentLevel, float hysteresis = 0.25f) const;
+
+private:
+	std::vector<uint32_t> indices;
+	std::vector<MeshLod> levels;
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+};
+
+/*
+* How many pixels one mesh unit at "center" (in model space) covers on
+* screen, for a viewport "viewportHeight" pixels high. Works for perspective
+* and orthographic projections, the model matrix's largest scale counts.
+*/
+float getProjectedPixelsPerUnit(const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj,
+	const glm::vec3& center, float viewportHeight);
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+/*
+* Bounded lock-free ring for many producers and a single consumer.
+*
+* Every slot carries a sequence number telling whose turn it is: producers
+* claim a position with a compare-and-swap on the write index and publish the
+* slot by bumping its sequence, the consumer takes slots in order once they
+* are published. Producers never block, tryPush fails when the ring is full.
+*/
+template<typename T>
+class MpscRing {
+public:
+	// "capacity" must be a power of two
+	explicit MpscRing(size_t capacity)
+		: slots(new Slot[capacity]), mask(capacity - 1) {
+		if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+			throw std::runtime_error("Ring capacity must be a power of two!");
+		}
+		for (size_t i = 0; i < capacity; i++) {
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpscRing(const MpscRing&) = delete;
+	MpscRing& operator=(const MpscRing&) = delete;
+
+	// Safe from any thread
+	bool tryPush(const T& value) {
+		size_t position = writeIndex.load(std::memory_order_relaxed);
+		Slot* slot;
+		for (;;) {
+			slot = &slots[position & mask];
+			size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+			if (difference == 0) {
+				// The slot is free for this position, try to claim it
+				if (writeIndex.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if (difference < 0) {
+				// The consumer has not freed this slot since the last lap
+				return false;
+			}
+			else {
+				// Another producer claimed the position first
+				position = writeIndex.load(std::memory_order_relaxed);
+			}
+		}
+
+		slot->value = value;
+		slot->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Only ever called from the single consumer thread
+	bool tryPop(T& value) {
+		Slot& slot = slots[readIndex & mask];
+		if (slot.sequence.load(std::memory_order_acquire) != readIndex + 1) {
+			return false;
+		}
+
+		value = slot.value;
+		// Hand the slot to the producer one lap ahead
+		slot.sequence.store(readIndex + mask + 1, std::memory_order_release);
+		readIndex++;
+		return true;
+	}
+
+private:
+	typedef struct Slot {
+		std::atomic<size_t> sequence;
+		T value;
+	} Slot;
+
+	std::unique_ptr<Slot[]> slots;
+	const size_t mask;
+	// Separate cache lines, producers hammer the write index
+	alignas(64) std::atomic<size_t> writeIndex{ 0 };
+	alignas(64) size_t readIndex = 0;
+};
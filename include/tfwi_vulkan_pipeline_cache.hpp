@@ -0,0 +1,161 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_VULKAN
+#endif // !GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+
+#include "tfwi_vulkan_job_system.hpp"
+#include "tfwi_vulkan_pipeline_layouts.hpp"
+#include "tfwi_vulkan_shader_reflection.hpp"
+
+enum class PipelineBlend : uint8_t {
+	Opaque,
+	Alpha,		// src * srcAlpha + dst * (1 - srcAlpha)
+	Additive	// src * srcAlpha + dst
+};
+
+/*
+* Everything a graphics pipeline of this renderer is built from, packed into
+* 16 bytes without padding so it can be hashed and compared as plain memory.
+*
+* Shaders, vertex layouts and render passes are ids handed out by the
+* PipelineCache. The render pass id names a compatibility class (attachment
+* formats and sample counts), not a handle: pipelines built for one render
+* pass work with every compatible one, e.g. the ones recreated with the swap
+* chain. Viewport and scissor are always dynamic.
+*/
+typedef struct PipelineKey {
+	uint16_t vertexShader = 0;
+	uint16_t fragmentShader = 0;
+	uint16_t vertexLayout = 0;
+	uint16_t renderPass = 0;
+	uint8_t topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	uint8_t polygonMode = VK_POLYGON_MODE_FILL;
+	uint8_t cullMode = VK_CULL_MODE_BACK_BIT;
+	uint8_t frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	uint8_t samples = VK_SAMPLE_COUNT_1_BIT;
+	PipelineBlend blend = PipelineBlend::Opaque;
+	uint8_t colorWriteMask =
+		VK_COLOR_COMPONENT_R_BIT |
+		VK_COLOR_COMPONENT_G_BIT |
+		VK_COLOR_COMPONENT_B_BIT |
+		VK_COLOR_COMPONENT_A_BIT;
+	// Keeps the key free of padding, always 0
+	uint8_t reserved = 0;
+
+	bool operator==(const PipelineKey& other) const;
+	bool operator!=(const PipelineKey& other) const { return !(*this == other); }
+} PipelineKey;
+
+static_assert(sizeof(PipelineKey) == 16, "PipelineKey must not contain padding!");
+
+typedef struct PipelineKeyHash {
+	size_t operator()(const PipelineKey& key) const;
+} PipelineKeyHash;
+
+/*
+* Graphics pipelines by PipelineKey, each built exactly once.
+*
+* get() never blocks on a build: a key seen for the first time is queued on
+* the job system and get() hands out the fallback (or VK_NULL_HANDLE) until
+* a worker has built it, so a new state combination costs no frame time on
+* the render thread. build() creates the pipeline right away, for the ones
+* needed from the first frame on. Lookups take a shared lock only and may
+* run on any thread; get() queues jobs, so it has to run on a thread of the
+* job system.
+*
+* The cache owns the pipelines and the shader modules, they live until
+* destroy(). A VkPipelineCache shares the driver's compiled state between
+* all builds.
+*/
+class PipelineCache {
+public:
+	void create(VkDevice device, PipelineLayoutCache& layouts, JobSystem& jobs);
+	// Waits for the queued builds, the device must be idle
+	void destroy();
+
+	// The same id for every call with the same name, the reflection has to outlive the cache
+	uint16_t addShader(const std::string& name, ShaderBinary binary, const ShaderReflection& reflection);
+	// The same id for every call with the same bindings and attributes
+	uint16_t addVertexLayout(const std::vector<VkVertexInputBindingDescription>& bindings,
+		const std::vector<VkVertexInputAttributeDescription>& attributes);
+	/*
+	* The id of the compatibility class "compatibility" describes (the formats
+	* and sample counts of the attachments). New builds use "renderPass" from
+	* now on, which has to stay alive until the next call for the same class
+	* or destroy(); builds still using the previous one are waited for.
+	*/
+	uint16_t setRenderPass(VkRenderPass renderPass, const std::vector<uint32_t>& compatibility);
+
+	// The pipeline if it is built, otherwise the fallback if that is built, otherwise VK_NULL_HANDLE
+	VkPipeline get(const PipelineKey& key, const PipelineKey* fallback = nullptr);
+	// Builds the pipeline on the calling thread unless it already is (or waits for the worker building it)
+	VkPipeline build(const PipelineKey& key);
+	// Of the key's shaders, from the pipeline layout cache
+	VkPipelineLayout getPipelineLayout(const PipelineKey& key);
+
+	size_t getPipelineCount() const;
+	size_t getPendingCount() const;
+
+private:
+	enum class EntryState {
+		Queued,
+		Building,
+		Ready,
+		Failed
+	};
+
+	typedef struct Entry {
+		EntryState state = EntryState::Queued;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::exception_ptr error;
+	} Entry;
+
+	typedef struct Shader {
+		std::string name;
+		VkShaderModule module;
+		const ShaderReflection* reflection;
+	} Shader;
+
+	typedef struct VertexLayout {
+		std::vector<VkVertexInputBindingDescription> bindings;
+		std::vector<VkVertexInputAttributeDescription> attributes;
+	} VertexLayout;
+
+	typedef struct RenderPass {
+		std::vector<uint32_t> compatibility;
+		VkRenderPass handle;
+	} RenderPass;
+
+	VkDevice device = VK_NULL_HANDLE;
+	PipelineLayoutCache* layouts = nullptr;
+	JobSystem* jobs = nullptr;
+	VkPipelineCache driverCache = VK_NULL_HANDLE;
+
+	mutable std::shared_mutex mutex;
+	// Signalled whenever a build finished, for build() calls waiting on a worker
+	std::condition_variable_any built;
+	std::unordered_map<PipelineKey, Entry, PipelineKeyHash> entries;
+	// Ids are indices + 1, 0 is never valid
+	std::vector<Shader> shaders;
+	std::vector<VertexLayout> vertexLayouts;
+	std::vector<RenderPass> renderPasses;
+	size_t pendingCount = 0;
+
+	// The asynchronous builds, waited for by destroy() and setRenderPass()
+	JobCounter builds;
+
+	// Takes over the key's entry and builds it, unless someone else already did
+	void buildQueued(const PipelineKey& key);
+	VkPipeline createPipeline(const PipelineKey& key);
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#ifndef GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_VULKAN
+#endif // !GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+
+#include "tfwi_vulkan_shader_reflection.hpp"
+
+/*
+* Descriptor set layouts and pipeline layouts built from the reflected
+* interface of a pipeline's shader stages.
+*
+* Layouts are keyed by their signature (bindings, descriptor types, counts,
+* stages and push constants), so every pipeline declaring the same interface
+* gets the very same handles. That keeps the number of distinct layouts low,
+* and descriptor sets bound for one pipeline stay bound across pipelines
+* with compatible layouts.
+*
+* The cache owns every layout it hands out, they live as long as the device.
+* It may be used from several threads, e.g. by the startup steps.
+*/
+class PipelineLayoutCache {
+public:
+	void create(VkDevice device);
+	void destroy();
+
+	// The merged bindings of "set" in every stage
+	VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<const ShaderReflection*>& stages, uint32_t set);
+	// Every set the stages use (unused sets in between are empty) and their push constant block
+	VkPipelineLayout getPipelineLayout(const std::vector<const ShaderReflection*>& stages);
+
+	size_t getDescriptorSetLayoutCount() const;
+	size_t getPipelineLayoutCount() const;
+
+private:
+	typedef std::vector<uint32_t> Signature;
+
+	VkDevice device = VK_NULL_HANDLE;
+	mutable std::mutex mutex;
+	std::map<Signature, VkDescriptorSetLayout> descriptorSetLayouts;
+	std::map<Signature, VkPipelineLayout> pipelineLayouts;
+
+	static std::vector<VkDescriptorSetLayoutBinding> mergeBindings(const std::vector<const ShaderReflection*>& stages, uint32_t set);
+	static Signature getSignature(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+	VkDescriptorSetLayout findOrCreateSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+};
@@ -25,6 +25,22 @@ typedef struct Vertex {
 	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions();
 } Vertex;
 
+// Matches the std430 layout of Particle in particles.comp
+typedef struct Particle {
+	glm::vec2 position;
+	glm::vec2 velocity;
+	glm::vec4 color;
+	static VkVertexInputBindingDescription getBindingDescription();
+	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions();
+} Particle;
+
+typedef struct ParticleSimulationConstants {
+	float deltaTime;
+	float time;
+	uint32_t particleCount;
+	uint32_t reset;
+} ParticleSimulationConstants;
+
 typedef struct UniformBufferObject {
 	glm::mat4 model;
 	glm::mat4 view;
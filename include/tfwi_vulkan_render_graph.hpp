@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_VULKAN
+#endif // !GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+
+#include "tfwi_vulkan_memory_tracker.hpp"
+
+/*
+* A small frame graph in the spirit of Frostbite's FrameGraph and Granite's
+* render graph. Passes declare which images they read and write, and the graph
+* derives everything that used to be written by hand in createRenderPass:
+*
+* - the VkRenderPass (load/store ops, initial/final layouts) of every pass
+* - the external subpass dependencies and pipeline barriers between passes
+* - which passes can be culled because nothing consumes their output
+* - the memory of transient images, aliased between images whose lifetimes
+*   never overlap
+*
+* Passes are executed in declaration order, so a pass must be added after
+* every pass producing one of its inputs.
+*/
+
+typedef uint32_t RenderGraphResource;
+const RenderGraphResource RENDER_GRAPH_RESOURCE_NONE = UINT32_MAX;
+
+enum class RenderGraphPassType {
+	Graphics,	// Recorded inside a VkRenderPass created by the graph
+	Transfer,	// Copies/blits, recorded outside of any render pass
+	Compute		// Dispatches, recorded outside of any render pass
+};
+
+enum class RenderGraphAccess {
+	ColorAttachment,	// Written as a color attachment
+	ResolveAttachment,	// Written as the resolve target of a color attachment
+	SampledRead,		// Read through a sampler in a fragment shader
+	StorageRead,		// Read as a storage image in a compute shader
+	StorageWrite,		// Written as a storage image in a compute shader
+	TransferRead,		// Source of a copy or blit
+	TransferWrite		// Destination of a copy or blit
+};
+
+typedef struct RenderGraphImageDesc {
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = { 0, 0 };
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	// Extra usage on top of what the graph derives from the declared accesses
+	VkImageUsageFlags additionalUsage = 0;
+} RenderGraphImageDesc;
+
+typedef struct RenderGraphImageUse {
+	RenderGraphResource resource;
+	RenderGraphAccess access;
+	// Only meaningful for color attachments
+	bool clear = false;
+	VkClearValue clearValue{};
+	// Color attachment this resolve target belongs to
+	RenderGraphResource resolveSource = RENDER_GRAPH_RESOURCE_NONE;
+} RenderGraphImageUse;
+
+typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t imageIndex)> RenderGraphRecordCallback;
+
+class RenderGraphPass {
+public:
+	RenderGraphPass(const std::string& name, RenderGraphPassType type)
+		: name(name), type(type) {}
+
+	void addColorOutput(RenderGraphResource resource);
+	void addColorOutput(RenderGraphResource resource, VkClearValue clearValue);
+	void addResolveOutput(RenderGraphResource resource, RenderGraphResource colorSource);
+	void addTextureInput(RenderGraphResource resource);
+	void addStorageInput(RenderGraphResource resource);
+	void addStorageOutput(RenderGraphResource resource);
+	void addTransferInput(RenderGraphResource resource);
+	void addTransferOutput(RenderGraphResource resource);
+	void setRecordCallback(RenderGraphRecordCallback callback);
+	// For passes whose results leave the graph some other way, e.g. copies read back on the host
+	void setNeverCulled() { neverCulled = true; }
+
+	const std::string& getName() const { return name; }
+	RenderGraphPassType getType() const { return type; }
+	const std::vector<RenderGraphImageUse>& getUses() const { return uses; }
+	const RenderGraphRecordCallback& getRecordCallback() const { return record; }
+	bool isNeverCulled() const { return neverCulled; }
+
+private:
+	std::string name;
+	RenderGraphPassType type;
+	std::vector<RenderGraphImageUse> uses;
+	RenderGraphRecordCallback record;
+	bool neverCulled = false;
+};
+
+class RenderGraph {
+public:
+	/*
+	* Imports the swap chain images. The graph never owns imported images,
+	* it only transitions them into "finalLayout" once the last pass using
+	* them has run. Passes touching an imported swap chain get one framebuffer
+	* per swap chain image, selected by the image index given to execute().
+	*/
+	RenderGraphResource importSwapChain(
+		const std::string& name,
+		VkFormat format,
+		VkExtent2D extent,
+		const std::vector<VkImage>& images,
+		const std::vector<VkImageView>& views,
+		VkImageLayout finalLayout);
+
+	// Declares an image owned by the graph whose contents live only within a frame
+	RenderGraphResource createTransientImage(const std::string& name, const RenderGraphImageDesc& desc);
+
+	// Passes are returned by reference and stay valid until reset()
+	RenderGraphPass& addPass(const std::string& name, RenderGraphPassType type);
+
+	// Only passes contributing (directly or not) to an output survive culling
+	void setOutput(RenderGraphResource resource);
+
+	// Transient memory is allocated through "memoryTracker" when there is one
+	void compile(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+		DeviceMemoryTracker* memoryTracker = nullptr);
+	void execute(VkCommandBuffer commandBuffer, uint32_t imageIndex) const;
+
+	// Destroys every Vulkan object created by compile() and forgets all declarations
+	void reset();
+
+	VkRenderPass getRenderPass(const std::string& passName) const;
+	bool isPassCulled(const std::string& passName) const;
+	VkImageView getImageView(RenderGraphResource resource, uint32_t imageIndex) const;
+	VkImage getImage(RenderGraphResource resource, uint32_t imageIndex) const;
+
+	/*
+	* Restricts a graphics pass to the top left "renderArea" of its attachments
+	* from the next execute() on, e.g. to render at a lower resolution without
+	* recreating images. Clears and resolves only touch that area.
+	*/
+	void setRenderArea(const std::string& passName, VkExtent2D renderArea);
+	VkDeviceSize getTransientMemorySize() const { return transientMemorySize; }
+	VkDeviceSize getTransientMemoryRequested() const { return transientMemoryRequested; }
+
+private:
+	typedef struct ResourceState {
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		VkAccessFlags writeAccess = 0;
+	} ResourceState;
+
+	typedef struct Resource {
+		std::string name;
+		RenderGraphImageDesc desc;
+		VkImageUsageFlags usage = 0;
+		bool imported = false;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		ResourceState initialState;
+		// One entry per swap chain image for imported resources, a single one otherwise
+		std::vector<VkImage> images;
+		std::vector<VkImageView> views;
+		// Lifetime in executed pass order, used for aliasing
+		int32_t firstPass = -1;
+		int32_t lastPass = -1;
+		int32_t memoryBlock = -1;
+	} Resource;
+
+	typedef struct ImageBarrier {
+		RenderGraphResource resource;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		VkPipelineStageFlags srcStages;
+		VkAccessFlags srcAccess;
+		VkPipelineStageFlags dstStages;
+		VkAccessFlags dstAccess;
+	} ImageBarrier;
+
+	typedef struct CompiledPass {
+		uint32_t pass;
+		std::vector<ImageBarrier> barriers;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::vector<VkFramebuffer> framebuffers;
+		std::vector<VkClearValue> clearValues;
+		VkExtent2D extent = { 0, 0 };
+		VkExtent2D renderArea = { 0, 0 };
+	} CompiledPass;
+
+	typedef struct MemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		bool lazilyAllocated = false;
+		std::vector<RenderGraphResource> residents;
+	} MemoryBlock;
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceMemoryTracker* memoryTracker = nullptr;
+	std::vector<Resource> resources;
+	std::deque<RenderGraphPass> passes;
+	std::vector<RenderGraphResource> outputs;
+	std::vector<bool> passCulled;
+	std::vector<CompiledPass> compiledPasses;
+	std::vector<ImageBarrier> finalBarriers;
+	std::vector<MemoryBlock> memoryBlocks;
+	uint32_t imageCount = 1;
+	VkDeviceSize transientMemorySize = 0;
+	VkDeviceSize transientMemoryRequested = 0;
+
+	void cullPasses();
+	void deriveUsageAndLifetimes();
+	void allocateTransientImages(const VkPhysicalDeviceMemoryProperties& memoryProperties);
+	void buildPasses();
+	void createRenderPass(CompiledPass& compiled, std::vector<ResourceState>& states);
+	void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<ImageBarrier>& barriers, uint32_t imageIndex) const;
+	int32_t findPass(const std::string& passName) const;
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif // !GLM_FORCE_RADIANS
+
+#ifndef GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif // !GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "tfwi_vulkan_job_system.hpp"
+#include "tfwi_vulkan_transform_kernels.hpp"
+
+typedef uint32_t SceneObject;
+const SceneObject SCENE_OBJECT_NONE = UINT32_MAX;
+
+// Objects [first, first + count) of a SceneStore
+typedef struct SceneRange {
+	uint32_t first;
+	uint32_t count;
+} SceneRange;
+
+/*
+* The scene as a structure-of-arrays, independent of Vulkan.
+*
+* Every per object attribute lives in its own contiguous array indexed by
+* SceneObject: local translation/rotation/scale, parent index, local and world
+* matrices, bounding spheres and the render handle the renderer draws the
+* object with. A parent is always created before its children, so a parent's
+* index is smaller than any of its descendants'.
+*
+* Setters only mark the object dirty. update() recomposes the local matrices
+* of the dirty objects with the batched transform kernels, then walks down
+* from each of them to refresh the world matrices and bounds of the whole
+* subtree, and nothing else. A static scene costs one branch per frame.
+* Given a JobSystem, the local matrices are composed in parallel batches.
+*
+* Every update() that changed something bumps the version and remembers which
+* objects it touched, so a buffer holding world matrices can catch up from its
+* own version with getChangedRanges() instead of being rewritten.
+*/
+class SceneStore {
+public:
+	SceneObject createObject(SceneObject parent, uint32_t renderHandle,
+		const glm::vec3& position = glm::vec3(0.0f),
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+		const glm::vec3& scale = glm::vec3(1.0f));
+
+	void setPosition(SceneObject object, const glm::vec3& position);
+	void setRotation(SceneObject object, const glm::quat& rotation);
+	void setScale(SceneObject object, const glm::vec3& scale);
+	// Sphere in the object's local space
+	void setLocalBounds(SceneObject object, const glm::vec3& center, float radius);
+
+	// Returns true if any world matrix changed
+	bool update(JobSystem* jobs = nullptr);
+	// Something was edited since the last update()
+	bool hasPendingChanges() const { return !dirtyObjects.empty(); }
+
+	uint32_t getObjectCount() const { return static_cast<uint32_t>(parents.size()); }
+	SceneObject getParent(SceneObject object) const { return parents[object]; }
+	uint32_t getRenderHandle(SceneObject object) const { return renderHandles[object]; }
+	// Column-major, glm::mat4 layout; valid after update()
+	const glm::mat4& getWorldMatrix(SceneObject object) const;
+	const float* getWorldMatrices() const { return worldMatrices.data(); }
+	// World space bounds of every object, ready for TransformKernels::cullSpheres
+	BoundingSphereSoA getWorldBounds() const;
+
+	// 0 before the first update()
+	uint64_t getVersion() const { return version; }
+	/*
+	* Appends the sorted, merged ranges of every object whose world matrix
+	* changed after "sinceVersion". If that is older than the remembered
+	* history, the whole scene is reported.
+	*/
+	void getChangedRanges(uint64_t sinceVersion, std::vector<SceneRange>& ranges) const;
+
+private:
+	typedef struct ChangeSet {
+		uint64_t version;
+		std::vector<SceneRange> ranges;
+	} ChangeSet;
+
+	const size_t maxHistory = 16;
+	// Objects per kernel call (and job) when composing local matrices
+	const uint32_t composeBatchSize = 256;
+
+	// Local transform
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	// Hierarchy, children as intrusive sibling lists
+	std::vector<SceneObject> parents;
+	std::vector<SceneObject> firstChildren;
+	std::vector<SceneObject> nextSiblings;
+
+	std::vector<float> localMatrices;
+	std::vector<float> worldMatrices;
+
+	std::vector<float> localCenterX, localCenterY, localCenterZ, localRadius;
+	std::vector<float> worldCenterX, worldCenterY, worldCenterZ, worldRadius;
+
+	std::vector<uint32_t> renderHandles;
+
+	std::vector<uint8_t> dirtyFlags;
+	std::vector<SceneObject> dirtyObjects;
+	// Version of the update() that last wrote each world matrix
+	std::vector<uint64_t> worldVersions;
+
+	uint64_t version = 0;
+	std::deque<ChangeSet> history;
+
+	// Scratch space reused by every update()
+	std::vector<SceneObject> stack;
+	std::vector<SceneObject> changedObjects;
+	std::vector<SceneRange> dirtyRuns;
+
+	void markDirty(SceneObject object);
+	void composeLocalMatrices(JobSystem* jobs);
+	void updateWorld(SceneObject object);
+};
+
+/*
+* View and projection of a perspective camera, only recomputed when one of
+* their parameters actually changes: the view when the camera moves, the
+* projection when the aspect ratio (usually the swap chain extent) does.
+*/
+class SceneCamera {
+public:
+	void setLookAt(const glm::vec3& eye, const glm::vec3& center, const glm::vec3& up);
+	void setPerspective(float fovY, float aspect, float nearPlane, float farPlane);
+
+	const glm::mat4& getView();
+	// With Vulkan's clip space y pointing down
+	const glm::mat4& getProjection();
+
+	// Bumped whenever the view or the projection changed
+	uint64_t getVersion() const { return version; }
+
+private:
+	glm::vec3 eye = glm::vec3(0.0f, 0.0f, 1.0f);
+	glm::vec3 center = glm::vec3(0.0f);
+	glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+	float fovY = glm::radians(45.0f);
+	float aspect = 1.0f;
+	float nearPlane = 0.1f;
+	float farPlane = 10.0f;
+
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);
+	bool viewDirty = true;
+	bool projectionDirty = true;
+	uint64_t version = 1;
+};
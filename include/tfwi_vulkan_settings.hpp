@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tfwi_vulkan_frame_recorder.hpp"
+#include "tfwi_vulkan_logger.hpp"
+
+enum class PresentModeSetting {
+	Mailbox,	// Triple-buffering, falls back to FIFO when unsupported
+	Fifo,		// "v-sync", always supported
+	FifoRelaxed,	// v-sync, but late frames tear instead of waiting another refresh
+	Immediate	// No v-sync, tears
+};
+
+/*
+* Runtime configuration of the renderer. Everything in here can be changed
+* per deployment from the command line, without recompiling.
+*/
+typedef struct ApplicationSettings {
+	// Requested MSAA sample count, capped to what the device supports (1 disables MSAA)
+	uint32_t msaaSamples = 4;
+	/*
+	* How many frames the CPU may record/submit ahead of the GPU. Fewer frames
+	* lower the input latency, more frames absorb spikes in CPU or GPU time.
+	*/
+	uint32_t framesInFlight = 2;
+	PresentModeSetting presentMode = PresentModeSetting::Mailbox;
+	/*
+	* Delays the start of every frame so input is sampled as late as possible
+	* before the GPU and the display need the frame.
+	*/
+	bool lowLatency = false;
+	// Index or part of the name of the GPU to use, empty picks the best scoring one
+	std::string device;
+	// Dump every instance/device extension and layer while starting up
+	bool verbose = false;
+	// Threads running the initialization steps, 0 picks one per core (up to 4), 1 runs them in sequence
+	uint32_t initThreads = 0;
+	// Validation and renderer messages below this severity are not even requested from the layers
+	LogSeverity logLevel = LogSeverity::Warning;
+	// Validation message ids (VkDebugUtilsMessengerCallbackDataEXT::messageIdNumber) to drop
+	std::vector<int32_t> mutedMessageIds;
+	// Copies of one message written per second, 0 writes all of them
+	uint32_t logRateLimit = 5;
+	// Records the inputs of every frame to this file
+	std::string captureFile;
+	// Renders the frames of a capture file instead of live ones, then exits
+	std::string replayFile;
+	// Live frames advance the animation by 1 / rate seconds each instead of following the clock, 0 disables
+	uint32_t fixedTimestepRate = 0;
+	/*
+	* GPU time per frame, in milliseconds, that dynamic resolution scaling aims
+	* for by rendering the scene below the window resolution. 0 renders at
+	* the window resolution.
+	*/
+	float dynamicResolutionTarget = 0.0f;
+	// Lowest render scale dynamic resolution may pick, in percent of the window size
+	uint32_t minRenderScale = 50;
+	// Reads every presented frame back and writes it here (a raw video file, or the prefix of PNG files)
+	std::string recordPath;
+	RecordingFormat recordFormat = RecordingFormat::Raw;
+	/*
+	* Windows showing the scene, all rendered by one submission and shown by
+	* one present. Capture, replay resizes, dynamic resolution and recording
+	* only apply to the first one.
+	*/
+	uint32_t windowCount = 1;
+	// Only draw when input, a resize or the scene invalidated the last frame, sleep otherwise
+	bool onDemand = false;
+	// Upper limit of frames per second, 0 leaves it to the present mode
+	uint32_t maxFrameRate = 0;
+	// With onDemand, redraw at least every this many milliseconds (0: only when invalidated)
+	uint32_t refreshInterval = 0;
+	// Threads running the per-frame jobs, including the main thread (0: one per hardware thread)
+	uint32_t jobThreads = 0;
+	// Load the SPIR-V from loose files in this directory instead of the copies embedded in the executable
+	std::string shaderDirectory;
+	// Pixels a mesh LOD may deviate from the full detail mesh on screen, 0 always draws full detail
+	float lodThreshold = 1.0f;
+} ApplicationSettings;
+
+ApplicationSettings parseCommandLine(int argc, char** argv);
+std::string getCommandLineUsage();
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_VULKAN
+#endif // !GLFW_INCLUDE_VULKAN
+
+#include <GLFW/glfw3.h>
+
+#include "tfwi_vulkan_shaders.hpp"
+
+typedef struct ShaderVertexInput {
+	uint32_t location;
+	VkFormat format;
+	std::string name;
+} ShaderVertexInput;
+
+typedef struct ShaderDescriptorBinding {
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType type;
+	uint32_t count;
+	VkShaderStageFlags stageFlags;
+	std::string name;
+} ShaderDescriptorBinding;
+
+typedef struct ShaderSpecializationConstant {
+	uint32_t constantId;
+	// In bytes, booleans are VkBool32
+	uint32_t size;
+	std::string name;
+} ShaderSpecializationConstant;
+
+/*
+* The interface of one SPIR-V module, read from its decorations: vertex
+* inputs, descriptor bindings, the push constant block and specialization
+* constants. Only the first entry point is reflected, which is all glslc
+* ever produces.
+*
+* Parsing walks the instruction stream once and only keeps the few
+* instructions the interface depends on (names, decorations, types,
+* constants and global variables), so it is cheap enough to run for every
+* shader at startup.
+*/
+class ShaderReflection {
+public:
+	ShaderReflection() = default;
+	explicit ShaderReflection(ShaderBinary binary);
+
+	VkShaderStageFlagBits getStage() const { return stage; }
+	const std::string& getEntryPoint() const { return entryPoint; }
+	// Sorted by location, empty for anything but vertex shaders
+	const std::vector<ShaderVertexInput>& getVertexInputs() const { return vertexInputs; }
+	// Sorted by set and binding
+	const std::vector<ShaderDescriptorBinding>& getDescriptorBindings() const { return descriptorBindings; }
+	// Size 0 if the shader has no push constant block
+	const VkPushConstantRange& getPushConstantRange() const { return pushConstantRange; }
+	const std::vector<ShaderSpecializationConstant>& getSpecializationConstants() const { return specializationConstants; }
+
+	/*
+	* Throws unless "attributes" feed every vertex input of the shader with
+	* the format it declares. The offsets are up to the C++ side.
+	*/
+	void checkVertexAttributes(const VkVertexInputAttributeDescription* attributes, uint32_t attributeCount) const;
+
+private:
+	typedef struct Type {
+		uint32_t opcode = 0;
+		// Component type of vectors and matrices, element type of arrays, pointee of pointers
+		uint32_t elementType = 0;
+		// Vector components, matrix columns or array length
+		uint32_t count = 1;
+		// Bit width of scalars, dimension of images
+		uint32_t width = 0;
+		// Signedness of integers, "sampled" of images, storage class of pointers
+		uint32_t flags = 0;
+		std::vector<uint32_t> members;
+	} Type;
+
+	typedef struct Decorations {
+		uint32_t location = UINT32_MAX;
+		uint32_t set = 0;
+		uint32_t binding = UINT32_MAX;
+		uint32_t specId = UINT32_MAX;
+		uint32_t arrayStride = 0;
+		bool block = false;
+		bool bufferBlock = false;
+		bool builtIn = false;
+		// Per struct member
+		std::vector<uint32_t> memberOffsets;
+		std::vector<uint32_t> memberMatrixStrides;
+	} Decorations;
+
+	typedef struct Variable {
+		uint32_t id;
+		uint32_t pointerType;
+		uint32_t storageClass;
+	} Variable;
+
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+	std::string entryPoint;
+	std::vector<ShaderVertexInput> vertexInputs;
+	std::vector<ShaderDescriptorBinding> descriptorBindings;
+	VkPushConstantRange pushConstantRange{};
+	std::vector<ShaderSpecializationConstant> specializationConstants;
+
+	// Parser state, cleared once the module is reflected
+	std::unordered_map<uint32_t, std::string> names;
+	std::unordered_map<uint32_t, Decorations> decorations;
+	std::unordered_map<uint32_t, Type> types;
+	std::unordered_map<uint32_t, uint32_t> constants;
+	std::vector<Variable> variables;
+	std::vector<std::pair<uint32_t, uint32_t>> specConstants;
+
+	void parse(ShaderBinary binary);
+	void reflectVariables();
+	const Type& getType(uint32_t id) const;
+	const Decorations* findDecorations(uint32_t id) const;
+	std::string getName(uint32_t id) const;
+	VkDescriptorType getDescriptorType(const Type& type, uint32_t storageClass, uint32_t typeId) const;
+	VkFormat getVertexFormat(const Type& type) const;
+	uint32_t getTypeSize(uint32_t typeId, uint32_t matrixStride) const;
+};
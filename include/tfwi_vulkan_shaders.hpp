@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// SPIR-V words of one shader, ready for VkShaderModuleCreateInfo
+typedef struct ShaderBinary {
+	const uint32_t* code = nullptr;
+	// In bytes, like VkShaderModuleCreateInfo::codeSize
+	size_t size = 0;
+} ShaderBinary;
+
+typedef struct EmbeddedShader {
+	// File name of the SPIR-V the build produced, e.g. "hello_triangle.vert.spv"
+	const char* name;
+	const uint32_t* code;
+	size_t wordCount;
+} EmbeddedShader;
+
+// Generated by the build (add_embedded_shaders in CMakeLists.txt), count is 0 without TFWI_EMBED_SHADERS
+const EmbeddedShader* getEmbeddedShaders(size_t& count);
+
+/*
+* The SPIR-V of every shader, independent of Vulkan.
+*
+* By default the shaders come from static memory: the build compiles them
+* with glslc -O (and spirv-opt, if installed) and embeds the words into the
+* executable, so creating a shader module touches no file. Given a
+* directory, the shaders are loaded from loose .spv files instead, which is
+* handy while editing shaders without relinking. Executables built without
+* embedded shaders always load them from "shaders".
+*/
+class ShaderLibrary {
+public:
+	// Loads "names" from "looseDirectory", or from the executable if that is empty
+	void load(const std::vector<std::string>& names, const std::string& looseDirectory);
+
+	ShaderBinary get(const std::string& name) const;
+	bool isEmbedded() const { return embedded; }
+
+private:
+	bool embedded = false;
+	std::map<std::string, ShaderBinary> binaries;
+	// Storage of loose files
+	std::map<std::string, std::vector<uint32_t>> files;
+
+	static std::vector<uint32_t> readFile(const std::string& filename);
+	static void validate(const std::string& name, const ShaderBinary& binary);
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+* Startup time breakdown, independent of Vulkan.
+*
+* Every initialization step is timed relative to the moment the timer was
+* created, and the time to the first presented frame closes the report. The
+* numbers are printed once, right after that first frame. Steps may be
+* recorded from several threads at once.
+*/
+class StartupTimer {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	StartupTimer() : start(Clock::now()) {}
+
+	// Runs one named initialization step and records when it started and how long it took
+	template<typename Step>
+	void measure(const char* name, Step&& step) {
+		Clock::time_point begin = Clock::now();
+		step();
+		record(name, begin, Clock::now());
+	}
+
+	void record(const char* name, Clock::time_point begin, Clock::time_point end);
+
+	void onFirstFramePresented(Clock::time_point when) { firstFrame = when; }
+	bool isFirstFramePresented() const { return firstFrame != Clock::time_point{}; }
+
+	void report(std::ostream& out) const;
+
+private:
+	typedef struct Step {
+		std::string name;
+		Clock::duration begin;	// Since start
+		Clock::duration duration;
+	} Step;
+
+	Clock::time_point start;
+	Clock::time_point firstFrame;
+	mutable std::mutex stepsMutex;
+	std::vector<Step> steps;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+* A one-shot dependency graph of tasks, run on a small pool of threads.
+*
+* Tasks can only depend on tasks added before them, so the graph can never
+* contain a cycle. Every task starts as soon as all of its dependencies have
+* finished; independent tasks run concurrently and have to touch disjoint
+* state (or synchronize themselves).
+*/
+class TaskGraph {
+public:
+	typedef size_t TaskId;
+	typedef std::function<void()> Work;
+
+	TaskId addTask(const std::string& name, Work work, const std::vector<TaskId>& dependencies = {});
+
+	/*
+	* Runs every task on "threadCount" threads, the calling thread being one of
+	* them, and returns once all tasks have finished. If a task throws, no new
+	* tasks are started and the first exception is rethrown here once the
+	* running ones are done.
+	*/
+	void execute(uint32_t threadCount);
+
+	size_t size() const { return tasks.size(); }
+
+private:
+	typedef struct Task {
+		std::string name;
+		Work work;
+		uint32_t dependencyCount = 0;
+		std::vector<TaskId> dependents;
+	} Task;
+
+	std::vector<Task> tasks;
+};
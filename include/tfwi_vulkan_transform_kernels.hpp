@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TFWI_VULKAN_SIMD_X86 1
+#endif
+
+/*
+* Batched CPU kernels for scenes with many objects:
+*
+* - composeTransforms turns translation/rotation/scale into 4x4 matrices
+* - cullSpheres tests bounding spheres against a view frustum and writes the
+*   indices of the visible ones into a compacted list
+*
+* Inputs are structure-of-arrays so one SIMD register holds the same component
+* of 4 (SSE2) or 8 (AVX2) objects. The instruction set is picked at runtime from
+* the CPU's features, with a scalar fallback everywhere else.
+*
+* This header deliberately avoids glm and the standard containers: the SIMD
+* translation units are compiled with different instruction set flags, and any
+* inline function they instantiate from a shared header could end up being
+* the one the linker keeps for the whole program.
+*/
+
+enum class SimdLevel {
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+// Raw component arrays, each "count" long; rotations are unit quaternions
+typedef struct TransformSoA {
+	const float* positionX;
+	const float* positionY;
+	const float* positionZ;
+	const float* rotationX;
+	const float* rotationY;
+	const float* rotationZ;
+	const float* rotationW;
+	const float* scaleX;
+	const float* scaleY;
+	const float* scaleZ;
+	size_t count;
+} TransformSoA;
+
+typedef struct BoundingSphereSoA {
+	const float* centerX;
+	const float* centerY;
+	const float* centerZ;
+	const float* radius;
+	size_t count;
+} BoundingSphereSoA;
+
+// Normalized planes (a, b, c, d) with the inside where a*x + b*y + c*z + d >= 0
+typedef struct Frustum {
+	float planes[6][4];
+} Frustum;
+
+typedef struct TransformKernels {
+	SimdLevel level;
+
+	// Writes "count" column-major 4x4 matrices (glm::mat4 layout) of T * R * S
+	void (*composeTransforms)(const TransformSoA& transforms, float* matrices);
+
+	/*
+	* Writes the indices of the spheres intersecting the frustum and returns how
+	* many there are. "visibleIndices" must have room for count rounded up to a
+	* multiple of 8, the vector paths store whole registers.
+	*/
+	uint32_t (*cullSpheres)(const BoundingSphereSoA& spheres, const Frustum& frustum, uint32_t* visibleIndices);
+} TransformKernels;
+
+// Best level supported by this CPU and operating system, detected once
+SimdLevel detectSimdLevel();
+const char* getSimdLevelName(SimdLevel level);
+
+// Kernels for the detected level
+const TransformKernels& getTransformKernels();
+// Kernels for a specific level, which must not exceed detectSimdLevel()
+const TransformKernels& getTransformKernels(SimdLevel level);
+
+// Extracts the planes from a column-major view-projection matrix with a [0, 1] depth range
+Frustum extractFrustum(const float* viewProjection);
+
+/*
+* Per instruction set entry points, only meant for the dispatcher. The vector
+* versions hand the last count % width objects to the scalar range versions.
+*/
+void composeTransformsScalarRange(const TransformSoA& transforms, size_t first, float* matrices);
+uint32_t cullSpheresScalarRange(const BoundingSphereSoA& spheres, const Frustum& frustum, size_t first, uint32_t* visibleIndices, uint32_t visibleCount);
+#ifdef TFWI_VULKAN_SIMD_X86
+void composeTransformsSSE2(const TransformSoA& transforms, float* matrices);
+uint32_t cullSpheresSSE2(const BoundingSphereSoA& spheres, const Frustum& frustum, uint32_t* visibleIndices);
+void composeTransformsAVX2(const TransformSoA& transforms, float* matrices);
+uint32_t cullSpheresAVX2(const BoundingSphereSoA& spheres, const Frustum& frustum, uint32_t* visibleIndices);
+#endif
@@ -0,0 +1,67 @@
+#include "tfwi_vulkan_compute.hpp"
+
+#include <stdexcept>
+
+void ComputePipeline::create(
+	VkDevice device,
+	PipelineLayoutCache& layouts,
+	ShaderBinary shaderBinary,
+	const ShaderReflection& reflection) {
+	this->device = device;
+	this->pushConstantSize = reflection.getPushConstantRange().size;
+
+	if (reflection.getStage() != VK_SHADER_STAGE_COMPUTE_BIT) {
+		throw std::runtime_error("A compute pipeline needs a compute shader!");
+	}
+	descriptorSetLayout = layouts.getDescriptorSetLayout({ &reflection }, 0);
+	pipelineLayout = layouts.getPipelineLayout({ &reflection });
+
+	VkShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = shaderBinary.size;
+	moduleInfo.pCode = shaderBinary.code;
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute shader module!");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+	vkDestroyShaderModule(device, shaderModule, nullptr);
+
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline!");
+	}
+}
+
+void ComputePipeline::destroy() {
+	// The layouts belong to the PipelineLayoutCache
+	vkDestroyPipeline(device, pipeline, nullptr);
+
+	pipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorSetLayout = VK_NULL_HANDLE;
+}
+
+void ComputePipeline::bind(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, const void* pushConstants) const {
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+	if (pushConstants != nullptr && pushConstantSize > 0) {
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize, pushConstants);
+	}
+}
+
+void ComputePipeline::dispatch(VkCommandBuffer commandBuffer, uint32_t invocationCount, uint32_t localSize) {
+	vkCmdDispatch(commandBuffer, (invocationCount + localSize - 1) / localSize, 1, 1);
+}
@@ -0,0 +1,29 @@
+#include "tfwi_vulkan_deletion_queue.hpp"
+
+#include <algorithm>
+
+void DeletionQueue::push(uint64_t retireValue, Deleter deleter) {
+	Entry entry{ retireValue, std::move(deleter) };
+
+	// Keep the queue sorted so flush() can stop at the first entry still in use
+	auto position = std::upper_bound(entries.begin(), entries.end(), retireValue,
+		[](uint64_t value, const Entry& other) { return value < other.retireValue; });
+	entries.insert(position, std::move(entry));
+}
+
+void DeletionQueue::flush(uint64_t completedValue) {
+	while (!entries.empty() && entries.front().retireValue <= completedValue) {
+		// Pop first, a deleter may push further entries
+		Deleter deleter = std::move(entries.front().deleter);
+		entries.pop_front();
+		deleter();
+	}
+}
+
+void DeletionQueue::flushAll() {
+	while (!entries.empty()) {
+		Deleter deleter = std::move(entries.front().deleter);
+		entries.pop_front();
+		deleter();
+	}
+}
@@ -0,0 +1,166 @@
+#include "tfwi_vulkan_draw_list.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+static const uint32_t passBits = 4;
+static const uint32_t pipelineBits = 12;
+static const uint32_t descriptorSetBits = 12;
+static const uint32_t meshBits = 12;
+static const uint32_t depthBits = 24;
+
+static_assert(passBits + pipelineBits + descriptorSetBits + meshBits + depthBits == 64, "Draw keys have 64 bits!");
+static_assert((1u << pipelineBits) - 1 == maxDrawKeyId && (1u << descriptorSetBits) - 1 == maxDrawKeyId &&
+	(1u << meshBits) - 1 == maxDrawKeyId, "Id fields have to match maxDrawKeyId!");
+
+static uint64_t packField(uint64_t key, uint32_t value, uint32_t bits) {
+	if (value >= (1u << bits)) {
+		throw std::runtime_error("Draw key field out of range!");
+	}
+	return (key << bits) | value;
+}
+
+static uint32_t unpackField(uint64_t& key, uint32_t bits) {
+	uint32_t value = static_cast<uint32_t>(key & ((1ull << bits) - 1));
+	key >>= bits;
+	return value;
+}
+
+uint64_t encodeDrawKey(const DrawKeyFields& fields) {
+	uint64_t key = 0;
+	key = packField(key, fields.pass, passBits);
+	key = packField(key, fields.pipeline, pipelineBits);
+	key = packField(key, fields.descriptorSet, descriptorSetBits);
+	key = packField(key, fields.mesh, meshBits);
+	key = packField(key, fields.depth, depthBits);
+	return key;
+}
+
+DrawKeyFields decodeDrawKey(uint64_t key) {
+	DrawKeyFields fields{};
+	fields.depth = unpackField(key, depthBits);
+	fields.mesh = unpackField(key, meshBits);
+	fields.descriptorSet = unpackField(key, descriptorSetBits);
+	fields.pipeline = unpackField(key, pipelineBits);
+	fields.pass = unpackField(key, passBits);
+	return fields;
+}
+
+uint32_t quantizeDrawDepth(float depth) {
+	const float maxDepth = static_cast<float>((1u << depthBits) - 1);
+	// Written so NaN ends up at 0 as well
+	float clamped = depth > 0.0f ? std::min(depth, 1.0f) : 0.0f;
+	return static_cast<uint32_t>(clamped * maxDepth + 0.5f);
+}
+
+void DrawList::sort() {
+	const size_t count = entries.size();
+	if (count < 2) {
+		return;
+	}
+
+	std::array<std::array<uint32_t, 256>, 8> histograms{};
+	for (const auto& entry : entries) {
+		for (uint32_t digit = 0; digit < 8; digit++) {
+			histograms[digit][(entry.key >> (digit * 8)) & 0xFF]++;
+		}
+	}
+
+	scratch.resize(count);
+	for (uint32_t digit = 0; digit < 8; digit++) {
+		std::array<uint32_t, 256>& histogram = histograms[digit];
+
+		// Every key has the same byte here, the pass would not move anything
+		if (histogram[(entries[0].key >> (digit * 8)) & 0xFF] == count) {
+			continue;
+		}
+
+		// Counts to the first output index of each byte value
+		uint32_t offset = 0;
+		for (auto& bucket : histogram) {
+			uint32_t bucketSize = bucket;
+			bucket = offset;
+			offset += bucketSize;
+		}
+
+		for (const auto& entry : entries) {
+			scratch[histogram[(entry.key >> (digit * 8)) & 0xFF]++] = entry;
+		}
+		entries.swap(scratch);
+	}
+}
+
+uint32_t DrawIdTable::get(uint64_t handle) {
+	if (handle == 0) {
+		return 0;
+	}
+
+	auto found = ids.find(handle);
+	if (found != ids.end()) {
+		return found->second;
+	}
+	if (ids.size() >= maxDrawKeyId) {
+		throw std::runtime_error("Draw list binds more distinct handles than draw keys can tell apart!");
+	}
+
+	uint32_t id = static_cast<uint32_t>(ids.size()) + 1;
+	ids.emplace(handle, id);
+	return id;
+}
+
+void DrawIdTable::trim() {
+	// Keeps room for a whole draw list of new handles
+	if (ids.size() > maxDrawKeyId / 2) {
+		ids.clear();
+	}
+}
+
+void DrawStateTracker::reset() {
+	valid.fill(false);
+}
+
+bool DrawStateTracker::bind(DrawState state, uint64_t id) {
+	size_t index = static_cast<size_t>(state);
+	if (valid[index] && bound[index] == id) {
+		skippedThisPeriod[index]++;
+		return false;
+	}
+
+	bound[index] = id;
+	valid[index] = true;
+	bindsThisPeriod[index]++;
+	return true;
+}
+
+void DrawStateTracker::report(std::ostream& out, Clock::time_point now) {
+	if (lastReport == Clock::time_point{}) {
+		lastReport = now;
+		return;
+	}
+
+	if (now - lastReport < reportPeriod || framesThisPeriod == 0) {
+		return;
+	}
+
+	static const char* stateNames[stateCount] = { "pipeline", "descriptor set", "vertex buffer", "index buffer" };
+
+	double frames = framesThisPeriod;
+	uint64_t skipped = 0;
+	out << "Draw state: " << drawsThisPeriod / frames << " draws";
+	for (size_t i = 0; i < stateCount; i++) {
+		out << ", " << bindsThisPeriod[i] / frames << ' ' << stateNames[i];
+		skipped += skippedThisPeriod[i];
+	}
+	out << " binds per frame, " << skipped / frames << " redundant binds skipped";
+	if (waitingDrawsThisPeriod > 0) {
+		out << ", " << waitingDrawsThisPeriod / frames << " draws waiting for their pipeline";
+	}
+	out << '\n';
+
+	bindsThisPeriod.fill(0);
+	skippedThisPeriod.fill(0);
+	drawsThisPeriod = 0;
+	waitingDrawsThisPeriod = 0;
+	framesThisPeriod = 0;
+	lastReport = now;
+}
@@ -0,0 +1,70 @@
+#include "tfwi_vulkan_dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolutionController::setScaleRange(double minimum, double maximum) {
+	minScale = std::max(0.1, std::min(minimum, maximum));
+	maxScale = std::max(minScale, maximum);
+	scale = std::min(std::max(scale, minScale), maxScale);
+}
+
+void DynamicResolutionController::onGpuFrameTime(double seconds, double frameScale) {
+	gpuTimeSum += seconds;
+	samplesThisPeriod++;
+
+	// Frames recorded before the last change say nothing about the current scale
+	if (frameScale != scale || seconds <= 0.0) {
+		return;
+	}
+
+	gpuTime = gpuTime == 0.0 ? seconds : gpuTime + smoothing * (seconds - gpuTime);
+
+	double ratio = targetFrameTime / gpuTime;
+	if (std::abs(ratio - 1.0) < deadband) {
+		return;
+	}
+
+	double desired = scale * std::sqrt(ratio);
+	desired = std::min(desired, scale * (1.0 + maxIncrease));
+	desired = std::max(desired, scale * (1.0 - maxDecrease));
+	desired = std::min(std::max(desired, minScale), maxScale);
+
+	if (std::abs(desired - scale) < minStep && desired != minScale && desired != maxScale) {
+		return;
+	}
+	if (desired == scale) {
+		return;
+	}
+
+	scale = desired;
+	// Start over with samples of the new scale
+	gpuTime = 0.0;
+}
+
+void DynamicResolutionController::getRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const {
+	width = std::max(1u, static_cast<uint32_t>(std::lround(outputWidth * scale)));
+	height = std::max(1u, static_cast<uint32_t>(std::lround(outputHeight * scale)));
+	width = std::min(width, outputWidth);
+	height = std::min(height, outputHeight);
+}
+
+void DynamicResolutionController::report(std::ostream& out, Clock::time_point now) {
+	if (lastReport == Clock::time_point{}) {
+		lastReport = now;
+		return;
+	}
+
+	if (now - lastReport < reportPeriod) {
+		return;
+	}
+
+	double averageGpuTime = samplesThisPeriod > 0 ? gpuTimeSum / samplesThisPeriod : 0.0;
+	out << "Dynamic resolution: scale " << scale
+		<< ", GPU " << averageGpuTime * 1000.0 << " ms"
+		<< ", target " << targetFrameTime * 1000.0 << " ms\n";
+
+	gpuTimeSum = 0.0;
+	samplesThisPeriod = 0;
+	lastReport = now;
+}
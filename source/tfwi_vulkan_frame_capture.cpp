@@ -0,0 +1,109 @@
+#include "tfwi_vulkan_frame_capture.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	const char captureMagic[8] = { 'T', 'F', 'W', 'I', 'F', 'C', 'A', 'P' };
+	const uint32_t captureVersion = 2;
+
+	// Sanity limit while reading, a corrupt count should not allocate gigabytes
+	const uint32_t maxDrawsPerFrame = 1 << 16;
+
+	template<typename T>
+	void writeValue(std::ofstream& file, const T& value) {
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool readValue(std::ifstream& file, T& value) {
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+}
+
+void FrameCaptureWriter::open(const std::string& path) {
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open capture file:\n\"" + path + "\"!");
+	}
+
+	file.write(captureMagic, sizeof(captureMagic));
+	writeValue(file, captureVersion);
+	writeValue(file, static_cast<uint32_t>(sizeof(UniformBufferObject)));
+	frameCount = 0;
+}
+
+void FrameCaptureWriter::write(const FrameInputs& frame) {
+	writeValue(file, frame.time);
+	writeValue(file, frame.deltaTime);
+	writeValue(file, frame.width);
+	writeValue(file, frame.height);
+	writeValue(file, frame.ubo);
+	writeValue(file, static_cast<uint32_t>(frame.draws.size()));
+	for (const auto& draw : frame.draws) {
+		writeValue(file, draw);
+	}
+
+	if (!file) {
+		throw std::runtime_error("Failed to write capture file!");
+	}
+	frameCount++;
+}
+
+void FrameCaptureWriter::close() {
+	file.close();
+}
+
+void FrameCaptureReader::open(const std::string& capturePath) {
+	path = capturePath;
+	file.open(path, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open capture file:\n\"" + path + "\"!");
+	}
+
+	char magic[sizeof(captureMagic)];
+	uint32_t version = 0;
+	uint32_t uboSize = 0;
+	if (!file.read(magic, sizeof(magic)) ||
+		memcmp(magic, captureMagic, sizeof(magic)) != 0 ||
+		!readValue(file, version) ||
+		!readValue(file, uboSize)) {
+		throw std::runtime_error("\"" + path + "\" is not a frame capture!");
+	}
+
+	// Version 1 draws have no level of detail flag, reading them as version 2 records would misalign every frame
+	if (version == 1) {
+		throw std::runtime_error("Frame capture \"" + path + "\" predates level of detail draws (version 1), capture it again!");
+	}
+	if (version != captureVersion || uboSize != sizeof(UniformBufferObject)) {
+		throw std::runtime_error("Frame capture \"" + path + "\" was written by an incompatible build!");
+	}
+	frameCount = 0;
+}
+
+bool FrameCaptureReader::read(FrameInputs& frame) {
+	// A clean end of file can only happen before a record
+	if (!readValue(file, frame.time)) {
+		return false;
+	}
+
+	uint32_t drawCount = 0;
+	if (!readValue(file, frame.deltaTime) ||
+		!readValue(file, frame.width) ||
+		!readValue(file, frame.height) ||
+		!readValue(file, frame.ubo) ||
+		!readValue(file, drawCount) ||
+		drawCount > maxDrawsPerFrame) {
+		throw std::runtime_error("Frame capture \"" + path + "\" is truncated or corrupt!");
+	}
+
+	frame.draws.resize(drawCount);
+	for (auto& draw : frame.draws) {
+		if (!readValue(file, draw)) {
+			throw std::runtime_error("Frame capture \"" + path + "\" is truncated or corrupt!");
+		}
+	}
+
+	frameCount++;
+	return true;
+}
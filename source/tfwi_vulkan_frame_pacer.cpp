@@ -0,0 +1,130 @@
+#include "tfwi_vulkan_frame_pacer.hpp"
+
+#include <algorithm>
+
+namespace {
+	double toSeconds(FramePacer::Clock::duration duration) {
+		return std::chrono::duration<double>(duration).count();
+	}
+
+	double toMilliseconds(double seconds) {
+		return seconds * 1000.0;
+	}
+}
+
+FramePacer::Clock::duration FramePacer::getFrameStartDelay() const {
+	/*
+	* The next frame can be shown one interval after the previous one completed,
+	* and it needs cpuTime + gpuTime to get there. Everything left over is time
+	* the frame would otherwise spend waiting in the queue, so spend it before
+	* sampling input instead.
+	*/
+	double slack = completionInterval - cpuTime - gpuTime - toSeconds(safetyMargin);
+	if (slack <= 0.0) {
+		return Clock::duration::zero();
+	}
+
+	slack = std::min(slack, completionInterval);
+	return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(slack));
+}
+
+void FramePacer::onInputSampled(Clock::time_point when) {
+	inputSampled = when;
+}
+
+void FramePacer::onSubmitted(uint64_t frameValue, Clock::time_point when) {
+	double sample = toSeconds(when - inputSampled);
+	updateAverage(cpuTime, sample);
+	inputToSubmit.add(sample);
+	framesThisPeriod++;
+
+	PendingFrame frame{};
+	frame.frameValue = frameValue;
+	frame.submitted = when;
+	pending.push_back(frame);
+}
+
+void FramePacer::onRetired(uint64_t frameValue, Clock::time_point when) {
+	PendingFrame* frame = findPending(frameValue);
+	if (frame == nullptr || frame->retired) {
+		return;
+	}
+
+	double sample = toSeconds(when - frame->submitted);
+	updateAverage(gpuTime, sample);
+	submitToRetire.add(sample);
+	frame->retired = true;
+
+	if (!presentTimesMeasured) {
+		// Frames retire in submission order, so everything older is done as well
+		while (!pending.empty() && pending.front().frameValue <= frameValue) {
+			pending.pop_front();
+		}
+		onCompleted(when);
+	}
+}
+
+void FramePacer::onPresented(uint64_t frameValue, Clock::time_point when) {
+	PendingFrame* frame = findPending(frameValue);
+	if (frame == nullptr) {
+		return;
+	}
+
+	submitToPresent.add(toSeconds(when - frame->submitted));
+
+	while (!pending.empty() && pending.front().frameValue <= frameValue) {
+		pending.pop_front();
+	}
+	onCompleted(when);
+}
+
+void FramePacer::report(std::ostream& out, Clock::time_point now) {
+	if (lastReport == Clock::time_point{}) {
+		lastReport = now;
+		return;
+	}
+
+	if (now - lastReport < reportPeriod) {
+		return;
+	}
+
+	double elapsed = toSeconds(now - lastReport);
+
+	out << "Frame pacing: " << framesThisPeriod / elapsed << " fps"
+		<< ", input->submit " << toMilliseconds(inputToSubmit.average()) << " ms"
+		<< ", submit->GPU done " << toMilliseconds(submitToRetire.average()) << " ms";
+	if (presentTimesMeasured) {
+		out << ", submit->present " << toMilliseconds(submitToPresent.average()) << " ms";
+	}
+	out << ", start delay " << toMilliseconds(toSeconds(getFrameStartDelay())) << " ms\n";
+
+	inputToSubmit = Accumulator{};
+	submitToRetire = Accumulator{};
+	submitToPresent = Accumulator{};
+	framesThisPeriod = 0;
+	lastReport = now;
+}
+
+uint64_t FramePacer::getOldestPendingFrame() const {
+	return pending.empty() ? 0 : pending.front().frameValue;
+}
+
+FramePacer::PendingFrame* FramePacer::findPending(uint64_t frameValue) {
+	for (auto& frame : pending) {
+		if (frame.frameValue == frameValue) {
+			return &frame;
+		}
+	}
+	return nullptr;
+}
+
+void FramePacer::onCompleted(Clock::time_point when) {
+	if (lastCompletion != Clock::time_point{}) {
+		updateAverage(completionInterval, toSeconds(when - lastCompletion));
+	}
+	lastCompletion = when;
+}
+
+void FramePacer::updateAverage(double& average, double sample) const {
+	average = average == 0.0 ? sample : average + smoothing * (sample - average);
+}
@@ -0,0 +1,182 @@
+#include "tfwi_vulkan_frame_readback.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+bool FrameReadback::isFormatSupported(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void FrameReadback::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, DeviceMemoryTracker& memoryTracker,
+	uint32_t slotCount, FrameRecorder& recorder) {
+	this->device = device;
+	this->memoryProperties = memoryProperties;
+	this->memoryTracker = &memoryTracker;
+	this->recorder = &recorder;
+	slots.assign(slotCount, Slot{});
+	nextSlot = 0;
+	oldestSlot = 0;
+}
+
+void FrameReadback::destroy() {
+	for (auto& slot : slots) {
+		releaseSlot(slot);
+	}
+	slots.clear();
+}
+
+void FrameReadback::recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent2D extent, uint64_t frameValue) {
+	Slot& slot = slots[nextSlot];
+	if (slot.frameValue != 0) {
+		throw std::runtime_error("Frame readback slot reused before its copy was harvested!");
+	}
+
+	VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+	if (slot.capacity < size) {
+		resizeSlot(slot, size);
+	}
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	// Tightly packed rows
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+	// Makes the copy visible to host reads once the frame timeline reached frameValue
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = slot.buffer;
+	barrier.offset = 0;
+	barrier.size = size;
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	slot.frameValue = frameValue;
+	slot.extent = extent;
+	slot.bgra = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+	nextSlot = (nextSlot + 1) % slots.size();
+}
+
+void FrameReadback::harvest(uint64_t completedFrameValue) {
+	/*
+	* Copies are recorded in frame order into consecutive slots, so walking the
+	* ring from the oldest pending slot hands frames to the recorder in order.
+	* Stop at the first copy still in flight, even if a later one already
+	* retired, or the recording would get frames out of order.
+	*/
+	while (!slots.empty()) {
+		Slot& slot = slots[oldestSlot];
+		if (slot.frameValue == 0 || slot.frameValue > completedFrameValue) {
+			break;
+		}
+
+		size_t size = static_cast<size_t>(slot.extent.width) * slot.extent.height * 4;
+		if (!slot.coherent) {
+			VkMappedMemoryRange range{};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = slot.memory;
+			range.offset = 0;
+			range.size = VK_WHOLE_SIZE;
+			vkInvalidateMappedMemoryRanges(device, 1, &range);
+		}
+
+		RecordedFrame frame;
+		frame.index = slot.frameValue;
+		frame.width = slot.extent.width;
+		frame.height = slot.extent.height;
+		frame.bgra = slot.bgra;
+		frame.pixels = recorder->acquirePixels();
+		frame.pixels.resize(size);
+		std::memcpy(frame.pixels.data(), slot.mapped, size);
+		recorder->submit(std::move(frame));
+
+		slot.frameValue = 0;
+		copiedFrames++;
+		oldestSlot = (oldestSlot + 1) % slots.size();
+	}
+}
+
+void FrameReadback::resizeSlot(Slot& slot, VkDeviceSize size) {
+	releaseSlot(slot);
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &slot.buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create readback buffer!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device, slot.buffer, &memRequirements);
+
+	// Host cached memory first, reading uncached memory on the CPU is very slow
+	const VkMemoryPropertyFlags preferences[] = {
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	};
+	uint32_t memoryTypeIndex = UINT32_MAX;
+	for (VkMemoryPropertyFlags wanted : preferences) {
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && memoryTypeIndex == UINT32_MAX; i++) {
+			if ((memRequirements.memoryTypeBits & (1 << i)) &&
+				(memoryProperties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+				memoryTypeIndex = i;
+			}
+		}
+	}
+	if (memoryTypeIndex == UINT32_MAX) {
+		throw std::runtime_error("Failed to find suitable memory type for readback buffer!");
+	}
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	if (memoryTracker->allocate(allocInfo, MemoryUsage::Readback, &slot.memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate readback buffer memory!");
+	}
+
+	vkBindBufferMemory(device, slot.buffer, slot.memory, 0);
+
+	if (vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to map readback buffer memory!");
+	}
+
+	slot.capacity = size;
+	slot.coherent = (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+void FrameReadback::releaseSlot(Slot& slot) {
+	if (slot.buffer == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vkUnmapMemory(device, slot.memory);
+	vkDestroyBuffer(device, slot.buffer, nullptr);
+	memoryTracker->free(slot.memory);
+	slot = Slot{};
+}
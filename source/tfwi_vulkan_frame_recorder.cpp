@@ -0,0 +1,266 @@
+#include "tfwi_vulkan_frame_recorder.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+	uint32_t crcTable[256];
+
+	void initCrcTable() {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			crcTable[n] = c;
+		}
+	}
+
+	uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) {
+			crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	void appendChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+		appendBigEndian(out, static_cast<uint32_t>(data.size()));
+		size_t typeStart = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		appendBigEndian(out, crc32(out.data() + typeStart, out.size() - typeStart));
+	}
+}
+
+std::vector<uint8_t> encodePng(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra) {
+	static std::once_flag crcTableReady;
+	std::call_once(crcTableReady, initCrcTable);
+
+	std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	std::vector<uint8_t> header;
+	appendBigEndian(header, width);
+	appendBigEndian(header, height);
+	header.push_back(8);	// Bits per channel
+	header.push_back(6);	// RGBA
+	header.push_back(0);	// Deflate
+	header.push_back(0);	// Adaptive filtering (every row uses filter 0, "none")
+	header.push_back(0);	// Not interlaced
+	appendChunk(png, "IHDR", header);
+
+	// Filter byte + pixels of every row
+	size_t rowSize = 1 + static_cast<size_t>(width) * 4;
+	std::vector<uint8_t> scanlines(rowSize * height);
+	for (uint32_t y = 0; y < height; y++) {
+		uint8_t* row = &scanlines[y * rowSize];
+		const uint8_t* source = pixels + static_cast<size_t>(y) * width * 4;
+		row[0] = 0;
+		for (uint32_t x = 0; x < width; x++) {
+			row[1 + 4 * x + 0] = source[4 * x + (bgra ? 2 : 0)];
+			row[1 + 4 * x + 1] = source[4 * x + 1];
+			row[1 + 4 * x + 2] = source[4 * x + (bgra ? 0 : 2)];
+			row[1 + 4 * x + 3] = source[4 * x + 3];
+		}
+	}
+
+	/*
+	* A zlib stream made of "stored" deflate blocks: no compression, but also no
+	* dependency and barely any CPU time on the writer thread.
+	*/
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	const size_t maxBlock = 65535;
+	size_t offset = 0;
+	do {
+		size_t blockSize = std::min(maxBlock, scanlines.size() - offset);
+		bool last = offset + blockSize == scanlines.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(static_cast<uint8_t>(blockSize));
+		zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+		zlib.push_back(static_cast<uint8_t>(~blockSize));
+		zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+		zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+		offset += blockSize;
+	} while (offset < scanlines.size());
+
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (uint8_t byte : scanlines) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	appendBigEndian(zlib, (b << 16) | a);
+	appendChunk(png, "IDAT", zlib);
+
+	appendChunk(png, "IEND", {});
+	return png;
+}
+
+FrameRecorder::~FrameRecorder() {
+	close();
+}
+
+void FrameRecorder::open(const std::string& path, RecordingFormat format, Logger& logger) {
+	if (isOpen()) {
+		throw std::runtime_error("Frame recorder is already open!");
+	}
+
+	this->path = path;
+	this->format = format;
+	this->logger = &logger;
+	stopping = false;
+	failed = false;
+	rawWidth = 0;
+	rawHeight = 0;
+	rawSegment = 0;
+	writer = std::thread([this]() { writerLoop(); });
+}
+
+void FrameRecorder::close() {
+	if (!isOpen()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeUp.notify_one();
+	writer.join();
+
+	if (rawFile.is_open()) {
+		rawFile.close();
+	}
+}
+
+std::vector<uint8_t> FrameRecorder::acquirePixels() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (sparePixels.empty()) {
+		return {};
+	}
+
+	std::vector<uint8_t> pixels = std::move(sparePixels.back());
+	sparePixels.pop_back();
+	return pixels;
+}
+
+bool FrameRecorder::submit(RecordedFrame&& frame) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (failed) {
+			sparePixels.push_back(std::move(frame.pixels));
+			return false;
+		}
+		if (queue.size() >= maxQueuedFrames) {
+			droppedFrames++;
+			sparePixels.push_back(std::move(frame.pixels));
+			return false;
+		}
+		queue.push_back(std::move(frame));
+	}
+	wakeUp.notify_one();
+	return true;
+}
+
+uint64_t FrameRecorder::getWrittenFrameCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return writtenFrames;
+}
+
+uint64_t FrameRecorder::getDroppedFrameCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return droppedFrames;
+}
+
+bool FrameRecorder::hasFailed() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return failed;
+}
+
+void FrameRecorder::writerLoop() {
+	while (true) {
+		RecordedFrame frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeUp.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (queue.empty()) {
+				return;
+			}
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		bool written = format == RecordingFormat::Raw ? writeRaw(frame) : writePng(frame);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		frame.pixels.clear();
+		sparePixels.push_back(std::move(frame.pixels));
+		if (written) {
+			writtenFrames++;
+			continue;
+		}
+
+		// Stop at the first error instead of retrying (and logging) every frame
+		failed = true;
+		for (auto& queued : queue) {
+			sparePixels.push_back(std::move(queued.pixels));
+		}
+		queue.clear();
+	}
+}
+
+bool FrameRecorder::writeRaw(const RecordedFrame& frame) {
+	if (!rawFile.is_open() || frame.width != rawWidth || frame.height != rawHeight) {
+		// Raw video has no header, so every frame size gets its own file
+		rawPath = rawSegment == 0 ? path : path + "." + std::to_string(rawSegment);
+		rawSegment++;
+
+		if (rawFile.is_open()) {
+			rawFile.close();
+		}
+		rawFile.open(rawPath, std::ios::binary | std::ios::trunc);
+		if (!rawFile.is_open()) {
+			logger->log(LogSeverity::Error, LogCategory::General, "Failed to open recording file \"" + rawPath + "\", recording stopped!");
+			return false;
+		}
+		rawWidth = frame.width;
+		rawHeight = frame.height;
+	}
+
+	rawFile.write(reinterpret_cast<const char*>(frame.pixels.data()), frame.pixels.size());
+	if (!rawFile.good()) {
+		logger->log(LogSeverity::Error, LogCategory::General, "Failed to write recording file \"" + rawPath + "\" (disk full?), recording stopped!");
+		rawFile.close();
+		return false;
+	}
+	return true;
+}
+
+bool FrameRecorder::writePng(const RecordedFrame& frame) {
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), "_%06llu.png", static_cast<unsigned long long>(frame.index));
+
+	std::vector<uint8_t> png = encodePng(frame.pixels.data(), frame.width, frame.height, frame.bgra);
+	std::string framePath = path + suffix;
+	std::ofstream file(framePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		logger->log(LogSeverity::Error, LogCategory::General, "Failed to open recording file \"" + framePath + "\", recording stopped!");
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(png.data()), png.size());
+	file.close();
+	if (!file.good()) {
+		logger->log(LogSeverity::Error, LogCategory::General, "Failed to write recording file \"" + framePath + "\" (disk full?), recording stopped!");
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,92 @@
+#include "tfwi_vulkan_frame_scheduler.hpp"
+
+#include <thread>
+
+void FrameScheduler::setMaxFrameRate(double framesPerSecond) {
+	if (framesPerSecond <= 0.0) {
+		minFrameInterval = Clock::duration::zero();
+		return;
+	}
+	minFrameInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+}
+
+void FrameScheduler::setSuspended(bool suspended) {
+	this->suspended = suspended;
+	if (!suspended) {
+		// Whatever was on screen before is gone
+		invalidated = true;
+	}
+}
+
+bool FrameScheduler::isFrameDue(Clock::time_point now) const {
+	if (suspended) {
+		return false;
+	}
+	if (!onDemand || invalidated) {
+		return true;
+	}
+	return refreshInterval > Clock::duration::zero() && now - lastFrameDrawn >= refreshInterval;
+}
+
+FrameScheduler::Clock::duration FrameScheduler::getIdleTimeout(Clock::time_point now) const {
+	if (suspended) {
+		return Clock::duration::max();
+	}
+	if (isFrameDue(now)) {
+		return Clock::duration::zero();
+	}
+	if (refreshInterval > Clock::duration::zero()) {
+		return lastFrameDrawn + refreshInterval - now;
+	}
+	return Clock::duration::max();
+}
+
+void FrameScheduler::waitForFrameSlot() {
+	if (minFrameInterval == Clock::duration::zero()) {
+		return;
+	}
+
+	Clock::time_point slot = lastFrameSlot + minFrameInterval;
+	Clock::time_point now = Clock::now();
+	if (now < slot) {
+		if (slot - now > spinThreshold) {
+			std::this_thread::sleep_until(slot - spinThreshold);
+		}
+		while (Clock::now() < slot) {
+			std::this_thread::yield();
+		}
+		lastFrameSlot = slot;
+	}
+	else if (now - slot < minFrameInterval) {
+		// Slightly late, keep the cadence instead of drifting
+		lastFrameSlot = slot;
+	}
+	else {
+		// After a pause (or a slow frame) start over from now, no burst of catch-up frames
+		lastFrameSlot = now;
+	}
+}
+
+void FrameScheduler::onFrameDrawn(Clock::time_point now) {
+	invalidated = false;
+	lastFrameDrawn = now;
+	framesThisPeriod++;
+}
+
+void FrameScheduler::report(std::ostream& out, Clock::time_point now) {
+	if (lastReport == Clock::time_point{}) {
+		lastReport = now;
+		return;
+	}
+
+	if (now - lastReport < reportPeriod) {
+		return;
+	}
+
+	double elapsed = std::chrono::duration<double>(now - lastReport).count();
+	out << "Frame scheduler: " << framesThisPeriod << " frames in " << elapsed << " s"
+		<< (onDemand ? ", on demand" : "") << '\n';
+
+	framesThisPeriod = 0;
+	lastReport = now;
+}
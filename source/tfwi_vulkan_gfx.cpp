@@ -1,7 +1,5 @@
 #include "tfwi_vulkan_gfx.hpp"
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
-
 const std::vector<Vertex> vertices = {
 	{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
 	{{ 0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
@@ -44,26 +42,132 @@ void DestroyDebugUtilsMessengerEXT(
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	// Families without graphics support, for asynchronous uploads and compute work
+	std::optional<uint32_t> transferFamily;
+	std::optional<uint32_t> computeFamily;
 
-	bool isComplete() {
+	bool isComplete() const {
 		return graphicsFamily.has_value() &&
 			presentFamily.has_value();
 	}
 };
 
+/*
+* Everything about a physical device the renderer looks up more than once,
+* queried a single time per device while picking one.
+*/
+struct DeviceCapabilities {
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	std::vector<VkQueueFamilyProperties> queueFamilyProperties;
+	QueueFamilyIndices queueFamilies;
+	std::vector<VkExtensionProperties> extensions;
+	bool timelineSemaphore = false;
+
+	bool hasExtension(const char* extensionName) const {
+		return std::any_of(extensions.begin(), extensions.end(),
+			[extensionName](const VkExtensionProperties& extension) {
+				return strcmp(extension.extensionName, extensionName) == 0;
+			});
+	}
+};
+
 struct SwapChainSupportDetails {
 	VkSurfaceCapabilitiesKHR capabilities;
 	std::vector<VkSurfaceFormatKHR> formats;
 	std::vector<VkPresentModeKHR> presentModes;
 };
 
+/*
+* A uniform buffer and descriptor set per swap chain image of one window.
+* The buffers stay mapped; the scene and camera versions each one was last
+* written with decide which matrices have to be copied into it again.
+*/
+// The handles a draw binds, resolved per view by sortDrawList
+struct BoundDraw {
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+};
+
+struct WindowUniforms {
+	std::vector<VkBuffer> buffers;
+	std::vector<VkDeviceMemory> memory;
+	std::vector<void*> mapped;
+	std::vector<uint64_t> sceneVersions;
+	std::vector<uint64_t> cameraVersions;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> descriptorSets;
+};
+
+/*
+* Every window after the first one. It shares the device, pipelines and
+* geometry and only owns what is tied to its surface: the swap chain, a
+* render graph drawing the scene pass into it, its uniforms and its camera,
+* whose projection follows the window's aspect ratio.
+*/
+struct SecondaryWindow {
+	GLFWwindow* window = nullptr;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	// VK_NULL_HANDLE while the window is minimized
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+	std::vector<VkImage> images;
+	std::vector<VkImageView> imageViews;
+	VkExtent2D extent = { 0, 0 };
+	// Read on the main thread before every (re)creation of the swap chain, which may happen on a startup worker
+	VkExtent2D framebufferSize = { 0, 0 };
+	RenderGraph renderGraph;
+	WindowUniforms uniforms;
+	SceneCamera camera;
+	// Per frame in flight
+	std::vector<VkSemaphore> imageAvailableSemaphores;
+	// Timeline value of the last frame which rendered into each swap chain image
+	std::vector<uint64_t> imageFrameValues;
+	// Per swap chain image, only with a separate present family
+	std::vector<VkCommandBuffer> presentAcquireCommandBuffers;
+	// Image acquired for the frame being built, UINT32_MAX if the window sits the frame out
+	uint32_t imageIndex = UINT32_MAX;
+	// Scene mesh level of detail and its draw key depth for this window's camera
+	uint32_t lodLevel = 0;
+	float sceneDepth = 0.0f;
+	bool resized = false;
+};
+
 class HelloTriangleApplication {
 public:
 	const uint32_t window_width = 800;
 	const uint32_t window_height = 600;
+	const float cameraNearPlane = 0.1f;
+	const float cameraFarPlane = 10.0f;
 	const std::vector<const char*> deviceExtensions = {
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
+	const uint32_t particleCount = 16384;
+	const uint32_t particleWorkgroupSize = 256; // local_size_x in particles.comp
+	const std::vector<std::string> shaderFiles = {
+		"hello_triangle.vert.spv",
+		"hello_triangle.frag.spv",
+		"particles.vert.spv",
+		"particles.comp.spv"
+	};
+
+	HelloTriangleApplication(const ApplicationSettings& settings)
+		: settings(settings) {
+		logger.setMinimumSeverity(settings.logLevel);
+		logger.setRateLimit(settings.logRateLimit);
+		for (int32_t messageId : settings.mutedMessageIds) {
+			logger.muteMessageId(messageId);
+		}
+		resolutionController.setTargetFrameTime(settings.dynamicResolutionTarget / 1000.0);
+		resolutionController.setScaleRange(settings.minRenderScale / 100.0, 1.0);
+		// Replays render every captured frame back to back
+		frameScheduler.setOnDemand(settings.onDemand && settings.replayFile.empty());
+		frameScheduler.setMaxFrameRate(settings.maxFrameRate);
+		frameScheduler.setRefreshInterval(std::chrono::milliseconds(settings.refreshInterval));
+		jobSystem.start(settings.jobThreads);
+		changedSceneRanges.resize(jobSystem.getWorkerCount());
+	}
 
 #ifndef NDEBUG
 	const std::vector<const char*> validationLayers = {
@@ -76,60 +180,271 @@ public:
 		const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
 		void* pUserData) {
 
-		std::cerr << "Validation layer: " << pCallbackData->pMessage << '\n';
+		/*
+		* Called from inside the driver, on whichever thread made the Vulkan call.
+		* The logger only copies the message into its ring, a background thread
+		* does the formatting and writing.
+		*/
+		LogSeverity severity = LogSeverity::Verbose;
+		if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+			severity = LogSeverity::Error;
+		}
+		else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+			severity = LogSeverity::Warning;
+		}
+		else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+			severity = LogSeverity::Info;
+		}
+
+		LogCategory category = LogCategory::General;
+		if (messageType & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) {
+			category = LogCategory::Performance;
+		}
+		else if (messageType & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT) {
+			category = LogCategory::Validation;
+		}
+
+		auto logger = static_cast<Logger*>(pUserData);
+		logger->log(severity, category, pCallbackData->messageIdNumber, pCallbackData->pMessage);
 
 		return VK_FALSE;
 	}
 #endif
 
 	void run() {
-		initWindow();
-		initVulkan();
+		startupTimer.measure("initWindow", [this]() { initWindow(); });
+		startupTimer.measure("initVulkan", [this]() { initVulkan(); });
+		openFrameCapture();
 		mainLoop();
 		cleanup();
 	}
 
 private:
+	ApplicationSettings settings;
+	// Declared early so it outlives everything that may log, down to vkDestroyInstance
+	Logger logger;
 	GLFWwindow* window;
+	// Read on the main thread (GLFW window queries may not happen anywhere else), for the swap chain steps on the startup workers
+	VkExtent2D framebufferSize = { 0, 0 };
 	VkInstance instance;
 	VkSurfaceKHR surface;
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	DeviceCapabilities capabilities; // Of physicalDevice
+	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
 	VkDevice device;
+	// Every vkAllocateMemory/vkFreeMemory goes through here
+	DeviceMemoryTracker memoryTracker;
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
-	VkSwapchainKHR swapChain;
+	// The graphics queue unless the device has a dedicated transfer family
+	VkQueue transferQueue;
+	uint32_t graphicsQueueFamily;
+	uint32_t presentQueueFamily;
+	uint32_t transferQueueFamily;
+	// The graphics queue unless the device has a dedicated compute family
+	VkQueue computeQueue;
+	uint32_t computeQueueFamily;
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> swapChainImages;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
 	std::vector<VkImageView> swapChainImageViews;
-	VkRenderPass renderPass;
+	// SPIR-V of every file in shaderFiles, embedded in the executable unless settings.shaderDirectory says otherwise
+	ShaderLibrary shaders;
+	// The interface of every shader, layouts are derived from these instead of written by hand
+	std::map<std::string, ShaderReflection> shaderReflections;
+	PipelineLayoutCache pipelineLayouts;
+	PipelineCache pipelineCache;
+	RenderGraph renderGraph;
+	VkRenderPass renderPass; // Owned by renderGraph
+	/*
+	* With dynamic resolution the scene is rendered into the top left
+	* renderExtent of sceneColor (which has the swap chain's size) and blitted
+	* up to the swap chain image. Otherwise renderExtent is the swap chain extent.
+	*/
+	bool dynamicResolutionEnabled = false;
+	DynamicResolutionController resolutionController;
+	RenderGraphResource sceneColor = RENDER_GRAPH_RESOURCE_NONE;
+	VkExtent2D renderExtent = { 0, 0 };
+	/*
+	* Two timestamps per frame slot around the scene and upscale passes of the
+	* first window, read back once the slot's frame retired. timestampScales
+	* holds the render scale of the frame measured in each slot, 0 while there
+	* is nothing to read.
+	*/
+	VkQueryPool timestampPool = VK_NULL_HANDLE;
+	std::vector<double> timestampScales;
+	// Both layouts belong to pipelineLayouts
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
-	VkPipeline graphicsPipeline;
-	std::vector<VkFramebuffer> swapChainFramebuffers;
+	VkPipelineLayout particlePipelineLayout;
+	// The pipelines themselves are in pipelineCache, only the scene's base pipeline is built up front
+	PipelineKey scenePipelineKey;
+	PipelineKey particlePipelineKey;
 	VkCommandPool commandPool;
+	VkCommandPool transferCommandPool;
+	VkCommandPool computeCommandPool;
+	VkCommandPool presentCommandPool = VK_NULL_HANDLE; // Only with a separate present family
 	VkBuffer vertexBuffer;
 	VkDeviceMemory vertexBufferMemory;
+	// Every level of detail of the scene mesh, back to back
 	VkBuffer indexBuffer;
 	VkDeviceMemory indexBufferMemory;
-	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
-	VkDescriptorPool descriptorPool;
-	std::vector<VkDescriptorSet> descriptorSets;
+	MeshLodChain sceneLods;
+	// Level the first window drew last, each secondary window has its own
+	uint32_t sceneLodLevel = 0;
+	// View space distance of the scene mesh over the far plane, for the depth bits of its draw keys
+	float sceneDepth = 0.0f;
+	WindowUniforms uniforms;
+	// Scratch space of writeChangedUniforms, one per job worker
+	std::vector<std::vector<SceneRange>> changedSceneRanges;
+	SceneStore scene;
+	SceneCamera camera;
+	SceneObject modelObject = SCENE_OBJECT_NONE;
+	/*
+	* Rendered by the same command buffer as the first window and presented by
+	* the same vkQueuePresentKHR, so each one costs its pixels and a few
+	* swap chain images.
+	*/
+	std::vector<SecondaryWindow> secondaryWindows;
 	std::vector<VkCommandBuffer> commandBuffers;
+	// Per swap chain image, acquire the image on the present family (only with a separate present family)
+	std::vector<VkCommandBuffer> presentAcquireCommandBuffers;
+	// Per frame in flight, acquire uploaded buffers on the graphics family
+	std::vector<VkCommandBuffer> uploadAcquireCommandBuffers;
+	// Per frame in flight, particle simulation step on the compute queue
+	std::vector<VkCommandBuffer> computeCommandBuffers;
+	/*
+	* Frame n simulates into particle buffer n % particleBuffers.size(), reading
+	* the previous one. There is one buffer more than frames in flight, so the
+	* buffer being written was last drawn by a frame that has retired.
+	*/
+	ComputePipeline particleSimulation;
+	std::vector<VkBuffer> particleBuffers;
+	std::vector<VkDeviceMemory> particleBuffersMemory;
+	VkDescriptorPool particleDescriptorPool;
+	std::vector<VkDescriptorSet> particleDescriptorSets;
+	size_t currentParticleBuffer = 0;
+	bool particlesInitialized = false;
+	float simulationTime = 0.0f;
+	/*
+	* Time, uniforms and draws of the frame being built, derived from the clock
+	* or read back from a replay. They stay prepared until the frame is actually
+	* submitted, so a frame dropped for an out of date swap chain does not skip
+	* a replayed frame.
+	*/
+	FrameInputs frameInputs;
+	// frameInputs.draws in sort key order for the view being recorded, and what the recording has bound
+	DrawList drawList;
+	// What each of frameInputs.draws binds in that view, by index
+	std::vector<BoundDraw> boundDraws;
+	DrawIdTable pipelineIds;
+	DrawIdTable descriptorSetIds;
+	DrawIdTable meshIds;
+	DrawStateTracker drawState;
+	bool frameInputsReady = false;
+	uint64_t preparedFrameCount = 0;
+	FramePacer::Clock::time_point firstFrameTime;
+	FrameCaptureWriter captureWriter;
+	FrameCaptureReader replayReader;
+	FramePacer::Clock::time_point replayStart;
+	// Presented frames copied back to the host and written to settings.recordPath
+	bool readbackEnabled = false;
+	FrameReadback frameReadback;
+	FrameRecorder frameRecorder;
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
-	std::vector<VkFence> inFlightFences;
-	std::vector<VkFence> imagesInFlight;
+	// Signaled once the present family owns the image (only with a separate present family)
+	std::vector<VkSemaphore> presentReadySemaphores;
+	/*
+	* Frame n signals the value n on this timeline semaphore once the GPU is
+	* done with it, which replaces one fence per frame in flight.
+	*/
+	VkSemaphore frameTimeline;
+	uint64_t submittedFrameValue = 0;
+	uint64_t completedFrameValue = 0;
+	// Timeline value of the last frame which rendered into each swap chain image
+	std::vector<uint64_t> imageFrameValues;
 	size_t currentFrame = 0;
+	/*
+	* Uploads signal transferTimeline; the next frame submission waits for the
+	* latest value and acquires the buffers released by the transfer family.
+	*/
+	VkSemaphore transferTimeline;
+	// Frame n's simulation step signals n, its scene pass waits for it
+	VkSemaphore computeTimeline;
+	uint64_t submittedTransferValue = 0;
+	uint64_t acquiredTransferValue = 0;
+	std::vector<VkBufferMemoryBarrier> pendingUploadAcquires;
+	VkPipelineStageFlags pendingUploadStages = 0;
+	FramePacer framePacer;
+	FrameScheduler frameScheduler;
+	JobSystem jobSystem;
+	StartupTimer startupTimer;
+	DeletionQueue deletionQueue;
+	// VK_KHR_present_id + VK_KHR_present_wait, frame timeline values double as present ids
+	bool presentWaitEnabled = false;
+	PFN_vkWaitForPresentKHR waitForPresentKHR = nullptr;
+	// Present id of the last frame queued on the current swap chain, 0 if none was since it was created
+	uint64_t lastPresentId = 0;
 	bool framebufferResized = false;
 #ifndef NDEBUG
 	VkDebugUtilsMessengerEXT debugMessenger;
 #endif
 
-	static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
-		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
-		app->framebufferResized = true;
+	static HelloTriangleApplication* getApplication(GLFWwindow* window) {
+		return reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+	}
+
+	static void framebufferResizeCallback(GLFWwindow* window, int, int) {
+		auto app = getApplication(window);
+		app->frameScheduler.invalidate();
+		if (window == app->window) {
+			app->framebufferResized = true;
+			return;
+		}
+		for (auto& output : app->secondaryWindows) {
+			if (output.window == window) {
+				output.resized = true;
+			}
+		}
+	}
+
+	/*
+	* Minimizing the first window suspends rendering (of every window) until
+	* mainLoop finds it restored. Some platforms keep the framebuffer size of
+	* minimized windows, so the size alone is not enough.
+	*/
+	static void windowIconifyCallback(GLFWwindow* window, int iconified) {
+		auto app = getApplication(window);
+		if (iconified && window == app->window) {
+			app->frameScheduler.setSuspended(true);
+		}
+		else {
+			app->frameScheduler.invalidate();
+		}
+	}
+
+	// Everything that may change what a window shows invalidates the frame for on-demand rendering
+	void setWindowCallbacks(GLFWwindow* target) {
+		glfwSetWindowUserPointer(target, this);
+		glfwSetFramebufferSizeCallback(target, framebufferResizeCallback);
+		glfwSetWindowIconifyCallback(target, windowIconifyCallback);
+		glfwSetWindowRefreshCallback(target, [](GLFWwindow* window) {
+			getApplication(window)->frameScheduler.invalidate();
+		});
+		glfwSetKeyCallback(target, [](GLFWwindow* window, int, int, int, int) {
+			getApplication(window)->frameScheduler.invalidate();
+		});
+		glfwSetMouseButtonCallback(target, [](GLFWwindow* window, int, int, int) {
+			getApplication(window)->frameScheduler.invalidate();
+		});
+		glfwSetCursorPosCallback(target, [](GLFWwindow* window, double, double) {
+			getApplication(window)->frameScheduler.invalidate();
+		});
+		glfwSetScrollCallback(target, [](GLFWwindow* window, double, double) {
+			getApplication(window)->frameScheduler.invalidate();
+		});
 	}
 
 	void initWindow() {
@@ -140,25 +455,50 @@ private:
 
 		window = glfwCreateWindow(window_width, window_height, "Learn Vulkan", nullptr, nullptr);
 
-		/* Setup a callback to guarantee we know when the window has been resized. */
-		glfwSetWindowUserPointer(window, this);
-		glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+		/* Setup callbacks to guarantee we know when the window has been resized, minimized or used. */
+		setWindowCallbacks(window);
+
+		for (uint32_t i = 1; i < settings.windowCount; i++) {
+			SecondaryWindow output;
+			std::string title = "Learn Vulkan (" + std::to_string(i + 1) + ")";
+			output.window = glfwCreateWindow(window_width, window_height, title.c_str(), nullptr, nullptr);
+			setWindowCallbacks(output.window);
+			secondaryWindows.push_back(std::move(output));
+		}
+	}
+
+	bool anyWindowShouldClose() {
+		if (glfwWindowShouldClose(window)) {
+			return true;
+		}
+		return std::any_of(secondaryWindows.begin(), secondaryWindows.end(),
+			[](const SecondaryWindow& output) { return glfwWindowShouldClose(output.window); });
 	}
 
 #ifndef NDEBUG
 	void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo) {
 		createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+		/*
+		* Only subscribe to what the logger would keep anyway: the layers skip
+		* building verbose and info messages nobody asked for, which is most of
+		* the slowdown of debug builds.
+		*/
 		createInfo.messageSeverity =
-			VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
-			VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
 			VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
 			VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+		if (settings.logLevel <= LogSeverity::Info) {
+			createInfo.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+		}
+		if (settings.logLevel <= LogSeverity::Verbose) {
+			createInfo.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+		}
 		createInfo.messageType =
 			VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
 			VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
 			VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
 		createInfo.pfnUserCallback = debugCallback;
+		createInfo.pUserData = &logger;
 
 	}
 #endif
@@ -188,9 +528,11 @@ private:
 		allRequiredExts.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 #endif
 
-		std::cout << "Extensions required:\n";
-		for (const char* extension : allRequiredExts) {
-			std::cout << '\t' << std::string(extension) << '\n';
+		if (settings.verbose) {
+			std::cout << "Extensions required:\n";
+			for (const char* extension : allRequiredExts) {
+				std::cout << '\t' << std::string(extension) << '\n';
+			}
 		}
 
 		// Retrieve supported extensions from Vulkan
@@ -199,9 +541,11 @@ private:
 		std::vector<VkExtensionProperties> vkSupportedExts(vkSupportedExtCount);
 		vkEnumerateInstanceExtensionProperties(nullptr, &vkSupportedExtCount, vkSupportedExts.data());
 
-		std::cout << "Extensions supported by Vulkan:\n";
-		for (const auto& vkSupportedExt : vkSupportedExts) {
-			std::cout << '\t' << vkSupportedExt.extensionName << '\n';
+		if (settings.verbose) {
+			std::cout << "Extensions supported by Vulkan:\n";
+			for (const auto& vkSupportedExt : vkSupportedExts) {
+				std::cout << '\t' << vkSupportedExt.extensionName << '\n';
+			}
 		}
 
 		// Make sure the drivers on the system support the required extensions.
@@ -229,15 +573,19 @@ private:
 		std::vector<VkLayerProperties> vkAvailableLayers(vkLayerCount);
 		vkEnumerateInstanceLayerProperties(&vkLayerCount, vkAvailableLayers.data());
 
-		std::cout << "Validation layers available:\n";
-		for (auto& layerProperties : vkAvailableLayers) {
-			std::cout << '\t' << layerProperties.layerName << '\n';
+		if (settings.verbose) {
+			std::cout << "Validation layers available:\n";
+			for (auto& layerProperties : vkAvailableLayers) {
+				std::cout << '\t' << layerProperties.layerName << '\n';
+			}
+			std::cout << "Validation layers requested:\n";
 		}
 
 		bool allLayersAvailable = true;
-		std::cout << "Validation layers requested:\n";
 		for (const char* layerName : validationLayers) {
-			std::cout << '\t' << layerName << '\n';
+			if (settings.verbose) {
+				std::cout << '\t' << layerName << '\n';
+			}
 
 			allLayersAvailable &= std::any_of(
 				vkAvailableLayers.begin(),
@@ -284,30 +632,95 @@ private:
 		if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create window surface!");
 		}
+		for (auto& output : secondaryWindows) {
+			if (glfwCreateWindowSurface(instance, output.window, nullptr, &output.surface) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create window surface!");
+			}
+		}
 	}
 
-	QueueFamilyIndices findQueueFamilyIndices(VkPhysicalDevice device) {
-		QueueFamilyIndices indices;
+	DeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice device) {
+		DeviceCapabilities caps;
+		caps.physicalDevice = device;
+
+		vkGetPhysicalDeviceProperties(device, &caps.properties);
+		vkGetPhysicalDeviceMemoryProperties(device, &caps.memoryProperties);
 
 		uint32_t queueFamilyCount = 0;
 		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+		caps.queueFamilyProperties.resize(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, caps.queueFamilyProperties.data());
+		caps.queueFamilies = findQueueFamilyIndices(device, caps.queueFamilyProperties);
+
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+		caps.extensions.resize(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, caps.extensions.data());
+
+		// vkWaitSemaphores and friends are core since Vulkan 1.2, older devices don't know the feature struct
+		if (caps.properties.apiVersion >= VK_API_VERSION_1_2) {
+			VkPhysicalDeviceVulkan12Features vulkan12Features{};
+			vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+
+			VkPhysicalDeviceFeatures2 deviceFeatures{};
+			deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			deviceFeatures.pNext = &vulkan12Features;
+			vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
+
+			caps.timelineSemaphore = vulkan12Features.timelineSemaphore == VK_TRUE;
+		}
+
+		return caps;
+	}
+
+	// One present queue presents every window, so its family has to support all of their surfaces
+	bool supportsPresentToEveryWindow(VkPhysicalDevice device, uint32_t queueFamily) {
+		VkBool32 presentSupport = VK_FALSE;
+		vkGetPhysicalDeviceSurfaceSupportKHR(device, queueFamily, surface, &presentSupport);
+		for (const auto& output : secondaryWindows) {
+			if (!presentSupport) {
+				break;
+			}
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, queueFamily, output.surface, &presentSupport);
+		}
+		return presentSupport == VK_TRUE;
+	}
+
+	QueueFamilyIndices findQueueFamilyIndices(VkPhysicalDevice device, const std::vector<VkQueueFamilyProperties>& queueFamilies) {
+		QueueFamilyIndices indices;
 
-		int i = 0;
+		/*
+		* Walk every family instead of stopping at the first complete set:
+		* - a family doing both graphics and present avoids ownership transfers
+		*   of the swap chain images, so it wins over separate families
+		* - transfer-only families usually map to the DMA engines
+		* - compute families without graphics run next to the graphics queue
+		*/
+		uint32_t i = 0;
 		for (const auto& queueFamily : queueFamilies) {
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+			bool graphics = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+			bool compute = (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+			bool transfer = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0;
+
+			bool presentSupport = supportsPresentToEveryWindow(device, i);
+
+			if (graphics && presentSupport &&
+				!(indices.graphicsFamily.has_value() && indices.graphicsFamily == indices.presentFamily)) {
 				indices.graphicsFamily = i;
+				indices.presentFamily = i;
 			}
-
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-			if (presentSupport) {
+			if (graphics && !indices.graphicsFamily.has_value()) {
+				indices.graphicsFamily = i;
+			}
+			if (presentSupport && !indices.presentFamily.has_value()) {
 				indices.presentFamily = i;
 			}
 
-			if (indices.isComplete()) {
-				break;
+			if (transfer && !graphics && !compute && !indices.transferFamily.has_value()) {
+				indices.transferFamily = i;
+			}
+			if (compute && !graphics && !indices.computeFamily.has_value()) {
+				indices.computeFamily = i;
 			}
 
 			i++;
@@ -316,22 +729,21 @@ private:
 		return indices;
 	}
 
-	bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
-		uint32_t extensionCount;
-		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
-
+	bool checkDeviceExtensionSupport(const DeviceCapabilities& caps) {
 		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 		
-		std::cout << "Required device extensions:\n";
-		for (const std::string& requiredExtension : requiredExtensions) {
-			std::cout << '\t' << requiredExtension << '\n';
+		if (settings.verbose) {
+			std::cout << "Required device extensions:\n";
+			for (const std::string& requiredExtension : requiredExtensions) {
+				std::cout << '\t' << requiredExtension << '\n';
+			}
+			std::cout << "Available device extensions on " << caps.properties.deviceName << ":\n";
 		}
 		
-		std::cout << "Available device extensions:\n";
-		for (const auto& extension : availableExtensions) {
-			std::cout << '\t' << extension.extensionName << '\n';
+		for (const auto& extension : caps.extensions) {
+			if (settings.verbose) {
+				std::cout << '\t' << extension.extensionName << '\n';
+			}
 			requiredExtensions.erase(extension.extensionName);
 		}
 
@@ -339,46 +751,147 @@ private:
 	}
 
 	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) {
+		return querySwapChainSupport(device, surface);
+	}
+
+	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR targetSurface) {
 		SwapChainSupportDetails details;
 
-		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, targetSurface, &details.capabilities);
 
 		uint32_t formatCount;
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+		vkGetPhysicalDeviceSurfaceFormatsKHR(device, targetSurface, &formatCount, nullptr);
 
 		if (formatCount > 0) {
 			details.formats.resize(formatCount);
-			vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
+			vkGetPhysicalDeviceSurfaceFormatsKHR(device, targetSurface, &formatCount, details.formats.data());
 		}
 
 		uint32_t presentModeCount;
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+		vkGetPhysicalDeviceSurfacePresentModesKHR(device, targetSurface, &presentModeCount, nullptr);
 
 		if (presentModeCount > 0) {
 			details.presentModes.resize(presentModeCount);
-			vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
+			vkGetPhysicalDeviceSurfacePresentModesKHR(device, targetSurface, &presentModeCount, details.presentModes.data());
 		}
 
 		return details;
 	}
 
-	bool isDeviceSuitable(VkPhysicalDevice device) {
-		QueueFamilyIndices indices = findQueueFamilyIndices(device);
+	bool checkDeviceFeatureSupport(const DeviceCapabilities& caps) {
+		return caps.properties.apiVersion >= VK_API_VERSION_1_2 && caps.timelineSemaphore;
+	}
 
-		bool extensionsSupported = checkDeviceExtensionSupport(device);
+	bool isDeviceSuitable(const DeviceCapabilities& caps) {
+		bool extensionsSupported = checkDeviceExtensionSupport(caps);
+		bool featuresSupported = checkDeviceFeatureSupport(caps);
 
 		bool swapChainAdequate = false;
 		if (extensionsSupported) {
-			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
+			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(caps.physicalDevice);
 			swapChainAdequate = !swapChainSupport.formats.empty();
 			swapChainAdequate &= !swapChainSupport.presentModes.empty();
 		}
 
-		return indices.graphicsFamily.has_value() &&
+		return caps.queueFamilies.isComplete() &&
 			extensionsSupported &&
+			featuresSupported &&
 			swapChainAdequate;
 	}
 	
+	/*
+	* Rates a device, 0 meaning it cannot run the renderer at all. The device
+	* type dominates so a discrete GPU always beats an integrated one or a
+	* software rasterizer; VRAM, limits and dedicated queue families only
+	* break ties between devices of the same type.
+	*/
+	uint64_t scorePhysicalDevice(const DeviceCapabilities& caps) {
+		if (!isDeviceSuitable(caps)) {
+			return 0;
+		}
+
+		const VkPhysicalDeviceProperties& deviceProperties = caps.properties;
+
+		uint64_t score = 1;
+		switch (deviceProperties.deviceType) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+			score += 1000000;
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+			score += 100000;
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+			score += 10000;
+			break;
+		default:
+			// CPU (software rasterizers) and other
+			break;
+		}
+
+		// Largest device local heap, in MiB
+		const VkPhysicalDeviceMemoryProperties& memoryProperties = caps.memoryProperties;
+		VkDeviceSize deviceLocalSize = 0;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+				deviceLocalSize = std::max(deviceLocalSize, memoryProperties.memoryHeaps[i].size);
+			}
+		}
+		score += std::min<uint64_t>(deviceLocalSize / (1024 * 1024), 65536);
+
+		score += deviceProperties.limits.maxImageDimension2D / 1024;
+
+		// log2 of the highest MSAA sample count, a few points each so it never outweighs the device type
+		const uint64_t sampleCountWeight = 10;
+		VkSampleCountFlags sampleCounts = deviceProperties.limits.framebufferColorSampleCounts;
+		uint64_t sampleCountLog2 = 0;
+		for (uint32_t bit = 1; bit < 32; bit++) {
+			if (sampleCounts & (1u << bit)) {
+				sampleCountLog2 = bit;
+			}
+		}
+		score += sampleCountWeight * sampleCountLog2;
+
+		const QueueFamilyIndices& indices = caps.queueFamilies;
+		if (indices.graphicsFamily == indices.presentFamily) {
+			score += 100;
+		}
+		if (indices.transferFamily.has_value()) {
+			score += 100;
+		}
+		if (indices.computeFamily.has_value()) {
+			score += 100;
+		}
+
+		return score;
+	}
+
+	// --device accepts either an index into the enumerated devices or part of a device name
+	std::optional<uint32_t> findRequestedDevice(const std::vector<DeviceCapabilities>& allCapabilities) {
+		if (settings.device.empty()) {
+			return std::nullopt;
+		}
+
+		if (std::all_of(settings.device.begin(), settings.device.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+			// Digit by digit: the value only grows, so an overlong number fails the bounds check before it can overflow
+			uint64_t index = 0;
+			for (char c : settings.device) {
+				index = index * 10 + static_cast<uint64_t>(c - '0');
+				if (index >= allCapabilities.size()) {
+					throw std::runtime_error("Requested device index " + settings.device + " does not exist!");
+				}
+			}
+			return static_cast<uint32_t>(index);
+		}
+
+		for (uint32_t i = 0; i < allCapabilities.size(); i++) {
+			if (std::string(allCapabilities[i].properties.deviceName).find(settings.device) != std::string::npos) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("No device matches requested name \"" + settings.device + "\"!");
+	}
+
 	void pickPhysicalDevice() {
 		uint32_t deviceCount = 0;
 		vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
@@ -390,38 +903,94 @@ private:
 		std::vector<VkPhysicalDevice> devices(deviceCount);
 		vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 		
-		std::vector<VkPhysicalDeviceProperties> allDeviceProperties(deviceCount);
+		std::vector<DeviceCapabilities> allCapabilities(deviceCount);
+		std::vector<uint64_t> scores(deviceCount);
 		std::cout << "Vulkan is supported on the following system devices:\n";
-		for (int i = 0; i < deviceCount; i++) {
-			VkPhysicalDevice device = devices[i];
-			VkPhysicalDeviceProperties deviceProperties;
-			vkGetPhysicalDeviceProperties(device, &deviceProperties);
-			allDeviceProperties.push_back(deviceProperties);
+		for (uint32_t i = 0; i < deviceCount; i++) {
+			allCapabilities[i] = queryDeviceCapabilities(devices[i]);
+			scores[i] = scorePhysicalDevice(allCapabilities[i]);
 
+			const VkPhysicalDeviceProperties& deviceProperties = allCapabilities[i].properties;
 			std::cout << '\t' << i << ": " << deviceProperties.deviceName << '\n';
-			std::cout << "\t\t" << "Device ID: "		<< '\t' << deviceProperties.deviceID		<< '\n';
-			std::cout << "\t\t" << "Device Type: "		<< '\t' << deviceProperties.deviceType		<< '\n';
-			std::cout << "\t\t" << "Driver Version: "			<< deviceProperties.driverVersion	<< '\n';
-			std::cout << "\t\t" << "Vendor ID: "		<< '\t' << deviceProperties.vendorID		<< '\n';
-			std::cout << "\t\t" << "API Version: "		<< '\t' << deviceProperties.apiVersion		<< '\n';
+			if (settings.verbose) {
+				std::cout << "\t\t" << "Device ID: "		<< '\t' << deviceProperties.deviceID		<< '\n';
+				std::cout << "\t\t" << "Device Type: "		<< '\t' << deviceProperties.deviceType		<< '\n';
+				std::cout << "\t\t" << "Driver Version: "			<< deviceProperties.driverVersion	<< '\n';
+				std::cout << "\t\t" << "Vendor ID: "		<< '\t' << deviceProperties.vendorID		<< '\n';
+				std::cout << "\t\t" << "API Version: "		<< '\t' << deviceProperties.apiVersion		<< '\n';
+			}
+			std::cout << "\t\t" << "Score: "			<< '\t' << scores[i]						<< '\n';
 		}
 
-		// For now, we just pick the first device (Vulkan Tutorial pg. 62 for suitability checks)
-		VkPhysicalDevice device = devices[0];
-		if (!isDeviceSuitable(device)) {
-			throw std::runtime_error("Selected device does not support required extensions!");
+		uint32_t selected = 0;
+		std::optional<uint32_t> requested = findRequestedDevice(allCapabilities);
+		if (requested.has_value()) {
+			selected = requested.value();
+			if (scores[selected] == 0) {
+				throw std::runtime_error("Requested device does not support required extensions and features!");
+			}
+		}
+		else {
+			selected = static_cast<uint32_t>(std::max_element(scores.begin(), scores.end()) - scores.begin());
+			if (scores[selected] == 0) {
+				throw std::runtime_error("Failed to find a suitable GPU!");
+			}
+		}
+
+		physicalDevice = devices[selected];
+		capabilities = std::move(allCapabilities[selected]);
+		std::cout << "Selected device " << selected << ": " << capabilities.properties.deviceName << '\n';
+
+		const QueueFamilyIndices& indices = capabilities.queueFamilies;
+		auto printFamily = [](const char* name, const std::optional<uint32_t>& family) {
+			std::cout << '\t' << name << ": ";
+			if (family.has_value()) {
+				std::cout << family.value() << '\n';
+			}
+			else {
+				std::cout << "none\n";
+			}
+		};
+		std::cout << "Queue families:\n";
+		printFamily("Graphics", indices.graphicsFamily);
+		printFamily("Present", indices.presentFamily);
+		printFamily("Dedicated transfer", indices.transferFamily);
+		printFamily("Dedicated compute", indices.computeFamily);
+
+		msaaSamples = chooseSampleCount(settings.msaaSamples);
+		std::cout << "MSAA samples: " << msaaSamples << '\n';
+	}
+
+	/*
+	* Picks the highest sample count supported for color framebuffers that
+	* does not exceed the requested count (there is no depth buffer yet, so
+	* only framebufferColorSampleCounts matters).
+	*/
+	VkSampleCountFlagBits chooseSampleCount(uint32_t requestedSamples) {
+		VkSampleCountFlags supportedCounts = capabilities.properties.limits.framebufferColorSampleCounts;
+		for (uint32_t samples = VK_SAMPLE_COUNT_64_BIT; samples > VK_SAMPLE_COUNT_1_BIT; samples >>= 1) {
+			if (samples <= requestedSamples && (supportedCounts & samples)) {
+				return static_cast<VkSampleCountFlagBits>(samples);
+			}
 		}
 
-		physicalDevice = device;
+		return VK_SAMPLE_COUNT_1_BIT;
 	}
 
 	void createLogicalDevice() {
-		QueueFamilyIndices indices = findQueueFamilyIndices(physicalDevice);
+		const QueueFamilyIndices& indices = capabilities.queueFamilies;
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+		graphicsQueueFamily = indices.graphicsFamily.value();
+		presentQueueFamily = indices.presentFamily.value();
+		transferQueueFamily = indices.transferFamily.value_or(graphicsQueueFamily);
+		computeQueueFamily = indices.computeFamily.value_or(graphicsQueueFamily);
+
 		std::set<uint32_t> uniqueQueueFamilies = { 
-			indices.graphicsFamily.value(), 
-			indices.presentFamily.value() 
+			graphicsQueueFamily,
+			presentQueueFamily,
+			transferQueueFamily,
+			computeQueueFamily
 		};
 
 		float queuePriority = 1.0f;
@@ -437,13 +1006,51 @@ private:
 		// We'll be doing more interesting things with this later...
 		VkPhysicalDeviceFeatures deviceFeatures{};
 
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+		vulkan12Features.timelineSemaphore = VK_TRUE;
+
+		std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+
+		// Present id/wait only serve the latency measurements, so they are optional
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+		presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+		presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		presentWaitFeatures.pNext = &presentIdFeatures;
+
+		if (capabilities.hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+			capabilities.hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+			VkPhysicalDeviceFeatures2 supportedFeatures{};
+			supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			supportedFeatures.pNext = &presentWaitFeatures;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+			presentWaitEnabled = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+		}
+
+		// Without it the memory tracker estimates the budget from the heap sizes
+		bool memoryBudgetEnabled = capabilities.hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (memoryBudgetEnabled) {
+			enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+
+		if (presentWaitEnabled) {
+			enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+			// The query above left both features set to VK_TRUE
+			vulkan12Features.pNext = &presentWaitFeatures;
+		}
+
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.pNext = &vulkan12Features;
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 #ifndef NDEBUG
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -456,8 +1063,35 @@ private:
 			throw std::runtime_error("Failed to create logical device!");
 		}
 
-		vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+		vkGetDeviceQueue(device, graphicsQueueFamily, 0, &graphicsQueue);
+		vkGetDeviceQueue(device, presentQueueFamily, 0, &presentQueue);
+		vkGetDeviceQueue(device, transferQueueFamily, 0, &transferQueue);
+		vkGetDeviceQueue(device, computeQueueFamily, 0, &computeQueue);
+
+		pipelineLayouts.create(device);
+		pipelineCache.create(device, pipelineLayouts, jobSystem);
+
+		if (presentWaitEnabled) {
+			waitForPresentKHR = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+			presentWaitEnabled = waitForPresentKHR != nullptr;
+		}
+		framePacer.setPresentTimesMeasured(presentWaitEnabled);
+
+		std::cout << "Present wait: "
+			<< (presentWaitEnabled ? "enabled" : "unavailable, latency is measured up to GPU completion")
+			<< '\n';
+
+		memoryTracker.init(physicalDevice, device, capabilities.memoryProperties, memoryBudgetEnabled);
+		memoryTracker.addPressureCallback([this](uint32_t heapIndex, const MemoryHeapBudget& heap) {
+			// Nothing to evict yet, but make it visible before it turns into an allocation failure
+			logger.log(LogSeverity::Warning, LogCategory::Performance,
+				"Memory heap " + std::to_string(heapIndex) + " is at " + std::to_string(heap.usage / (1024 * 1024)) +
+				" of " + std::to_string(heap.budget / (1024 * 1024)) + " MiB budget");
+		});
+
+		std::cout << "Memory budget: "
+			<< (memoryBudgetEnabled ? "VK_EXT_memory_budget" : "unavailable, estimated from heap sizes")
+			<< '\n';
 	}
 	
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -472,30 +1106,57 @@ private:
 	}
 
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-		// Use triple-buffering if available
+		VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+		switch (settings.presentMode) {
+		case PresentModeSetting::Mailbox:
+			// Use triple-buffering if available
+			requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+			break;
+		case PresentModeSetting::Fifo:
+			requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+			break;
+		case PresentModeSetting::FifoRelaxed:
+			requestedPresentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+			break;
+		case PresentModeSetting::Immediate:
+			requestedPresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			break;
+		}
+
 		for (const auto& availablePresentMode : availablePresentModes) {
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+			if (availablePresentMode == requestedPresentMode) {
 				return availablePresentMode;
 			}
 		}
 
-		// Otherwise use "v-sync"
+		// Otherwise use "v-sync", the only mode every implementation has to support
+		logger.log(LogSeverity::Warning, LogCategory::Renderer, "Requested present mode is unavailable, falling back to FIFO");
 		return VK_PRESENT_MODE_FIFO_KHR;
 	}
 
+	// Main thread only, like every GLFW window query
+	static VkExtent2D getFramebufferSize(GLFWwindow* targetWindow) {
+		int width = 0;
+		int height = 0;
+		glfwGetFramebufferSize(targetWindow, &width, &height);
+		return { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+	}
+
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
+		return chooseSwapExtent(capabilities, framebufferSize);
+	}
+
+	/*
+	* "targetFramebufferSize" comes from the caller rather than from GLFW, so
+	* this can run on any thread.
+	*/
+	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, VkExtent2D targetFramebufferSize) {
 		if (capabilities.currentExtent.width != UINT32_MAX) {
 			return capabilities.currentExtent;
 		}
-		
-		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
 
 		/*VkExtent2D actualExtent = { window_width, window_height };*/
-		VkExtent2D actualExtent = { 
-			static_cast<uint32_t>(width), 
-			static_cast<uint32_t>(height)
-		};
+		VkExtent2D actualExtent = targetFramebufferSize;
 
 		actualExtent.width =
 			std::max(capabilities.minImageExtent.width,
@@ -507,6 +1168,54 @@ private:
 		return actualExtent;
 	}
 
+	/*
+	* Dynamic resolution needs GPU timestamps on the graphics queue to measure
+	* frames, and linear blits from the offscreen image into the swap chain.
+	*/
+	bool supportsDynamicResolution(const VkSurfaceCapabilitiesKHR& surfaceCapabilities, VkFormat format) {
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+		VkFormatFeatureFlags blitFeatures =
+			VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+			VK_FORMAT_FEATURE_BLIT_DST_BIT |
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+		const char* missing = nullptr;
+		if (capabilities.queueFamilyProperties[graphicsQueueFamily].timestampValidBits == 0) {
+			missing = "timestamps on the graphics queue";
+		}
+		else if (!(surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+			missing = "swap chain images usable as transfer destination";
+		}
+		else if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures) {
+			missing = "linear blits of the swap chain format";
+		}
+
+		if (missing != nullptr) {
+			logger.log(LogSeverity::Warning, LogCategory::Renderer,
+				std::string("Dynamic resolution disabled, the device lacks ") + missing);
+			return false;
+		}
+		return true;
+	}
+
+	bool supportsReadback(const VkSurfaceCapabilitiesKHR& surfaceCapabilities, VkFormat format) {
+		const char* missing = nullptr;
+		if (!(surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+			missing = "swap chain images usable as transfer source";
+		}
+		else if (!FrameReadback::isFormatSupported(format)) {
+			missing = "a swap chain format with 8 bit RGBA/BGRA pixels";
+		}
+
+		if (missing != nullptr) {
+			logger.log(LogSeverity::Warning, LogCategory::Renderer,
+				std::string("Frame recording disabled, the device lacks ") + missing);
+			return false;
+		}
+		return true;
+	}
+
 	void createSwapChain() {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
@@ -539,24 +1248,30 @@ private:
 		// VK_IMAGE_USAGE_TRANSFER_DST_BIT - render from another image (post-processing)
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-		QueueFamilyIndices indices = findQueueFamilyIndices(physicalDevice);
-		uint32_t queueFamilyIndices[] = { 
-			indices.graphicsFamily.value(),
-			indices.presentFamily.value()
-		};
-
-		if (indices.graphicsFamily != indices.presentFamily) {
-			// Avoids dealing with ownership for now (not the most performant code)
-			createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-			createInfo.queueFamilyIndexCount = 2;
-			createInfo.pQueueFamilyIndices = queueFamilyIndices;
+		dynamicResolutionEnabled = settings.dynamicResolutionTarget > 0.0f &&
+			supportsDynamicResolution(swapChainSupport.capabilities, surfaceFormat.format);
+		if (dynamicResolutionEnabled) {
+			// The upscaled scene is blitted into the swap chain image
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		}
-		else {
-			createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			createInfo.queueFamilyIndexCount = 0;
-			createInfo.pQueueFamilyIndices = nullptr;
+
+		readbackEnabled = !settings.recordPath.empty() &&
+			supportsReadback(swapChainSupport.capabilities, surfaceFormat.format);
+		if (readbackEnabled) {
+			// Every frame is copied out of the swap chain image
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		}
 
+		/*
+		* Always exclusive: with separate graphics and present families every frame
+		* releases the image to the present family, which acquires it before
+		* presenting (see createCommandBuffers). Nothing has to be transferred back,
+		* the next render pass clears the image and discards the old contents.
+		*/
+		createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		createInfo.queueFamilyIndexCount = 0;
+		createInfo.pQueueFamilyIndices = nullptr;
+
 		createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
 		
 		// Blending with the window system
@@ -567,14 +1282,26 @@ private:
 		// If our rendering algorithms ever need those pixels, then disable this...
 		createInfo.clipped = VK_TRUE;
 
-		// For now, assume only 1 swapchain is ever created
-		// Because of this, the window cannot be resized (for now)
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
+		// Handing over the retiring swap chain lets the driver recycle its resources
+		// and keep presenting its images while we switch over, no need to drain the GPU
+		VkSwapchainKHR oldSwapChain = swapChain;
+		createInfo.oldSwapchain = oldSwapChain;
 		
 		if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create swap chain!");
 		}
 
+		if (oldSwapChain != VK_NULL_HANDLE) {
+			/*
+			* Presentation does not signal our timeline, so rendering being done is
+			* not proof the old images left the screen. Give the presentation engine
+			* another round of frames before destroying the old swap chain.
+			*/
+			deletionQueue.push(submittedFrameValue + settings.framesInFlight, [this, oldSwapChain]() {
+				vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+			});
+		}
+
 		vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
 		swapChainImages.resize(imageCount);
 		vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
@@ -587,180 +1314,180 @@ private:
 		swapChainImageViews.resize(swapChainImages.size());
 
 		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			VkImageViewCreateInfo createInfo{};
-			createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			createInfo.image = swapChainImages[i];
-			createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			createInfo.format = swapChainImageFormat;
-			createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			createInfo.subresourceRange.baseMipLevel = 0;
-			createInfo.subresourceRange.levelCount = 1;
-			createInfo.subresourceRange.baseArrayLayer = 0;
-			createInfo.subresourceRange.layerCount = 1;
+			swapChainImageViews[i] = createSwapChainImageView(swapChainImages[i], swapChainImageFormat);
+		}
+	}
 
-			if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
-				throw std::runtime_error("Failed to create image views!");
-			}
+	VkImageView createSwapChainImageView(VkImage image, VkFormat format) {
+		VkImageViewCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		createInfo.image = image;
+		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		createInfo.format = format;
+		createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		createInfo.subresourceRange.baseMipLevel = 0;
+		createInfo.subresourceRange.levelCount = 1;
+		createInfo.subresourceRange.baseArrayLayer = 0;
+		createInfo.subresourceRange.layerCount = 1;
+
+		VkImageView imageView;
+		if (vkCreateImageView(device, &createInfo, nullptr, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create image views!");
 		}
+		return imageView;
 	}
 
-	static std::vector<char> readFile(const std::string& filename) {
-		std::ifstream file(filename, std::ios::ate | std::ios::binary);
+	void loadShaderBinaries() {
+		shaders.load(shaderFiles, settings.shaderDirectory);
+		if (!shaders.isEmbedded()) {
+			logger.log(LogSeverity::Info, LogCategory::Renderer, "Shaders loaded from loose .spv files, not the executable");
+		}
 
-		if (!file.is_open()) {
-			throw std::runtime_error("Failed to open file:\n\"" + filename + "\"!");
+		for (const auto& filename : shaderFiles) {
+			shaderReflections[filename] = ShaderReflection(shaders.get(filename));
 		}
+	}
 
-		size_t fileSize = (size_t)file.tellg();
-		std::vector<char> buffer(fileSize);
-		
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-		file.close();
+	const ShaderReflection& getShaderReflection(const std::string& filename) const {
+		auto reflection = shaderReflections.find(filename);
+		if (reflection == shaderReflections.end()) {
+			throw std::runtime_error("Shader \"" + filename + "\" was not reflected!");
+		}
+		return reflection->second;
+	}
+
+	std::vector<const ShaderReflection*> getSceneShaderStages() const {
+		return { &getShaderReflection("hello_triangle.vert.spv"), &getShaderReflection("hello_triangle.frag.spv") };
+	}
 
-		return buffer;
+	// Registers the shader with pipelineCache, which owns its module
+	uint16_t getPipelineShader(const std::string& filename) {
+		return pipelineCache.addShader(filename, shaders.get(filename), getShaderReflection(filename));
 	}
 
-	VkShaderModule createShaderModule(const std::vector<char>& shaderBinary) {
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = shaderBinary.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(shaderBinary.data());
+	/*
+	* What makes a render pass compatible with the scene pass (see "Render
+	* Pass Compatibility" in the spec): its one color attachment's format and
+	* sample count. Everything else may change with the swap chain without
+	* invalidating the pipelines built for it.
+	*/
+	std::vector<uint32_t> getScenePassCompatibility() const {
+		return { static_cast<uint32_t>(swapChainImageFormat), static_cast<uint32_t>(msaaSamples) };
+	}
 
-		VkShaderModule shaderModule;
-		if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create shader module!");
+	/*
+	* Declares the passes of a frame and their inputs/outputs. The render graph
+	* derives the render passes (load/store ops, layouts), the dependencies and
+	* barriers between passes, culls passes nobody consumes and aliases the
+	* memory of transient images. New passes only have to be declared here.
+	*/
+	void createRenderGraph() {
+		RenderGraphResource backbuffer = renderGraph.importSwapChain(
+			"backbuffer",
+			swapChainImageFormat,
+			swapChainExtent,
+			swapChainImages,
+			swapChainImageViews,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+		VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+		// With dynamic resolution the scene goes to an offscreen image first
+		RenderGraphResource sceneTarget = backbuffer;
+		if (dynamicResolutionEnabled) {
+			RenderGraphImageDesc colorDesc{};
+			colorDesc.format = swapChainImageFormat;
+			colorDesc.extent = swapChainExtent;
+			sceneColor = renderGraph.createTransientImage("scene_color", colorDesc);
+			sceneTarget = sceneColor;
 		}
 
-		return shaderModule;
-	}
+		RenderGraphPass& scenePass = renderGraph.addPass("scene", RenderGraphPassType::Graphics);
 
-	void createRenderPass() {
-		VkAttachmentDescription colorAttachment{};
-		colorAttachment.format = swapChainImageFormat;
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		/*
-		* VK_ATTACHMENT_LOAD_OP_LOAD: Preserve the existing contents of the attachment
-		* VK_ATTACHMENT_LOAD_OP_CLEAR: Clear the values to a constant at the start
-		* VK_ATTACHMENT_LOAD_OP_DONT_CARE: Existing contents are undefined; we dont care about them
-		*/
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+			/*
+			* The multisampled image only lives inside the render pass: it is
+			* cleared on load, resolved into the swap chain image at the end of
+			* the subpass and never stored, so on tile-based GPUs its samples
+			* never leave tile memory (the graph also places it in lazily
+			* allocated memory when the device has some).
+			*/
+			RenderGraphImageDesc msaaDesc{};
+			msaaDesc.format = swapChainImageFormat;
+			msaaDesc.extent = swapChainExtent;
+			msaaDesc.samples = msaaSamples;
+			msaaDesc.additionalUsage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			RenderGraphResource msaaColor = renderGraph.createTransientImage("scene_msaa", msaaDesc);
+
+			scenePass.addColorOutput(msaaColor, clearColor);
+			scenePass.addResolveOutput(sceneTarget, msaaColor);
+		}
+		else {
+			scenePass.addColorOutput(sceneTarget, clearColor);
+		}
+		scenePass.setRecordCallback([this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+			/*
+			* Not TOP_OF_PIPE: that stage does not wait for the swap chain image or
+			* the particle simulation, and the frame time would include the
+			* acquire and the async compute wait.
+			*/
+			writeFrameTimestamp(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0);
+			recordScenePass(commandBuffer, renderExtent, uniforms.descriptorSets[imageIndex], sceneLodLevel, sceneDepth);
+		});
+
+		if (dynamicResolutionEnabled) {
+			RenderGraphPass& upscalePass = renderGraph.addPass("upscale", RenderGraphPassType::Transfer);
+			upscalePass.addTransferInput(sceneColor);
+			upscalePass.addTransferOutput(backbuffer);
+			upscalePass.setRecordCallback([this, backbuffer](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+				recordUpscalePass(commandBuffer, renderGraph.getImage(backbuffer, imageIndex));
+				// Before the readback and the other windows, which do not depend on the render scale
+				writeFrameTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+			});
+		}
 
-		/*
-		* VK_ATTACHMENT_STORE_OP_STORE: Rendered contents will be stored in memory and can be read later
-		* VK_ATTACHMENT_STORE_OP_DONT_CARE: Contents of the framebuffer will be undefined after the rendering operation
-		*/
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		
-		/*
-		* VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: Images used as color attachment
-		* VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: Images to be presented in the swap chain
-		* VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: Images to be used as destination for a memory copy operation
-		*/
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		if (readbackEnabled) {
+			// Copies the finished frame into the readback ring, the graph keeps it although nothing in it reads the copy
+			RenderGraphPass& readbackPass = renderGraph.addPass("readback", RenderGraphPassType::Transfer);
+			readbackPass.addTransferInput(backbuffer);
+			readbackPass.setNeverCulled();
+			readbackPass.setRecordCallback([this, backbuffer](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+				frameReadback.recordCopy(commandBuffer, renderGraph.getImage(backbuffer, imageIndex),
+					swapChainImageFormat, swapChainExtent, submittedFrameValue + 1);
+			});
+		}
 
-		VkAttachmentReference colorAttachmentRef{};
-		colorAttachmentRef.attachment = 0;
-		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		renderGraph.setOutput(backbuffer);
 
-		VkSubpassDescription subpass{};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttachmentRef;
-		
-		VkSubpassDependency dependency{};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		
-		VkRenderPassCreateInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = 1;
-		renderPassInfo.pAttachments = &colorAttachment;
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
+		renderGraph.compile(device, capabilities.memoryProperties, &memoryTracker);
 
-		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create render pass!");
-		}
+		renderPass = renderGraph.getRenderPass("scene");
 	}
 
+	// Set 0 of the scene shaders, the transform UBO of hello_triangle.vert
 	void createDescriptorSetLayout() {
-		VkDescriptorSetLayoutBinding uboLayoutBinding{};
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		uboLayoutBinding.pImmutableSamplers = nullptr;
-
-		VkDescriptorSetLayoutCreateInfo layoutInfo{};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = 1;
-		layoutInfo.pBindings = &uboLayoutBinding;
-
-		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create descriptor set layout!");
-		}
+		descriptorSetLayout = pipelineLayouts.getDescriptorSetLayout(getSceneShaderStages(), 0);
 	}
 
+	/*
+	* The pipeline state lives in a PipelineKey, pipelineCache builds it. Only
+	* the first call builds anything, recreating the swap chain gives the
+	* same key again.
+	*/
 	void createGraphicsPipeline() {
+		PipelineKey key{};
+		key.vertexShader = getPipelineShader("hello_triangle.vert.spv");
+		key.fragmentShader = getPipelineShader("hello_triangle.frag.spv");
 
-		/* PROGRAMMABLE STAGES OF THE GRAPHICS PIPELINE */
-
-		auto vertexShaderBinary = readFile("shaders/hello_triangle.vert.spv");
-		auto fragmentShaderBinary = readFile("shaders/hello_triangle.frag.spv");
-
-		VkShaderModule vertShaderModule = createShaderModule(vertexShaderBinary);
-		VkShaderModule fragShaderModule = createShaderModule(fragmentShaderBinary);
-
-		// Vertex Shader
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
-		vertShaderStageInfo.pName = "main";
-		/*
-		* "pSpecializationInfo" can be used to specify values for shader constants.
-		* This allows for compile time optimizations in the shader source code,
-		* like eliminating "if" statements. This might come in handy (in the future)
-		* for adding debug flags to shaders and creating debug visualizations.
-		*/
-		vertShaderStageInfo.pSpecializationInfo = nullptr;
-
-		// Fragment shader
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
-		fragShaderStageInfo.pName = "main";
-
-		// Combined stages
-		VkPipelineShaderStageCreateInfo shaderStages[] = {
-			vertShaderStageInfo,
-			fragShaderStageInfo
-		};
-		
-		/* FIXED FUNCTION STAGES OF THE GRAPHICS PIPELINE */
-		auto bindingDescription = Vertex::getBindingDescription();
 		auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.vertexAttributeDescriptionCount =
-			static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+		key.vertexLayout = pipelineCache.addVertexLayout(
+			{ Vertex::getBindingDescription() },
+			{ attributeDescriptions.begin(), attributeDescriptions.end() });
+		key.renderPass = pipelineCache.setRenderPass(renderPass, getScenePassCompatibility());
 
 		/*
 		* Here we specify the topology of the primitives in this pipeline. 
@@ -774,197 +1501,53 @@ private:
 		* without reuse
 		* VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP: the second and third vertex of every 
 		* triangle are used as first two vertices of the next triangle
-		* 
-		* If "primitiveRestartEnable" is set to VK_TRUE, in the _STRIP topologies the 
-		* index 0xFFFF or 0xFFFFFFFF can be used to break up sets of lines and triangles.
 		*/
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
+		key.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
-		VkRect2D scissor{};
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapChainExtent;
-
-		VkPipelineViewportStateCreateInfo viewportState{};
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
-
-		VkPipelineRasterizationStateCreateInfo rasterizer{};
-		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable = VK_FALSE; // near and far plane clipping (if VK_TRUE values are clamped to near/far plane)
-		rasterizer.rasterizerDiscardEnable = VK_FALSE;
 		/*
 		* VK_POLYGON_MODE_FILL: fill the area of the polygon with fragments
 		* VK_POLYGON_MODE_LINE: polygon edges are drawn as lines
 		* VK_POLYGON_MODE_POINT: polygon vertices are drawn as points
 		*/
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-		
-		//thicc
-		rasterizer.lineWidth = 1.0f; 
-		
-		// back-face culling
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		
-		// the order of vertices which defines the "front" face via the right hand rule (RHR)
-		/*rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE; */
-		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		
-		rasterizer.depthBiasEnable = VK_FALSE;
-		rasterizer.depthBiasConstantFactor = 0.0f;
-		rasterizer.depthBiasClamp = 0.0f;
-		rasterizer.depthBiasSlopeFactor = 0.0f;
-
-		VkPipelineMultisampleStateCreateInfo multisampling{};
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-		multisampling.minSampleShading = 1.0f;
-		multisampling.pSampleMask = nullptr;
-		multisampling.alphaToCoverageEnable = VK_FALSE;
-		multisampling.alphaToOneEnable = VK_FALSE;
-
-		// Depth and Stencil testing (skipping for now)
-
-		
-		// No alpha blending
-		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-		colorBlendAttachment.colorWriteMask =
-			VK_COLOR_COMPONENT_R_BIT |
-			VK_COLOR_COMPONENT_G_BIT |
-			VK_COLOR_COMPONENT_B_BIT |
-			VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_FALSE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-		// Basic alpha blending
-		/*VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-		colorBlendAttachment.colorWriteMask =
-			VK_COLOR_COMPONENT_R_BIT |
-			VK_COLOR_COMPONENT_G_BIT |
-			VK_COLOR_COMPONENT_B_BIT |
-			VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_TRUE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;*/
-
-		VkPipelineColorBlendStateCreateInfo colorBlending{};
-		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable = VK_FALSE;
-		colorBlending.logicOp = VK_LOGIC_OP_COPY;
-		colorBlending.attachmentCount = 1;
-		colorBlending.pAttachments = &colorBlendAttachment;
-		colorBlending.blendConstants[0] = 0.0f;
-		colorBlending.blendConstants[1] = 0.0f;
-		colorBlending.blendConstants[2] = 0.0f;
-		colorBlending.blendConstants[3] = 0.0f;
-
-		/*VkDynamicState dynamicStates[] = {
-			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_LINE_WIDTH
-		};
-
-		VkPipelineDynamicStateCreateInfo dynamicState{};
-		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicState.dynamicStateCount = 2;
-		dynamicState.pDynamicStates = dynamicStates;*/
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create pipeline layout!");
-		}
-
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = nullptr;
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.pDynamicState = nullptr;
-		pipelineInfo.layout = pipelineLayout;
-		pipelineInfo.renderPass = renderPass;
-		pipelineInfo.subpass = 0;
+		key.polygonMode = VK_POLYGON_MODE_FILL;
 
-		/*
-		* Allows us to derive pipelines from a base pipeline (allows for less
-		* expensive pipeline creation, and faster switching).
-		* These values are only used if the VK_PIPELINE_CREATE_DERIVATIVE_BIT flag 
-		* is also specified in the flags field of VkGraphicsPipelineCreateInfo.
-		*/
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-		pipelineInfo.basePipelineIndex = -1;
+		// back-face culling, the "front" face is given by the right hand rule (RHR)
+		key.cullMode = VK_CULL_MODE_BACK_BIT;
+		key.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create graphics pipeline!");
-		}
+		key.samples = msaaSamples;
+		// No alpha blending
+		key.blend = PipelineBlend::Opaque;
 
-		vkDestroyShaderModule(device, fragShaderModule, nullptr);
-		vkDestroyShaderModule(device, vertShaderModule, nullptr);
+		scenePipelineKey = key;
+		// Shared with every pipeline whose shaders declare the same interface
+		pipelineLayout = pipelineCache.getPipelineLayout(key);
+		// The base pipeline draws of this vertex input fall back to, needed by the first frame, so not left to a worker
+		pipelineCache.build(key);
 	}
 
-	void createFramebuffers() {
-		swapChainFramebuffers.resize(swapChainImageViews.size());
-
-		for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-			VkImageView attachments[] = {
-				swapChainImageViews[i]
-			};
-
-			VkFramebufferCreateInfo framebufferInfo{};
-			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = renderPass;
-			framebufferInfo.attachmentCount = 1;
-			framebufferInfo.pAttachments = attachments;
-			framebufferInfo.width = swapChainExtent.width;
-			framebufferInfo.height = swapChainExtent.height;
-			framebufferInfo.layers = 1;
-
-			if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("Failed to create framebuffer!");
-			}
-		}
-	}
+	/*
+	* Buffers are exclusive to one queue family unless "sharedQueueFamilies"
+	* names more than one, in which case they can be used concurrently by all
+	* of them without ownership transfers.
+	*/
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MemoryUsage memoryUsage,
+		VkBuffer& buffer, VkDeviceMemory& bufferMemory, const std::set<uint32_t>& sharedQueueFamilies = {}) {
+		std::vector<uint32_t> queueFamilies(sharedQueueFamilies.begin(), sharedQueueFamilies.end());
 
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
 		VkBufferCreateInfo bufferInfo{};
 
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
 		bufferInfo.usage = usage;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (queueFamilies.size() > 1) {
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+			bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+		}
+		else {
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		}
 
 		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create buffer!");
@@ -978,34 +1561,32 @@ private:
 		allocInfo.allocationSize = memRequirements.size;
 		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+		if (memoryTracker.allocate(allocInfo, memoryUsage, &bufferMemory) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to allocate buffer memory!");
 		}
 
 		vkBindBufferMemory(device, buffer, bufferMemory, 0);
 	}
 
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-		QueueFamilyIndices queueFamilyIndices = findQueueFamilyIndices(physicalDevice);
-
-		VkCommandPool tempPool;
-		VkCommandPoolCreateInfo poolInfo{};
-		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-
-		if (vkCreateCommandPool(device, &poolInfo, nullptr, &tempPool) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create command pool!");
-		}
-
+	/*
+	* Copies a staging buffer into a device local buffer on the transfer queue
+	* without waiting for the copy. The next frame submission waits for it on
+	* transferTimeline, and with a dedicated transfer family also acquires the
+	* buffer the copy released. The staging buffer is destroyed once that frame
+	* has retired.
+	*/
+	void uploadBuffer(VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory, VkBuffer dstBuffer, VkDeviceSize size,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = tempPool;
+		allocInfo.commandPool = transferCommandPool;
 		allocInfo.commandBufferCount = 1;
 
 		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate transfer command buffer!");
+		}
 
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -1017,44 +1598,154 @@ private:
 		copyRegion.srcOffset = 0;
 		copyRegion.dstOffset = 0;
 		copyRegion.size = size;
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, dstBuffer, 1, &copyRegion);
+
+		if (transferQueueFamily != graphicsQueueFamily) {
+			/*
+			* Exclusive resources belong to one queue family at a time. The release
+			* half of the ownership transfer runs here, the acquire half (same
+			* barrier, with the destination access) on the graphics queue.
+			*/
+			VkBufferMemoryBarrier release{};
+			release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			release.dstAccessMask = 0;
+			release.srcQueueFamilyIndex = transferQueueFamily;
+			release.dstQueueFamilyIndex = graphicsQueueFamily;
+			release.buffer = dstBuffer;
+			release.offset = 0;
+			release.size = size;
+
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0, 0, nullptr, 1, &release, 0, nullptr);
+
+			VkBufferMemoryBarrier acquire = release;
+			acquire.srcAccessMask = 0;
+			acquire.dstAccessMask = dstAccess;
+			pendingUploadAcquires.push_back(acquire);
+		}
+		pendingUploadStages |= dstStage;
 
 		vkEndCommandBuffer(commandBuffer);
 
+		uint64_t transferValue = submittedTransferValue + 1;
+
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.signalSemaphoreValueCount = 1;
+		timelineSubmitInfo.pSignalSemaphoreValues = &transferValue;
+
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineSubmitInfo;
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &transferTimeline;
+
+		if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit transfer command buffer!");
+		}
+		submittedTransferValue = transferValue;
+
+		// The next frame waits for this copy, so once it retires the copy is done as well
+		deletionQueue.push(submittedFrameValue + 1, [this, commandBuffer, stagingBuffer, stagingBufferMemory]() {
+			vkFreeCommandBuffers(device, transferCommandPool, 1, &commandBuffer);
+			vkDestroyBuffer(device, stagingBuffer, nullptr);
+			memoryTracker.free(stagingBufferMemory);
+		});
+	}
+
+	/*
+	* Records the acquire half of all uploads since the last frame into this
+	* frame slot's command buffer. Returns false if there is nothing to acquire.
+	*/
+	bool recordUploadAcquires() {
+		if (pendingUploadAcquires.empty()) {
+			return false;
+		}
+
+		VkCommandBuffer commandBuffer = uploadAcquireCommandBuffers[currentFrame];
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		/* We could use fences here and that would allow us to schedule multiple-transfers to the GPU and optimize loading */
-		vkQueueWaitIdle(graphicsQueue);
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pendingUploadStages,
+			0, 0, nullptr,
+			static_cast<uint32_t>(pendingUploadAcquires.size()), pendingUploadAcquires.data(),
+			0, nullptr);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record upload acquire command buffer!");
+		}
 
-		vkFreeCommandBuffers(device, tempPool, 1, &commandBuffer);
-		vkDestroyCommandPool(device, tempPool, nullptr);
+		pendingUploadAcquires.clear();
+		return true;
 	}
 
 	void createCommandPool() {
-		QueueFamilyIndices queueFamilyIndices = findQueueFamilyIndices(physicalDevice);
-
 		VkCommandPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+		poolInfo.queueFamilyIndex = graphicsQueueFamily;
 		/*
 		* VK_COMMAND_POOL_CREATE_TRANSIENT_BIT: Hint that command buffers are rerecorded with new commands very often (may change memory allocation behavior)
 		* VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT: Allow command buffers to be rerecorded individually, without this flag they all have to be reset together
+		* The upload acquire command buffers are rerecorded individually every frame.
 		*/
-		poolInfo.flags = 0;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create command pool!");
 		}
 
+		VkCommandPoolCreateInfo transferPoolInfo{};
+		transferPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		transferPoolInfo.queueFamilyIndex = transferQueueFamily;
+		transferPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		if (vkCreateCommandPool(device, &transferPoolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create transfer command pool!");
+		}
+
+		VkCommandPoolCreateInfo computePoolInfo{};
+		computePoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		computePoolInfo.queueFamilyIndex = computeQueueFamily;
+		computePoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(device, &computePoolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute command pool!");
+		}
+
+		if (presentQueueFamily != graphicsQueueFamily) {
+			VkCommandPoolCreateInfo presentPoolInfo{};
+			presentPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			presentPoolInfo.queueFamilyIndex = presentQueueFamily;
+			presentPoolInfo.flags = 0;
+
+			if (vkCreateCommandPool(device, &presentPoolInfo, nullptr, &presentCommandPool) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create present command pool!");
+			}
+		}
+
+		uploadAcquireCommandBuffers.resize(settings.framesInFlight);
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = settings.framesInFlight;
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, uploadAcquireCommandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate upload acquire command buffers!");
+		}
 	}
 
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+		const VkPhysicalDeviceMemoryProperties& memProperties = capabilities.memoryProperties;
 
 		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
 			if ((typeFilter & (1 << i)) &&
@@ -1075,6 +1766,7 @@ private:
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
 			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			MemoryUsage::Staging,
 			stagingBuffer,
 			stagingBufferMemory);
 		
@@ -1087,17 +1779,32 @@ private:
 			VK_BUFFER_USAGE_TRANSFER_DST_BIT |
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			MemoryUsage::Vertex,
 			vertexBuffer,
 			vertexBufferMemory);
 
-		copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+		uploadBuffer(stagingBuffer, stagingBufferMemory, vertexBuffer, bufferSize,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	}
+
+	/*
+	* Simplified index buffers of the scene mesh. They only index the
+	* original vertices, so every level shares vertexBuffer.
+	*/
+	void createSceneLods() {
+		std::vector<glm::vec3> positions;
+		positions.reserve(vertices.size());
+		for (const auto& vertex : vertices) {
+			positions.push_back(glm::vec3(vertex.pos.x, vertex.pos.y, 0.0f));
+		}
 
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		sceneLods = MeshLodChain(positions, std::vector<uint32_t>(indices.begin(), indices.end()));
 	}
 
 	void createIndexBuffer() {
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+		// Still 16 bit, simplifying never adds vertices
+		std::vector<uint16_t> lodIndices(sceneLods.getIndices().begin(), sceneLods.getIndices().end());
+		VkDeviceSize bufferSize = sizeof(lodIndices[0]) * lodIndices.size();
 
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingBufferMemory;
@@ -1105,79 +1812,121 @@ private:
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
 			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			MemoryUsage::Staging,
 			stagingBuffer,
 			stagingBufferMemory);
 
 		void* data;
 		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, indices.data(), (size_t)bufferSize);
+		memcpy(data, lodIndices.data(), (size_t)bufferSize);
 		vkUnmapMemory(device, stagingBufferMemory);
 
 		createBuffer(bufferSize,
 			VK_BUFFER_USAGE_TRANSFER_DST_BIT |
 			VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			MemoryUsage::Index,
 			indexBuffer,
 			indexBufferMemory);
 
-		copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		uploadBuffer(stagingBuffer, stagingBufferMemory, indexBuffer, bufferSize,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 	}
 
-	void createUniformBuffers() {
+	void createUniformBuffers(WindowUniforms& target, size_t imageCount) {
 		VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
-		uniformBuffers.resize(swapChainImages.size());
-		uniformBuffersMemory.resize(swapChainImages.size());
+		target.buffers.resize(imageCount);
+		target.memory.resize(imageCount);
+		target.mapped.resize(imageCount);
+		// Nothing written yet, the first frame using each buffer copies everything
+		target.sceneVersions.assign(imageCount, 0);
+		target.cameraVersions.assign(imageCount, 0);
 
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
+		for (size_t i = 0; i < imageCount; i++) {
 			createBuffer(bufferSize,
 				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
 				VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				uniformBuffers[i],
-				uniformBuffersMemory[i]);
+				MemoryUsage::Uniform,
+				target.buffers[i],
+				target.memory[i]);
+
+			vkMapMemory(device, target.memory[i], 0, bufferSize, 0, &target.mapped[i]);
 		}
 	}
 
-	void createDescriptorPool() {
+	// Every frame submitted so far may still read the uniforms
+	void retireUniforms(WindowUniforms& target) {
+		deletionQueue.push(submittedFrameValue, [
+			this,
+			oldBuffers = target.buffers,
+			oldMemory = target.memory,
+			oldDescriptorPool = target.descriptorPool]() {
+			for (size_t i = 0; i < oldBuffers.size(); i++) {
+				vkDestroyBuffer(device, oldBuffers[i], nullptr);
+				memoryTracker.free(oldMemory[i]);
+			}
+
+			if (oldDescriptorPool != VK_NULL_HANDLE) {
+				vkDestroyDescriptorPool(device, oldDescriptorPool, nullptr);
+			}
+		});
+		target = WindowUniforms();
+	}
+
+	/*
+	* The quad is the only object for now. The camera never moves, its
+	* projection follows the swap chain extent in updateUniformBuffer.
+	*/
+	void createScene() {
+		modelObject = scene.createObject(SCENE_OBJECT_NONE, static_cast<uint32_t>(DrawPipeline::Scene));
+		// Circumscribed sphere of the quad's vertices
+		scene.setLocalBounds(modelObject, glm::vec3(0.0f), std::sqrt(0.5f));
+
+		camera.setLookAt(
+			glm::vec3(2.0f, 2.0f, 2.0f),
+			glm::vec3(0.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f)
+		);
+	}
+
+	void createDescriptorPool(WindowUniforms& target) {
 		VkDescriptorPoolSize poolSize{};
 		poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		poolSize.descriptorCount =
-			static_cast<uint32_t>(swapChainImages.size());
+			static_cast<uint32_t>(target.buffers.size());
 
 		VkDescriptorPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		poolInfo.poolSizeCount = 1;
 		poolInfo.pPoolSizes = &poolSize;
-		poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+		poolInfo.maxSets = static_cast<uint32_t>(target.buffers.size());
 		
 		
 
-		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool)) {
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &target.descriptorPool)) {
 			throw std::runtime_error("Fail to create descriptor pool!");
 		}
 	}
 
-	void createDescriptorSets() {
-		std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
+	void createDescriptorSets(WindowUniforms& target) {
+		std::vector<VkDescriptorSetLayout> layouts(target.buffers.size(), descriptorSetLayout);
 		VkDescriptorSetAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorPool = target.descriptorPool;
 		allocInfo.descriptorSetCount =
-			static_cast<uint32_t>(swapChainImages.size());
+			static_cast<uint32_t>(target.buffers.size());
 		allocInfo.pSetLayouts = layouts.data();
 
-		descriptorSets.resize(swapChainImages.size());
-		if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+		target.descriptorSets.resize(target.buffers.size());
+		if (vkAllocateDescriptorSets(device, &allocInfo, target.descriptorSets.data()) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to allocate desciptor sets!");
 		}
 
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
+		for (size_t i = 0; i < target.buffers.size(); i++) {
 			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = uniformBuffers[i];
+			bufferInfo.buffer = target.buffers[i];
 			bufferInfo.offset = 0;
 			bufferInfo.range = sizeof(UniformBufferObject);
 			// OR
@@ -1185,7 +1934,7 @@ private:
 
 			VkWriteDescriptorSet descriptorWrite{};
 			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrite.dstSet = descriptorSets[i];
+			descriptorWrite.dstSet = target.descriptorSets[i];
 			descriptorWrite.dstBinding = 0;
 			descriptorWrite.dstArrayElement = 0;
 			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -1198,8 +1947,153 @@ private:
 		}
 	}
 
+	// The draws of a live frame, replays bring their own
+	std::vector<DrawCommand> buildDrawList() const {
+		return {
+			{ DrawPipeline::Scene, 1, static_cast<uint32_t>(indices.size()), 1, 1 },
+			{ DrawPipeline::Particles, 0, particleCount, 1, 0 }
+		};
+	}
+
+	/*
+	* Orders frameInputs.draws by what they bind in one view: small ids of the
+	* actual pipeline, descriptor set and vertex buffer handles, then the view
+	* space distance (front to back, nothing is blended). Every window sorts
+	* for itself, since each has its own descriptor sets and camera.
+	*/
+	void sortDrawList(VkDescriptorSet descriptorSet, float sceneDepth) {
+		drawList.clear();
+		pipelineIds.trim();
+		descriptorSetIds.trim();
+		meshIds.trim();
+
+		boundDraws.resize(frameInputs.draws.size());
+		for (uint32_t i = 0; i < frameInputs.draws.size(); i++) {
+			const DrawCommand& draw = frameInputs.draws[i];
+			BoundDraw& bound = boundDraws[i];
+			bool scene = draw.pipeline == DrawPipeline::Scene;
+
+			const PipelineKey& key = scene ? scenePipelineKey : particlePipelineKey;
+			bound.pipeline = pipelineCache.get(key, getFallbackPipelineKey(key));
+			// Particles have no descriptors, and read this frame's simulation output as vertex input
+			bound.descriptorSet = scene ? descriptorSet : VK_NULL_HANDLE;
+			bound.vertexBuffer = scene ? vertexBuffer : particleBuffers[currentParticleBuffer];
+
+			DrawKeyFields fields{};
+			fields.pass = 0;
+			fields.pipeline = pipelineIds.get((uint64_t)bound.pipeline);
+			fields.descriptorSet = descriptorSetIds.get((uint64_t)bound.descriptorSet);
+			fields.mesh = meshIds.get((uint64_t)bound.vertexBuffer);
+			// Particles are drawn in clip space at z = 0, on the near plane
+			fields.depth = quantizeDrawDepth(scene ? sceneDepth : 0.0f);
+			drawList.add(encodeDrawKey(fields), i);
+		}
+		drawList.sort();
+	}
+
+	/*
+	* What a draw uses while its own pipeline is still being built: the base
+	* pipeline of the same vertex input and render pass, if there is one.
+	* Other vertex inputs would read their buffers wrongly, those draws wait.
+	*/
+	const PipelineKey* getFallbackPipelineKey(const PipelineKey& key) const {
+		if (key.vertexLayout == scenePipelineKey.vertexLayout && key.renderPass == scenePipelineKey.renderPass) {
+			return &scenePipelineKey;
+		}
+		return nullptr;
+	}
+
+	void recordScenePass(VkCommandBuffer commandBuffer, VkExtent2D extent, VkDescriptorSet descriptorSet, uint32_t lodLevel, float sceneDepth) {
+		VkDeviceSize offsets[] = { 0 };
+
+		sortDrawList(descriptorSet, sceneDepth);
+
+		VkViewport viewport{};
+		viewport.width = (float)extent.width;
+		viewport.height = (float)extent.height;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor{};
+		scissor.extent = extent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		/*
+		* In sort key order, binding only what differs from the previous draw.
+		* Descriptor sets stay bound across pipeline changes: pipelines with the
+		* same interface share one layout (see pipelineLayouts), and a layout
+		* without set 0 does not disturb it.
+		*/
+		drawState.reset();
+		for (const auto& entry : drawList.getEntries()) {
+			const DrawCommand& draw = frameInputs.draws[entry.draw];
+			const BoundDraw& bound = boundDraws[entry.draw];
+
+			if (bound.pipeline == VK_NULL_HANDLE) {
+				// Still being built by a worker and nothing can stand in, counted so it is not lost silently
+				drawState.countWaitingDraw();
+				continue;
+			}
+			if (drawState.bind(DrawState::Pipeline, (uint64_t)bound.pipeline)) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bound.pipeline);
+			}
+
+			if (drawState.bind(DrawState::VertexBuffer, (uint64_t)bound.vertexBuffer)) {
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &bound.vertexBuffer, offsets);
+			}
+
+			if (draw.indexed && drawState.bind(DrawState::IndexBuffer, (uint64_t)indexBuffer)) {
+				vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+			}
+
+			if (bound.descriptorSet != VK_NULL_HANDLE && drawState.bind(DrawState::DescriptorSet, (uint64_t)bound.descriptorSet)) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &bound.descriptorSet, 0, nullptr);
+			}
+
+			drawState.countDraw();
+
+			if (draw.indexed) {
+				// Draws of the scene mesh get the view's level of detail
+				uint32_t firstIndex = 0;
+				uint32_t indexCount = draw.count;
+				if (draw.lod) {
+					const MeshLod& lod = sceneLods.getLevel(lodLevel);
+					firstIndex = lod.firstIndex;
+					indexCount = lod.indexCount;
+				}
+				vkCmdDrawIndexed(commandBuffer, indexCount, draw.instanceCount, firstIndex, 0, 0);
+			}
+			else {
+				vkCmdDraw(commandBuffer, draw.count, draw.instanceCount, 0, 0);
+			}
+		}
+	}
+
+	// Timestamp "query" (0 begins, 1 ends) of the GPU frame time dynamic resolution is driven by
+	void writeFrameTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t query) {
+		if (dynamicResolutionEnabled && timestampPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(commandBuffer, stage, timestampPool, static_cast<uint32_t>(2 * currentFrame) + query);
+		}
+	}
+
+	// Stretches the rendered part of the offscreen scene image over the whole swap chain image
+	void recordUpscalePass(VkCommandBuffer commandBuffer, VkImage swapChainImage) {
+		VkImageBlit blit{};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.layerCount = 1;
+		blit.srcOffsets[1] = { static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.layerCount = 1;
+		blit.dstOffsets[1] = { static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1 };
+
+		vkCmdBlitImage(commandBuffer,
+			renderGraph.getImage(sceneColor, 0), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			swapChainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+	}
+
 	void createCommandBuffers() {
-		commandBuffers.resize(swapChainFramebuffers.size());
+		commandBuffers.resize(settings.framesInFlight);
 
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1214,173 +2108,946 @@ private:
 		if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to allocate command buffers!");
 		}
+	}
 
-		for (size_t i = 0; i < commandBuffers.size(); i++) {
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			/*
-			* VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: The command buffer will be rerecorded right after executing it once.
-			* VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT: This is a secondary command buffer that will be entirely within a single render pass.
-			* VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: The command buffer can be resubmitted while it is also already pending execution.
-			*/
-			beginInfo.flags = 0;
-			beginInfo.pInheritanceInfo = nullptr;
+	/*
+	* Command buffers are recorded every frame into the frame slot's buffer,
+	* since what gets drawn (e.g. which particle buffer) changes per frame.
+	*/
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		/*
+		* VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: The command buffer will be rerecorded right after executing it once.
+		* VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT: This is a secondary command buffer that will be entirely within a single render pass.
+		* VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: The command buffer can be resubmitted while it is also already pending execution.
+		*/
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = nullptr;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin recording command buffer!");
+		}
+
+		// Outside of any render pass, the timestamps themselves are written by the scene and upscale passes
+		bool measured = dynamicResolutionEnabled && timestampPool != VK_NULL_HANDLE;
+		if (measured) {
+			vkCmdResetQueryPool(commandBuffer, timestampPool, static_cast<uint32_t>(2 * currentFrame), 2);
+		}
+
+		renderExtent = swapChainExtent;
+		if (dynamicResolutionEnabled) {
+			resolutionController.getRenderSize(swapChainExtent.width, swapChainExtent.height, renderExtent.width, renderExtent.height);
+			renderGraph.setRenderArea("scene", renderExtent);
+		}
+
+		// Render passes, barriers and the per-pass draw callbacks all come from the render graph
+		renderGraph.execute(commandBuffer, imageIndex);
+
+		if (presentQueueFamily != graphicsQueueFamily) {
+			// Release half of the swap chain image ownership transfer, the graph already moved it to PRESENT_SRC
+			VkImageMemoryBarrier release = swapChainOwnershipBarrier(swapChainImages[imageIndex]);
+			VkPipelineStageFlags lastStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			release.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			if (dynamicResolutionEnabled) {
+				lastStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+				release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			}
+			if (readbackEnabled) {
+				// The readback copy is the last one to touch the image
+				lastStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			}
+			vkCmdPipelineBarrier(commandBuffer,
+				lastStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &release);
+		}
 
-			if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-				throw std::runtime_error("Failed to begin recording command buffer!");
+		// The other windows which got an image this frame render into the same command buffer
+		for (auto& output : secondaryWindows) {
+			if (output.imageIndex == UINT32_MAX) {
+				continue;
 			}
+			output.renderGraph.execute(commandBuffer, output.imageIndex);
+
+			if (presentQueueFamily != graphicsQueueFamily) {
+				// Same release as the first window's, their scene pass (or its resolve) writes the image last
+				VkImageMemoryBarrier release = swapChainOwnershipBarrier(output.images[output.imageIndex]);
+				release.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer,
+					VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+					0, 0, nullptr, 0, nullptr, 1, &release);
+			}
+		}
 
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass;
-			renderPassInfo.framebuffer = swapChainFramebuffers[i];
-			renderPassInfo.renderArea.offset = { 0, 0 };
-			renderPassInfo.renderArea.extent = swapChainExtent;
+		drawState.endFrame();
 
-			VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
-			renderPassInfo.clearValueCount = 1;
-			renderPassInfo.pClearValues = &clearColor;
+		if (measured) {
+			timestampScales[currentFrame] = resolutionController.getScale();
+		}
 
-			/*
-			* VK_SUBPASS_CONTENTS_INLINE: The render pass commands will be embedded in the primary command buffer itself and no secondary command buffers will be executed.
-			* VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: The render pass commands will be executed from secondary command buffers.
-			*/
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record command buffer!");
+		}
+	}
+
+	VkImageMemoryBarrier swapChainOwnershipBarrier(VkImage image) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		barrier.srcQueueFamilyIndex = graphicsQueueFamily;
+		barrier.dstQueueFamilyIndex = presentQueueFamily;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		return barrier;
+	}
+
+	// Acquire half of the swap chain image ownership transfer, submitted on the present queue
+	void createPresentAcquireCommandBuffers() {
+		presentAcquireCommandBuffers = createPresentAcquireCommandBuffers(swapChainImages);
+	}
 
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	// One per image of any window's swap chain
+	std::vector<VkCommandBuffer> createPresentAcquireCommandBuffers(const std::vector<VkImage>& images) {
+		std::vector<VkCommandBuffer> commandBuffers(images.size());
 
-			VkBuffer vertexBuffers[] = { vertexBuffer };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = presentCommandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 
-			vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+		if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate present command buffers!");
+		}
 
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+		for (size_t i = 0; i < commandBuffers.size(); i++) {
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			// Completion on the present queue is not tracked by the frame timeline
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 
-			/*vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);*/
-			vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+			vkBeginCommandBuffer(commandBuffers[i], &beginInfo);
 
-			vkCmdEndRenderPass(commandBuffers[i]);
+			VkImageMemoryBarrier acquire = swapChainOwnershipBarrier(images[i]);
+			vkCmdPipelineBarrier(commandBuffers[i],
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &acquire);
 
 			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("Failed to record command buffer!");
+				throw std::runtime_error("Failed to record present command buffer!");
 			}
 		}
+		return commandBuffers;
 	}
 
-	void createSyncObjects() {
-		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+	/*
+	* Draws the particle buffer as a point list. Same render pass and fixed
+	* function state as the scene pipeline, but no descriptors: the vertex
+	* shader reads the simulation output as plain vertex input.
+	*/
+	void createParticlePipeline() {
+		PipelineKey key{};
+		key.vertexShader = getPipelineShader("particles.vert.spv");
+		key.fragmentShader = getPipelineShader("hello_triangle.frag.spv");
+
+		auto attributeDescriptions = Particle::getAttributeDescriptions();
+		key.vertexLayout = pipelineCache.addVertexLayout(
+			{ Particle::getBindingDescription() },
+			{ attributeDescriptions.begin(), attributeDescriptions.end() });
+		key.renderPass = pipelineCache.setRenderPass(renderPass, getScenePassCompatibility());
+
+		key.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+		key.cullMode = VK_CULL_MODE_NONE;
+		key.samples = msaaSamples;
+
+		particlePipelineKey = key;
+		particlePipelineLayout = pipelineCache.getPipelineLayout(key);
+		// Not built here: the first particle draw queues it on a worker, like any other variant
+	}
+
+	void createParticleSimulation() {
+		const ShaderReflection& reflection = getShaderReflection("particles.comp.spv");
+		if (reflection.getPushConstantRange().size != sizeof(ParticleSimulationConstants)) {
+			throw std::runtime_error("ParticleSimulationConstants does not match the push constants of particles.comp!");
+		}
+		particleSimulation.create(device, pipelineLayouts, shaders.get("particles.comp.spv"), reflection);
 
 		/*
-		* Fences are mainly designed to synchronize your application itself with
-		* rendering operation (CPU-GPU), whereas semaphores are used to synchronize operations
-		* within or across command queues (GPU-GPU).
+		* Written on the compute queue and read as vertex input on the graphics
+		* queue every frame. Concurrent sharing spares us a release/acquire pair
+		* (and an extra submission) per frame, and buffers have no compressed
+		* layouts that exclusive ownership would preserve.
 		*/
-		VkSemaphoreCreateInfo semaphoreInfo{};
-		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-		
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		size_t bufferCount = settings.framesInFlight + 1;
+		VkDeviceSize bufferSize = sizeof(Particle) * particleCount;
+		particleBuffers.resize(bufferCount);
+		particleBuffersMemory.resize(bufferCount);
+		for (size_t i = 0; i < bufferCount; i++) {
+			createBuffer(bufferSize,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				MemoryUsage::Storage,
+				particleBuffers[i],
+				particleBuffersMemory[i],
+				{ graphicsQueueFamily, computeQueueFamily });
+		}
 
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSize.descriptorCount = static_cast<uint32_t>(2 * bufferCount);
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
-				throw std::runtime_error("Failed to create synchronization objects for a frame!");
-			}
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		poolInfo.maxSets = static_cast<uint32_t>(bufferCount);
+
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &particleDescriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create particle descriptor pool!");
 		}
-	}
 
-	void cleanupSwapChain() {
+		std::vector<VkDescriptorSetLayout> layouts(bufferCount, particleSimulation.getDescriptorSetLayout());
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = particleDescriptorPool;
+		allocInfo.descriptorSetCount = static_cast<uint32_t>(bufferCount);
+		allocInfo.pSetLayouts = layouts.data();
 
-		for (auto framebuffer : swapChainFramebuffers) {
-			vkDestroyFramebuffer(device, framebuffer, nullptr);
+		particleDescriptorSets.resize(bufferCount);
+		if (vkAllocateDescriptorSets(device, &allocInfo, particleDescriptorSets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate particle descriptor sets!");
 		}
 
-		vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+		// Set i reads the previous buffer and writes buffer i
+		for (size_t i = 0; i < bufferCount; i++) {
+			VkDescriptorBufferInfo bufferInfos[2]{};
+			bufferInfos[0].buffer = particleBuffers[(i + bufferCount - 1) % bufferCount];
+			bufferInfos[0].range = VK_WHOLE_SIZE;
+			bufferInfos[1].buffer = particleBuffers[i];
+			bufferInfos[1].range = VK_WHOLE_SIZE;
 
-		vkDestroyPipeline(device, graphicsPipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-		vkDestroyRenderPass(device, renderPass, nullptr);
+			VkWriteDescriptorSet descriptorWrite{};
+			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite.dstSet = particleDescriptorSets[i];
+			descriptorWrite.dstBinding = 0;
+			descriptorWrite.dstArrayElement = 0;
+			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrite.descriptorCount = 2;
+			descriptorWrite.pBufferInfo = bufferInfos;
 
-		for (auto imageView : swapChainImageViews) {
-			vkDestroyImageView(device, imageView, nullptr);
+			vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
 		}
 
-		vkDestroySwapchainKHR(device, swapChain, nullptr);
+		computeCommandBuffers.resize(settings.framesInFlight);
 
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-			vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-		}
+		VkCommandBufferAllocateInfo commandBufferInfo{};
+		commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferInfo.commandPool = computeCommandPool;
+		commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferInfo.commandBufferCount = settings.framesInFlight;
 
-		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		if (vkAllocateCommandBuffers(device, &commandBufferInfo, computeCommandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate compute command buffers!");
+		}
 	}
 
-	void recreateSwapChain() {
-		
-		/* For now, we pause when the application is minimized, later we will have to come up with a better approach. */
-		int width = 0;
-		int height = 0;
-		glfwGetFramebufferSize(window, &width, &height);
-		while (width == 0 || height == 0) {
-			glfwGetFramebufferSize(window, &width, &height);
-			glfwWaitEvents();
+	/*
+	* Submits this frame's particle step to the compute queue. It only depends
+	* on the previous step, so it overlaps with the graphics work of earlier
+	* frames; the scene pass waits for it on computeTimeline at vertex input.
+	*/
+	void simulateParticles(uint64_t frameValue) {
+		ParticleSimulationConstants constants{};
+		constants.particleCount = particleCount;
+		if (particlesInitialized) {
+			constants.deltaTime = frameInputs.deltaTime;
+			constants.reset = 0;
+		}
+		else {
+			// The very first step seeds the particles on the GPU, nothing has to be uploaded
+			constants.deltaTime = 0.0f;
+			constants.reset = 1;
+			particlesInitialized = true;
 		}
+		simulationTime += constants.deltaTime;
+		constants.time = simulationTime;
 
-		vkDeviceWaitIdle(device);
+		currentParticleBuffer = frameValue % particleBuffers.size();
 
-		cleanupSwapChain();
+		VkCommandBuffer commandBuffer = computeCommandBuffers[currentFrame];
+		vkResetCommandBuffer(commandBuffer, 0);
 
-		createSwapChain();
-		createImageViews();
-		createRenderPass();
-		createGraphicsPipeline();
-		createFramebuffers();
-		createUniformBuffers();
-		createDescriptorPool();
-		createDescriptorSets();
-		createCommandBuffers();
-	}
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-	void updateUniformBuffer(uint32_t currentImage) {
-		static auto startTime = std::chrono::high_resolution_clock::now();
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+		// The previous step was an earlier submission on this queue, make its writes visible
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
 
-		UniformBufferObject ubo{};
-		ubo.model = glm::rotate(
-			glm::mat4(1.0f), 
-			time * glm::radians(90.0f), 
-			glm::vec3(0.0f, 0.0f, 1.0f)
-		);
+		particleSimulation.bind(commandBuffer, particleDescriptorSets[currentParticleBuffer], &constants);
+		ComputePipeline::dispatch(commandBuffer, particleCount, particleWorkgroupSize);
 
-		ubo.view = glm::lookAt(
-			glm::vec3(2.0f, 2.0f, 2.0f),
-			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(0.0f, 0.0f, 1.0f)
-		);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record compute command buffer!");
+		}
 
-		ubo.proj = glm::perspective(
-			glm::radians(45.0f),
-			swapChainExtent.width / (float)swapChainExtent.height,
-			0.1f,
-			10.0f
-		);
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.signalSemaphoreValueCount = 1;
+		timelineSubmitInfo.pSignalSemaphoreValues = &frameValue;
 
-		// Invert the y-axis by negating the y-scale factor in the projection matrix
-		ubo.proj[1][1] *= -1;
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineSubmitInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &computeTimeline;
 
-		void* data;
-		vkMapMemory(device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-		memcpy(data, &ubo, sizeof(ubo));
-		vkUnmapMemory(device, uniformBuffersMemory[currentImage]);
+		if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit compute command buffer!");
+		}
+	}
+
+	void createTimestampQueryPool() {
+		timestampScales.assign(settings.framesInFlight, 0.0);
+		if (settings.dynamicResolutionTarget <= 0.0f ||
+			capabilities.queueFamilyProperties[graphicsQueueFamily].timestampValidBits == 0) {
+			return;
+		}
+
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = 2 * settings.framesInFlight;
+
+		if (vkCreateQueryPool(device, &poolInfo, nullptr, &timestampPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timestamp query pool!");
+		}
+	}
+
+	// Feeds the GPU time of the frame which last used this frame slot to the resolution controller
+	void readFrameTimestamps(size_t frameSlot) {
+		if (timestampScales[frameSlot] == 0.0) {
+			return;
+		}
+
+		uint64_t timestamps[2];
+		VkResult result = vkGetQueryPoolResults(device, timestampPool, static_cast<uint32_t>(2 * frameSlot), 2,
+			sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS) {
+			uint32_t validBits = capabilities.queueFamilyProperties[graphicsQueueFamily].timestampValidBits;
+			uint64_t mask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+			uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+			double seconds = ticks * static_cast<double>(capabilities.properties.limits.timestampPeriod) * 1e-9;
+			resolutionController.onGpuFrameTime(seconds, timestampScales[frameSlot]);
+		}
+		timestampScales[frameSlot] = 0.0;
+	}
+
+	void createSyncObjects() {
+		imageAvailableSemaphores.resize(settings.framesInFlight);
+		renderFinishedSemaphores.resize(settings.framesInFlight);
+		imageFrameValues.assign(swapChainImages.size(), 0);
+
+		/*
+		* Fences are mainly designed to synchronize your application itself with
+		* rendering operation (CPU-GPU), whereas semaphores are used to synchronize operations
+		* within or across command queues (GPU-GPU).
+		* Timeline semaphores do both: the CPU can wait for a counter value the
+		* GPU signals, so a single one replaces all of our per-frame fences.
+		* Swap chain acquire/present still only accept binary semaphores.
+		*/
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		for (size_t i = 0; i < settings.framesInFlight; i++) {
+			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+				vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create synchronization objects for a frame!");
+			}
+		}
+
+		if (presentQueueFamily != graphicsQueueFamily) {
+			presentReadySemaphores.resize(settings.framesInFlight);
+			for (size_t i = 0; i < settings.framesInFlight; i++) {
+				if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &presentReadySemaphores[i]) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create synchronization objects for a frame!");
+				}
+			}
+		}
+
+		VkSemaphoreTypeCreateInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timelineInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo timelineSemaphoreInfo{};
+		timelineSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		timelineSemaphoreInfo.pNext = &timelineInfo;
+
+		if (vkCreateSemaphore(device, &timelineSemaphoreInfo, nullptr, &frameTimeline) != VK_SUCCESS ||
+			vkCreateSemaphore(device, &timelineSemaphoreInfo, nullptr, &transferTimeline) != VK_SUCCESS ||
+			vkCreateSemaphore(device, &timelineSemaphoreInfo, nullptr, &computeTimeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timeline semaphores!");
+		}
+	}
+
+	// Blocks until the GPU has finished the frame which signaled "frameValue"
+	void waitForFrame(uint64_t frameValue) {
+		if (frameValue <= completedFrameValue) {
+			return;
+		}
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &frameTimeline;
+		waitInfo.pValues = &frameValue;
+
+		if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to wait for frame timeline semaphore!");
+		}
+
+		completedFrameValue = frameValue;
+		framePacer.onRetired(frameValue, FramePacer::Clock::now());
+	}
+
+	// Feeds frames which finished since the last call to the frame pacer, without blocking
+	void collectCompletedFrames() {
+		uint64_t timelineValue = 0;
+		if (vkGetSemaphoreCounterValue(device, frameTimeline, &timelineValue) == VK_SUCCESS &&
+			timelineValue > completedFrameValue) {
+			completedFrameValue = timelineValue;
+			framePacer.onRetired(timelineValue, FramePacer::Clock::now());
+		}
+
+		// Presents complete in order, so stop at the first one still queued
+		while (presentWaitEnabled && framePacer.hasPendingFrames()) {
+			uint64_t presentId = framePacer.getOldestPendingFrame();
+			if (waitForPresentKHR(device, swapChain, presentId, 0) != VK_SUCCESS) {
+				break;
+			}
+			framePacer.onPresented(presentId, FramePacer::Clock::now());
+		}
+	}
+
+	/*
+	* By default we only pick up finished frames for the latency statistics.
+	* In low-latency mode we block until the previous frame is done (shown,
+	* if present wait is available) and then sleep for whatever slack the
+	* pacer predicts, so input gets sampled as late as possible.
+	*/
+	void waitForFrameStart() {
+		if (settings.lowLatency && submittedFrameValue > 0) {
+			waitForFrame(submittedFrameValue);
+
+			// Ids of a retired swap chain never complete on the current one
+			if (presentWaitEnabled && lastPresentId != 0) {
+				// Bounded, a hidden window may never show the frame
+				const uint64_t timeoutNanoseconds = 100000000;
+				if (waitForPresentKHR(device, swapChain, lastPresentId, timeoutNanoseconds) == VK_SUCCESS) {
+					framePacer.onPresented(lastPresentId, FramePacer::Clock::now());
+				}
+			}
+
+			std::this_thread::sleep_for(framePacer.getFrameStartDelay());
+		}
+
+		collectCompletedFrames();
+		deletionQueue.flush(completedFrameValue);
+	}
+
+	/*
+	* Hands everything created for the current swap chain (except the swap chain
+	* itself, which createSwapChain still needs as oldSwapchain) to the deletion
+	* queue. Every frame submitted so far may still reference these objects.
+	*/
+	void cleanupSwapChain() {
+		auto retiredRenderGraph = std::make_shared<RenderGraph>(std::move(renderGraph));
+		renderGraph = RenderGraph();
+
+		deletionQueue.push(submittedFrameValue, [
+			this,
+			retiredRenderGraph,
+			oldPresentAcquireCommandBuffers = presentAcquireCommandBuffers,
+			oldImageViews = swapChainImageViews]() {
+			if (!oldPresentAcquireCommandBuffers.empty()) {
+				vkFreeCommandBuffers(device, presentCommandPool,
+					static_cast<uint32_t>(oldPresentAcquireCommandBuffers.size()), oldPresentAcquireCommandBuffers.data());
+			}
+
+			// The pipelines stay in pipelineCache, they work with the new (compatible) scene pass
+			retiredRenderGraph->reset();
+
+			for (auto imageView : oldImageViews) {
+				vkDestroyImageView(device, imageView, nullptr);
+			}
+		});
+		retireUniforms(uniforms);
+	}
+
+	void recreateSwapChain() {
+		/*
+		* A minimized window has nothing to render into. Instead of waiting for it
+		* in here, suspend: mainLoop sleeps in the window system and recreates
+		* the swap chain once the window is back.
+		*/
+		int width = 0;
+		int height = 0;
+		glfwGetFramebufferSize(window, &width, &height);
+		if (width == 0 || height == 0) {
+			frameScheduler.setSuspended(true);
+			return;
+		}
+		framebufferSize = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+
+		// No vkDeviceWaitIdle, frames in flight keep using the old objects until they retire
+		cleanupSwapChain();
+		// Present ids belong to the retired swap chain
+		framePacer.forgetPendingFrames();
+		lastPresentId = 0;
+
+		createSwapChain();
+		imageFrameValues.assign(swapChainImages.size(), 0);
+		createImageViews();
+		createRenderGraph();
+		createGraphicsPipeline();
+		createParticlePipeline();
+		createUniformBuffers(uniforms, swapChainImages.size());
+		createDescriptorPool(uniforms);
+		createDescriptorSets(uniforms);
+		if (presentQueueFamily != graphicsQueueFamily) {
+			createPresentAcquireCommandBuffers();
+		}
+	}
+
+	void openFrameCapture() {
+		if (!settings.captureFile.empty()) {
+			captureWriter.open(settings.captureFile);
+			std::cout << "Capturing frames to " << settings.captureFile << '\n';
+		}
+		if (!settings.replayFile.empty()) {
+			replayReader.open(settings.replayFile);
+			replayStart = FramePacer::Clock::now();
+			std::cout << "Replaying frames from " << settings.replayFile << '\n';
+		}
+		if (readbackEnabled) {
+			frameRecorder.open(settings.recordPath, settings.recordFormat, logger);
+			frameReadback.create(device, capabilities.memoryProperties, memoryTracker, settings.framesInFlight + 1, frameRecorder);
+			std::cout << "Recording frames to " << settings.recordPath << '\n';
+		}
+	}
+
+	/*
+	* Prepares frameInputs for the next frame. Returns false once a replay has
+	* run out of frames.
+	*/
+	bool prepareFrameInputs() {
+		if (frameInputsReady) {
+			// The last prepared frame never reached the GPU, draw it again
+			return true;
+		}
+
+		if (replayReader.isOpen()) {
+			if (!replayReader.read(frameInputs)) {
+				return false;
+			}
+
+			/*
+			* Every draw has to fit what it reads: indexed scene draws the index
+			* buffer, non-indexed ones the vertex buffer. Particles have no index
+			* buffer and are bounded by the particle count.
+			*/
+			for (const auto& draw : frameInputs.draws) {
+				uint32_t available = 0;
+				if (draw.pipeline == DrawPipeline::Scene) {
+					available = static_cast<uint32_t>(draw.indexed ? indices.size() : vertices.size());
+				}
+				else if (draw.pipeline == DrawPipeline::Particles && !draw.indexed) {
+					available = particleCount;
+				}
+				// Levels of detail only exist for the indexed scene mesh
+				bool lodAllowed = draw.pipeline == DrawPipeline::Scene && draw.indexed;
+				if (available == 0 || draw.count > available || (draw.lod && !lodAllowed)) {
+					throw std::runtime_error("Frame capture does not match the scene of this build!");
+				}
+			}
+
+			// Resize events: the window follows the captured extent, which recreates the swap chain
+			if (frameInputs.width != swapChainExtent.width || frameInputs.height != swapChainExtent.height) {
+				glfwSetWindowSize(window, static_cast<int>(frameInputs.width), static_cast<int>(frameInputs.height));
+			}
+		}
+		else {
+			if (settings.fixedTimestepRate > 0) {
+				// Every frame advances the same amount, however long it took
+				frameInputs.deltaTime = 1.0f / settings.fixedTimestepRate;
+				frameInputs.time = preparedFrameCount * (1.0 / settings.fixedTimestepRate);
+			}
+			else {
+				auto now = FramePacer::Clock::now();
+				if (preparedFrameCount == 0) {
+					firstFrameTime = now;
+				}
+				double time = std::chrono::duration<double>(now - firstFrameTime).count();
+				// Clamped, so a stall (e.g. dragging the window) does not fling every particle away
+				frameInputs.deltaTime = std::min(static_cast<float>(time - frameInputs.time), 0.05f);
+				frameInputs.time = time;
+			}
+			// The UBO and extent are filled in by updateUniformBuffer once the swap chain image is known
+			frameInputs.draws = buildDrawList();
+		}
+
+		frameInputsReady = true;
+		preparedFrameCount++;
+		return true;
+	}
+
+	void updateUniformBuffer(uint32_t currentImage) {
+		if (replayReader.isOpen()) {
+			writeUniformBuffer(uniforms, currentImage, frameInputs.ubo);
+			sceneLodLevel = selectSceneLod(frameInputs.ubo, swapChainExtent, sceneLodLevel);
+			sceneDepth = getSceneDepth(frameInputs.ubo);
+			return;
+		}
+
+		float time = static_cast<float>(frameInputs.time);
+
+		scene.setRotation(modelObject, glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+		scene.update(&jobSystem);
+
+		// Only recomputed when the aspect ratio changed
+		setCameraExtent(camera, swapChainExtent);
+
+		UniformBufferObject& ubo = frameInputs.ubo;
+		ubo.model = scene.getWorldMatrix(modelObject);
+		ubo.view = camera.getView();
+		ubo.proj = camera.getProjection();
+
+		frameInputs.width = swapChainExtent.width;
+		frameInputs.height = swapChainExtent.height;
+
+		writeChangedUniforms(uniforms, currentImage, camera);
+		sceneLodLevel = selectSceneLod(ubo, swapChainExtent, sceneLodLevel);
+		sceneDepth = getSceneDepth(ubo);
+	}
+
+	/*
+	* The coarsest level of the scene mesh whose error stays below
+	* settings.lodThreshold pixels in a view, given the level the view drew
+	* last (for the hysteresis).
+	*/
+	uint32_t selectSceneLod(const UniformBufferObject& ubo, VkExtent2D extent, uint32_t currentLevel) const {
+		if (settings.lodThreshold <= 0.0f) {
+			return 0;
+		}
+
+		float pixelsPerUnit = getProjectedPixelsPerUnit(ubo.model, ubo.view, ubo.proj,
+			sceneLods.getCenter(), (float)extent.height);
+		return sceneLods.selectLevel(pixelsPerUnit, settings.lodThreshold, currentLevel);
+	}
+
+	// In [0, 1] between the camera and its far plane, as quantizeDrawDepth expects
+	float getSceneDepth(const UniformBufferObject& ubo) const {
+		glm::vec4 center = ubo.view * ubo.model * glm::vec4(sceneLods.getCenter(), 1.0f);
+		return -center.z / cameraFarPlane;
+	}
+
+	void setCameraExtent(SceneCamera& target, VkExtent2D extent) {
+		target.setPerspective(
+			glm::radians(45.0f),
+			extent.width / (float)extent.height,
+			cameraNearPlane,
+			cameraFarPlane
+		);
+	}
+
+	// Copies only what changed since this image's buffer was last written
+	void writeChangedUniforms(WindowUniforms& target, uint32_t imageIndex, SceneCamera& view) {
+		char* data = static_cast<char*>(target.mapped[imageIndex]);
+
+		std::vector<SceneRange>& changedRanges = changedSceneRanges[jobSystem.getWorkerIndex()];
+		changedRanges.clear();
+		scene.getChangedRanges(target.sceneVersions[imageIndex], changedRanges);
+		for (const auto& range : changedRanges) {
+			if (modelObject >= range.first && modelObject < range.first + range.count) {
+				memcpy(data + offsetof(UniformBufferObject, model), &scene.getWorldMatrix(modelObject), sizeof(glm::mat4));
+			}
+		}
+		target.sceneVersions[imageIndex] = scene.getVersion();
+
+		if (target.cameraVersions[imageIndex] != view.getVersion()) {
+			memcpy(data + offsetof(UniformBufferObject, view), &view.getView(), sizeof(glm::mat4));
+			memcpy(data + offsetof(UniformBufferObject, proj), &view.getProjection(), sizeof(glm::mat4));
+			target.cameraVersions[imageIndex] = view.getVersion();
+		}
+	}
+
+	void writeUniformBuffer(WindowUniforms& target, uint32_t imageIndex, const UniformBufferObject& ubo) {
+		memcpy(target.mapped[imageIndex], &ubo, sizeof(ubo));
+	}
+
+	// One job per window, each writes only its own buffers and camera
+	void updateSecondaryUniforms() {
+		jobSystem.parallelFor(static_cast<uint32_t>(secondaryWindows.size()), 1, [this](uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++) {
+				updateSecondaryUniforms(secondaryWindows[i]);
+			}
+		});
+	}
+
+	void updateSecondaryUniforms(SecondaryWindow& output) {
+		if (output.imageIndex == UINT32_MAX) {
+			return;
+		}
+
+		setCameraExtent(output.camera, output.extent);
+		UniformBufferObject ubo{};
+		if (replayReader.isOpen()) {
+			// Captures only hold the first window's matrices, the projection still follows this window
+			ubo = frameInputs.ubo;
+			ubo.proj = output.camera.getProjection();
+			writeUniformBuffer(output.uniforms, output.imageIndex, ubo);
+		}
+		else {
+			writeChangedUniforms(output.uniforms, output.imageIndex, output.camera);
+			ubo.model = scene.getWorldMatrix(modelObject);
+			ubo.view = output.camera.getView();
+			ubo.proj = output.camera.getProjection();
+		}
+		output.lodLevel = selectSceneLod(ubo, output.extent, output.lodLevel);
+		output.sceneDepth = getSceneDepth(ubo);
+	}
+
+	/*
+	* Sets up every window after the first one. Their swap chains use the first
+	* window's format, and their render graphs the same sample count, so their
+	* scene render passes are compatible with the shared pipelines.
+	*/
+	void createSecondaryWindows() {
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		for (auto& output : secondaryWindows) {
+			// findQueueFamilyIndices already picked a present family for all surfaces, this only guards against surprises
+			VkBool32 presentSupport = VK_FALSE;
+			vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, presentQueueFamily, output.surface, &presentSupport);
+			if (!presentSupport) {
+				throw std::runtime_error("The present queue can't present to every window!");
+			}
+
+			output.imageAvailableSemaphores.resize(settings.framesInFlight);
+			for (auto& semaphore : output.imageAvailableSemaphores) {
+				if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create synchronization objects for a frame!");
+				}
+			}
+
+			output.camera = camera;
+			createSecondarySwapChain(output);
+		}
+	}
+
+	/*
+	* (Re)creates the swap chain of a secondary window and everything sized
+	* after it. A minimized window is left without a swap chain and sits out
+	* every frame until it has pixels again.
+	*/
+	void createSecondarySwapChain(SecondaryWindow& output) {
+		retireSecondarySwapChainResources(output);
+		output.resized = false;
+
+		VkSwapchainKHR oldSwapChain = output.swapChain;
+		output.swapChain = VK_NULL_HANDLE;
+		if (oldSwapChain != VK_NULL_HANDLE) {
+			// Same grace period for the presentation engine as the first window's swap chain
+			deletionQueue.push(submittedFrameValue + settings.framesInFlight, [this, oldSwapChain]() {
+				vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+			});
+		}
+
+		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, output.surface);
+		VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities, output.framebufferSize);
+		if (output.framebufferSize.width == 0 || output.framebufferSize.height == 0 || extent.width == 0 || extent.height == 0) {
+			return;
+		}
+
+		auto surfaceFormat = std::find_if(swapChainSupport.formats.begin(), swapChainSupport.formats.end(),
+			[this](const VkSurfaceFormatKHR& format) { return format.format == swapChainImageFormat; });
+		if (surfaceFormat == swapChainSupport.formats.end()) {
+			throw std::runtime_error("Window surface does not support the swap chain format of the first window!");
+		}
+
+		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+		uint32_t maxImageCount = swapChainSupport.capabilities.maxImageCount;
+		if (maxImageCount > 0 &&
+			imageCount > maxImageCount) {
+			imageCount = maxImageCount;
+		}
+
+		VkSwapchainCreateInfoKHR createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+		createInfo.surface = output.surface;
+		createInfo.minImageCount = imageCount;
+		createInfo.imageFormat = surfaceFormat->format;
+		createInfo.imageColorSpace = surfaceFormat->colorSpace;
+		createInfo.imageExtent = extent;
+		createInfo.imageArrayLayers = 1;
+		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+		// Exclusive like the first window's, with the same release/acquire pair around a separate present family
+		createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
+		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+		createInfo.presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+		createInfo.clipped = VK_TRUE;
+		createInfo.oldSwapchain = oldSwapChain;
+
+		if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &output.swapChain) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create swap chain!");
+		}
+
+		vkGetSwapchainImagesKHR(device, output.swapChain, &imageCount, nullptr);
+		output.images.resize(imageCount);
+		vkGetSwapchainImagesKHR(device, output.swapChain, &imageCount, output.images.data());
+		output.extent = extent;
+		output.imageFrameValues.assign(imageCount, 0);
+
+		output.imageViews.resize(imageCount);
+		for (size_t i = 0; i < imageCount; i++) {
+			output.imageViews[i] = createSwapChainImageView(output.images[i], swapChainImageFormat);
+		}
+
+		createSecondaryRenderGraph(output);
+		createUniformBuffers(output.uniforms, imageCount);
+		createDescriptorPool(output.uniforms);
+		createDescriptorSets(output.uniforms);
+		if (presentQueueFamily != graphicsQueueFamily) {
+			output.presentAcquireCommandBuffers = createPresentAcquireCommandBuffers(output.images);
+		}
+	}
+
+	// Just the scene pass, straight into the swap chain image
+	void createSecondaryRenderGraph(SecondaryWindow& output) {
+		RenderGraph& graph = output.renderGraph;
+		RenderGraphResource backbuffer = graph.importSwapChain(
+			"backbuffer",
+			swapChainImageFormat,
+			output.extent,
+			output.images,
+			output.imageViews,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+		VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+		RenderGraphPass& scenePass = graph.addPass("scene", RenderGraphPassType::Graphics);
+		if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+			RenderGraphImageDesc msaaDesc{};
+			msaaDesc.format = swapChainImageFormat;
+			msaaDesc.extent = output.extent;
+			msaaDesc.samples = msaaSamples;
+			msaaDesc.additionalUsage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			RenderGraphResource msaaColor = graph.createTransientImage("scene_msaa", msaaDesc);
+
+			scenePass.addColorOutput(msaaColor, clearColor);
+			scenePass.addResolveOutput(backbuffer, msaaColor);
+		}
+		else {
+			scenePass.addColorOutput(backbuffer, clearColor);
+		}
+
+		// By index, the callback must not hold on to an element of secondaryWindows
+		size_t windowIndex = &output - secondaryWindows.data();
+		scenePass.setRecordCallback([this, windowIndex](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+			SecondaryWindow& target = secondaryWindows[windowIndex];
+			recordScenePass(commandBuffer, target.extent, target.uniforms.descriptorSets[imageIndex], target.lodLevel, target.sceneDepth);
+		});
+
+		graph.setOutput(backbuffer);
+		graph.compile(device, capabilities.memoryProperties, &memoryTracker);
+	}
+
+	// Hands the window's render graph, image views and uniforms to the deletion queue
+	void retireSecondarySwapChainResources(SecondaryWindow& output) {
+		if (output.imageViews.empty()) {
+			return;
+		}
+
+		auto retiredRenderGraph = std::make_shared<RenderGraph>(std::move(output.renderGraph));
+		output.renderGraph = RenderGraph();
+
+		deletionQueue.push(submittedFrameValue, [
+			this,
+			retiredRenderGraph,
+			oldPresentAcquireCommandBuffers = output.presentAcquireCommandBuffers,
+			oldImageViews = output.imageViews]() {
+			if (!oldPresentAcquireCommandBuffers.empty()) {
+				vkFreeCommandBuffers(device, presentCommandPool,
+					static_cast<uint32_t>(oldPresentAcquireCommandBuffers.size()), oldPresentAcquireCommandBuffers.data());
+			}
+
+			retiredRenderGraph->reset();
+			for (auto imageView : oldImageViews) {
+				vkDestroyImageView(device, imageView, nullptr);
+			}
+		});
+		output.imageViews.clear();
+		output.images.clear();
+		output.presentAcquireCommandBuffers.clear();
+
+		retireUniforms(output.uniforms);
+	}
+
+	/*
+	* Acquires the next image of every secondary window. Windows which are
+	* minimized or whose swap chain just went out of date sit this frame out
+	* instead of holding up the others.
+	*/
+	void acquireSecondaryImages(uint64_t frameValue) {
+		for (auto& output : secondaryWindows) {
+			output.imageIndex = UINT32_MAX;
+
+			if (output.swapChain == VK_NULL_HANDLE || output.resized) {
+				output.framebufferSize = getFramebufferSize(output.window);
+				createSecondarySwapChain(output);
+				if (output.swapChain == VK_NULL_HANDLE) {
+					continue;
+				}
+			}
+
+			uint32_t imageIndex;
+			VkResult result = vkAcquireNextImageKHR(device, output.swapChain, UINT64_MAX,
+				output.imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+			if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+				output.resized = true;
+				continue;
+			}
+			else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+				throw std::runtime_error("Failed to acquire swap chain image!");
+			}
+
+			waitForFrame(output.imageFrameValues[imageIndex]);
+			output.imageFrameValues[imageIndex] = frameValue;
+			output.imageIndex = imageIndex;
+		}
 	}
 
 	/*
@@ -1389,9 +3056,21 @@ private:
 	* Return the image to the swap chain for presentation
 	*/
 	void drawFrame() {
-		vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-		
-		
+		uint64_t frameValue = submittedFrameValue + 1;
+		jobSystem.beginFrame();
+		FrameAllocator& frameAllocator = jobSystem.getFrameAllocator();
+
+		// The semaphores of this frame slot are free once the frame which used them last has retired
+		if (frameValue > settings.framesInFlight) {
+			waitForFrame(frameValue - settings.framesInFlight);
+		}
+		if (timestampPool != VK_NULL_HANDLE) {
+			readFrameTimestamps(currentFrame);
+		}
+		if (readbackEnabled) {
+			frameReadback.harvest(completedFrameValue);
+		}
+
 		uint32_t imageIndex;
 		VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -1402,57 +3081,193 @@ private:
 			throw std::runtime_error("Failed to acquire swap chain image!");
 		}
 
-		// Check if a previous frame is using this image (i.e. there is its fence to wait on)
-		if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-			vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-		}
+		// Check if a previous frame is still using this image (and its uniform buffer)
+		waitForFrame(imageFrameValues[imageIndex]);
+		imageFrameValues[imageIndex] = frameValue;
 
-		imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+		// The scene update runs on a worker while the other windows wait for their images
+		JobCounter sceneUpdated;
+		jobSystem.run([this, imageIndex]() { updateUniformBuffer(imageIndex); }, &sceneUpdated);
+		acquireSecondaryImages(frameValue);
+		jobSystem.wait(sceneUpdated);
+		updateSecondaryUniforms();
 
-		updateUniformBuffer(imageIndex);
+		simulateParticles(frameValue);
+		recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
 
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore waitSemaphores[] = {
-			imageAvailableSemaphores[currentFrame]
+		// Image available, compute, every other window and the uploads
+		size_t maxWaitCount = 3 + secondaryWindows.size();
+		VkSemaphore* waitSemaphores = frameAllocator.allocateArray<VkSemaphore>(maxWaitCount);
+		VkPipelineStageFlags* waitStages = frameAllocator.allocateArray<VkPipelineStageFlags>(maxWaitCount);
+		// Values for binary semaphores are ignored
+		uint64_t* waitValues = frameAllocator.allocateArray<uint64_t>(maxWaitCount);
+		uint32_t waitCount = 0;
+		VkCommandBuffer submitCommandBuffers[2];
+		uint32_t submitCommandBufferCount = 0;
+
+		auto addWait = [&](VkSemaphore semaphore, VkPipelineStageFlags stage, uint64_t value) {
+			waitSemaphores[waitCount] = semaphore;
+			waitStages[waitCount] = stage;
+			waitValues[waitCount] = value;
+			waitCount++;
 		};
+		addWait(imageAvailableSemaphores[currentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0);
+		addWait(computeTimeline, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, frameValue);
 
-		VkPipelineStageFlags waitStages[] = {
-			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-		};
-		submitInfo.waitSemaphoreCount = 1;
+		for (const auto& output : secondaryWindows) {
+			if (output.imageIndex != UINT32_MAX) {
+				addWait(output.imageAvailableSemaphores[currentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0);
+			}
+		}
+
+		// Uploads since the last frame are waited for (and acquired) by this submission
+		if (submittedTransferValue > acquiredTransferValue) {
+			addWait(transferTimeline, pendingUploadStages, submittedTransferValue);
+
+			if (recordUploadAcquires()) {
+				submitCommandBuffers[submitCommandBufferCount++] = uploadAcquireCommandBuffers[currentFrame];
+			}
+			acquiredTransferValue = submittedTransferValue;
+			pendingUploadStages = 0;
+		}
+		submitCommandBuffers[submitCommandBufferCount++] = commandBuffers[currentFrame];
+
+		submitInfo.waitSemaphoreCount = waitCount;
 		submitInfo.pWaitSemaphores = waitSemaphores;
 		submitInfo.pWaitDstStageMask = waitStages;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+		submitInfo.commandBufferCount = submitCommandBufferCount;
+		submitInfo.pCommandBuffers = submitCommandBuffers;
 
 		VkSemaphore signalSemaphores[] = {
-			renderFinishedSemaphores[currentFrame]
+			renderFinishedSemaphores[currentFrame],
+			frameTimeline
 		};
-		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.signalSemaphoreCount = 2;
 		submitInfo.pSignalSemaphores = signalSemaphores;
-	
-		vkResetFences(device, 1, &inFlightFences[currentFrame]);
-		
-		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+
+		uint64_t signalValues[] = { 0, frameValue };
+
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.waitSemaphoreValueCount = waitCount;
+		timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+		timelineSubmitInfo.signalSemaphoreValueCount = 2;
+		timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+		submitInfo.pNext = &timelineSubmitInfo;
+
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to submit draw command buffer!");
 		}
+		submittedFrameValue = frameValue;
+		framePacer.onSubmitted(frameValue, FramePacer::Clock::now());
+
+		if (captureWriter.isOpen()) {
+			captureWriter.write(frameInputs);
+		}
+		frameInputsReady = false;
+
+		VkSemaphore presentWaitSemaphore = renderFinishedSemaphores[currentFrame];
+		if (presentQueueFamily != graphicsQueueFamily) {
+			VkPipelineStageFlags acquireStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+			VkSubmitInfo acquireSubmitInfo{};
+			acquireSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			acquireSubmitInfo.waitSemaphoreCount = 1;
+			acquireSubmitInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
+			acquireSubmitInfo.pWaitDstStageMask = &acquireStage;
+
+			// Every window presented this frame gets its image back on the present queue
+			VkCommandBuffer* acquireCommandBuffers = frameAllocator.allocateArray<VkCommandBuffer>(1 + secondaryWindows.size());
+			uint32_t acquireCount = 0;
+			acquireCommandBuffers[acquireCount++] = presentAcquireCommandBuffers[imageIndex];
+			for (const auto& output : secondaryWindows) {
+				if (output.imageIndex != UINT32_MAX) {
+					acquireCommandBuffers[acquireCount++] = output.presentAcquireCommandBuffers[output.imageIndex];
+				}
+			}
+			acquireSubmitInfo.commandBufferCount = acquireCount;
+			acquireSubmitInfo.pCommandBuffers = acquireCommandBuffers;
+			acquireSubmitInfo.signalSemaphoreCount = 1;
+			acquireSubmitInfo.pSignalSemaphores = &presentReadySemaphores[currentFrame];
+
+			if (vkQueueSubmit(presentQueue, 1, &acquireSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to submit present acquire command buffer!");
+			}
+			presentWaitSemaphore = presentReadySemaphores[currentFrame];
+		}
 		
 		VkPresentInfoKHR presentInfo{};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = signalSemaphores;
+		presentInfo.pWaitSemaphores = &presentWaitSemaphore;
 
-		VkSwapchainKHR swapChains[] = {
-			swapChain
-		};
-		presentInfo.swapchainCount = 1;
+		/*
+		* Every window which rendered this frame is presented by this one call.
+		* The semaphore above covers all of them, they were rendered by the same
+		* submission.
+		*/
+		size_t maxPresentCount = 1 + secondaryWindows.size();
+		VkSwapchainKHR* swapChains = frameAllocator.allocateArray<VkSwapchainKHR>(maxPresentCount);
+		uint32_t* imageIndices = frameAllocator.allocateArray<uint32_t>(maxPresentCount);
+		// Only the first window is tracked by present ids, 0 means none
+		uint64_t* presentIds = frameAllocator.allocateArray<uint64_t>(maxPresentCount);
+		VkResult* presentResults = frameAllocator.allocateArray<VkResult>(maxPresentCount);
+		uint32_t presentCount = 1;
+		swapChains[0] = swapChain;
+		imageIndices[0] = imageIndex;
+		presentIds[0] = frameValue;
+		for (const auto& output : secondaryWindows) {
+			if (output.imageIndex != UINT32_MAX) {
+				swapChains[presentCount] = output.swapChain;
+				imageIndices[presentCount] = output.imageIndex;
+				presentCount++;
+			}
+		}
+
+		presentInfo.swapchainCount = presentCount;
 		presentInfo.pSwapchains = swapChains;
-		presentInfo.pImageIndices = &imageIndex;
-		presentInfo.pResults = nullptr;
+		presentInfo.pImageIndices = imageIndices;
+		presentInfo.pResults = presentResults;
+
+		VkPresentIdKHR presentId{};
+		presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentId.swapchainCount = presentInfo.swapchainCount;
+		presentId.pPresentIds = presentIds;
+		if (presentWaitEnabled) {
+			presentInfo.pNext = &presentId;
+		}
 
 		result = vkQueuePresentKHR(presentQueue, &presentInfo);
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
+			throw std::runtime_error("Failed to present swap chain image!");
+		}
+
+		// The other windows recreate their swap chain before their next acquire
+		size_t presentIndex = 1;
+		for (auto& output : secondaryWindows) {
+			if (output.imageIndex == UINT32_MAX) {
+				continue;
+			}
+			VkResult windowResult = presentResults[presentIndex++];
+			if (windowResult == VK_ERROR_OUT_OF_DATE_KHR || windowResult == VK_SUBOPTIMAL_KHR) {
+				output.resized = true;
+			}
+			else if (windowResult != VK_SUCCESS) {
+				throw std::runtime_error("Failed to present swap chain image!");
+			}
+		}
+		result = presentResults[0];
+		if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+			lastPresentId = frameValue;
+		}
+
+		if (!startupTimer.isFirstFramePresented()) {
+			startupTimer.onFirstFramePresented(StartupTimer::Clock::now());
+			startupTimer.report(std::cout);
+		}
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR ||
 			result == VK_SUBOPTIMAL_KHR ||
@@ -1465,23 +3280,41 @@ private:
 			throw std::runtime_error("Failed to present swap chain image!");
 		}
 
-		// If we didn't use fences to control CPU-GPU timing, we could use a rudimentary approach by waiting for the hardware to idle:
+		// If we didn't use a timeline semaphore to control CPU-GPU timing, we could use a rudimentary approach by waiting for the hardware to idle:
 		//vkQueueWaitIdle(presentQueue);
 
-		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		currentFrame = (currentFrame + 1) % settings.framesInFlight;
 	}
 
+	/*
+	* Initialization is a dependency graph instead of a fixed sequence, so
+	* independent steps overlap: shader files are read while the instance and
+	* device are created, pipelines compile while buffers upload and descriptors
+	* are written. Steps that run concurrently must not share anything
+	* externally synchronized; both uploads use the transfer command pool and
+	* queue, so the index buffer waits for the vertex buffer.
+	*/
 	void initVulkan() {
-		createInstance();
+		TaskGraph graph;
+		auto step = [this, &graph](const char* name, TaskGraph::Work work, const std::vector<TaskGraph::TaskId>& dependencies) {
+			return graph.addTask(name, [this, name, work]() { startupTimer.measure(name, work); }, dependencies);
+		};
+
+		auto instanceStep = step("createInstance", [this]() { createInstance(); }, {});
+		auto shadersStep = step("loadShaderBinaries", [this]() { loadShaderBinaries(); }, {});
+		auto sceneStep = step("createScene", [this]() { createScene(); }, {});
+		auto sceneLodsStep = step("createSceneLods", [this]() { createSceneLods(); }, {});
 #ifndef NDEBUG
-		setupDebugMessenger();
+		step("setupDebugMessenger", [this]() { setupDebugMessenger(); }, { instanceStep });
 #endif
-		createSurface();
-		pickPhysicalDevice();
-		createLogicalDevice();
-		createSwapChain(); // Eventually need the ability to re-create swapchain (for window resize, etc.)
-		createImageViews();
-		createRenderPass();
+		auto surfaceStep = step("createSurface", [this]() { createSurface(); }, { instanceStep });
+		auto physicalDeviceStep = step("pickPhysicalDevice", [this]() { pickPhysicalDevice(); }, { surfaceStep });
+		auto logicalDeviceStep = step("createLogicalDevice", [this]() { createLogicalDevice(); }, { physicalDeviceStep });
+
+		auto swapChainStep = step("createSwapChain", [this]() { createSwapChain(); }, { logicalDeviceStep }); // Eventually need the ability to re-create swapchain (for window resize, etc.)
+		auto imageViewsStep = step("createImageViews", [this]() { createImageViews(); }, { swapChainStep });
+		auto renderGraphStep = step("createRenderGraph", [this]() { createRenderGraph(); }, { imageViewsStep });
+
 		/*
 		* In older APIs like OpenGL and Direct3D, the pipeline settings were mutable.
 		* Vulkan makes guarantees to the graphics driver that pipeline settings will
@@ -1490,61 +3323,217 @@ private:
 		* It is advisable to create a number of pipelines to represent the different
 		* states for rendering operations.
 		*/
-		createDescriptorSetLayout();
-		createGraphicsPipeline();
-		createFramebuffers();
-		createCommandPool();
-		createVertexBuffer();
-		createIndexBuffer();
-		createUniformBuffers();
-		createDescriptorPool();
-		createDescriptorSets();
-		createCommandBuffers();
-		createSyncObjects();
+		auto descriptorSetLayoutStep = step("createDescriptorSetLayout", [this]() { createDescriptorSetLayout(); }, { logicalDeviceStep, shadersStep });
+		step("createGraphicsPipeline", [this]() { createGraphicsPipeline(); }, { renderGraphStep, descriptorSetLayoutStep, shadersStep });
+		step("createParticlePipeline", [this]() { createParticlePipeline(); }, { renderGraphStep, shadersStep });
+
+		auto commandPoolStep = step("createCommandPool", [this]() { createCommandPool(); }, { logicalDeviceStep });
+		auto syncObjectsStep = step("createSyncObjects", [this]() { createSyncObjects(); }, { swapChainStep });
+		step("createTimestampQueryPool", [this]() { createTimestampQueryPool(); }, { logicalDeviceStep });
+		auto vertexBufferStep = step("createVertexBuffer", [this]() { createVertexBuffer(); }, { commandPoolStep, syncObjectsStep });
+		step("createIndexBuffer", [this]() { createIndexBuffer(); }, { vertexBufferStep, sceneLodsStep });
+
+		auto uniformBuffersStep = step("createUniformBuffers", [this]() { createUniformBuffers(uniforms, swapChainImages.size()); }, { swapChainStep });
+		auto descriptorPoolStep = step("createDescriptorPool", [this]() { createDescriptorPool(uniforms); }, { uniformBuffersStep });
+		step("createDescriptorSets", [this]() { createDescriptorSets(uniforms); }, { descriptorPoolStep, descriptorSetLayoutStep });
+
+		step("createCommandBuffers", [this]() { createCommandBuffers(); }, { commandPoolStep });
+		auto presentAcquireStep = step("createPresentAcquireCommandBuffers", [this]() {
+			if (presentQueueFamily != graphicsQueueFamily) {
+				createPresentAcquireCommandBuffers();
+			}
+		}, { commandPoolStep, swapChainStep });
+		// After the first window's acquire command buffers, both allocate from presentCommandPool
+		step("createSecondaryWindows", [this]() { createSecondaryWindows(); }, { renderGraphStep, descriptorSetLayoutStep, sceneStep, presentAcquireStep });
+		step("createParticleSimulation", [this]() { createParticleSimulation(); }, { commandPoolStep, shadersStep });
+
+		uint32_t threadCount = settings.initThreads;
+		if (threadCount == 0) {
+			threadCount = std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+		}
+		// Still on the main thread here, the steps only get to see the result
+		framebufferSize = getFramebufferSize(window);
+		for (auto& output : secondaryWindows) {
+			output.framebufferSize = getFramebufferSize(output.window);
+		}
+		graph.execute(threadCount);
 	}
 	
+	/*
+	* Blocks in the window system until the next frame is due: not at all when
+	* drawing continuously, until the refresh timer or an event when idle, and
+	* until an event while suspended. Events land in the callbacks, which
+	* invalidate the frame.
+	*/
+	void waitForEvents() {
+		FrameScheduler::Clock::duration timeout = frameScheduler.getIdleTimeout(FrameScheduler::Clock::now());
+		if (timeout == FrameScheduler::Clock::duration::zero()) {
+			return;
+		}
+
+		if (timeout == FrameScheduler::Clock::duration::max()) {
+			glfwWaitEvents();
+		}
+		else {
+			glfwWaitEventsTimeout(std::chrono::duration<double>(timeout).count());
+		}
+	}
+
+	// Returns true once the first window is restored and has a swap chain again
+	bool resumeFromSuspension() {
+		int width = 0;
+		int height = 0;
+		glfwGetFramebufferSize(window, &width, &height);
+		if (width == 0 || height == 0 || glfwGetWindowAttrib(window, GLFW_ICONIFIED)) {
+			return false;
+		}
+
+		frameScheduler.setSuspended(false);
+		recreateSwapChain();
+		return !frameScheduler.isSuspended();
+	}
+
 	void mainLoop() {
-		while (!glfwWindowShouldClose(window)) {
+		while (!anyWindowShouldClose()) {
+			waitForEvents();
+			if (frameScheduler.isSuspended() && !resumeFromSuspension()) {
+				continue;
+			}
+			if (scene.hasPendingChanges()) {
+				frameScheduler.invalidate();
+			}
+			if (!frameScheduler.isFrameDue(FrameScheduler::Clock::now())) {
+				continue;
+			}
+
+			frameScheduler.waitForFrameSlot();
+			waitForFrameStart();
 			glfwPollEvents();
+			framePacer.onInputSampled(FramePacer::Clock::now());
+			if (!prepareFrameInputs()) {
+				break;
+			}
 			drawFrame();
+			frameScheduler.onFrameDrawn(FrameScheduler::Clock::now());
+			memoryTracker.updateBudget();
+			framePacer.report(std::cout, FramePacer::Clock::now());
+			logger.report(std::cout, Logger::Clock::now());
+			memoryTracker.report(std::cout, DeviceMemoryTracker::Clock::now());
+			if (dynamicResolutionEnabled) {
+				resolutionController.report(std::cout, DynamicResolutionController::Clock::now());
+			}
+			if (frameScheduler.isOnDemand() || settings.maxFrameRate > 0) {
+				frameScheduler.report(std::cout, FrameScheduler::Clock::now());
+			}
+			drawState.report(std::cout, DrawStateTracker::Clock::now());
+			if (settings.verbose) {
+				jobSystem.report(std::cout, JobSystem::Clock::now());
+			}
 		}
 
 		vkDeviceWaitIdle(device);
+
+		if (replayReader.isOpen()) {
+			double elapsed = std::chrono::duration<double>(FramePacer::Clock::now() - replayStart).count();
+			uint64_t frames = replayReader.getFrameCount();
+			std::cout << "Replayed " << frames << " frames in " << elapsed << " s";
+			if (frames > 0) {
+				std::cout << " (" << elapsed * 1000.0 / frames << " ms per frame)";
+			}
+			std::cout << '\n';
+		}
+		if (captureWriter.isOpen()) {
+			std::cout << "Captured " << captureWriter.getFrameCount() << " frames\n";
+			captureWriter.close();
+		}
+		if (frameRecorder.isOpen()) {
+			// Everything submitted is done, pick up the last copies before the writer finishes
+			frameReadback.harvest(submittedFrameValue);
+			frameRecorder.close();
+			std::cout << "Recorded " << frameRecorder.getWrittenFrameCount() << " frames";
+			if (frameRecorder.getDroppedFrameCount() > 0) {
+				std::cout << ", dropped " << frameRecorder.getDroppedFrameCount() << " because the writer fell behind";
+			}
+			if (frameRecorder.hasFailed()) {
+				std::cout << ", stopped early by a write error";
+			}
+			std::cout << '\n';
+			frameReadback.destroy();
+		}
 	}
 
 	void cleanup() {
+		// The device is idle at this point, so everything can go right away
 		cleanupSwapChain();
-
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		for (auto& output : secondaryWindows) {
+			retireSecondarySwapChainResources(output);
+		}
+		deletionQueue.flushAll();
+		vkDestroySwapchainKHR(device, swapChain, nullptr);
+		for (auto& output : secondaryWindows) {
+			if (output.swapChain != VK_NULL_HANDLE) {
+				vkDestroySwapchainKHR(device, output.swapChain, nullptr);
+			}
+			for (auto semaphore : output.imageAvailableSemaphores) {
+				vkDestroySemaphore(device, semaphore, nullptr);
+			}
+		}
 
 		vkDestroyBuffer(device, indexBuffer, nullptr);
-		vkFreeMemory(device, indexBufferMemory, nullptr);
+		memoryTracker.free(indexBufferMemory);
 
 		vkDestroyBuffer(device, vertexBuffer, nullptr);
-		vkFreeMemory(device, vertexBufferMemory, nullptr);
+		memoryTracker.free(vertexBufferMemory);
+
+		particleSimulation.destroy();
+		pipelineCache.destroy();
+		pipelineLayouts.destroy();
+		vkDestroyDescriptorPool(device, particleDescriptorPool, nullptr);
+		for (size_t i = 0; i < particleBuffers.size(); i++) {
+			vkDestroyBuffer(device, particleBuffers[i], nullptr);
+			memoryTracker.free(particleBuffersMemory[i]);
+		}
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		for (size_t i = 0; i < settings.framesInFlight; i++) {
 			vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
 			vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(device, inFlightFences[i], nullptr);
+		}
+		for (auto semaphore : presentReadySemaphores) {
+			vkDestroySemaphore(device, semaphore, nullptr);
+		}
+		vkDestroySemaphore(device, frameTimeline, nullptr);
+		vkDestroySemaphore(device, transferTimeline, nullptr);
+		vkDestroySemaphore(device, computeTimeline, nullptr);
+
+		if (timestampPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, timestampPool, nullptr);
 		}
 
 		vkDestroyCommandPool(device, commandPool, nullptr);
+		vkDestroyCommandPool(device, transferCommandPool, nullptr);
+		vkDestroyCommandPool(device, computeCommandPool, nullptr);
+		if (presentCommandPool != VK_NULL_HANDLE) {
+			vkDestroyCommandPool(device, presentCommandPool, nullptr);
+		}
 		
 		vkDestroyDevice(device, nullptr);
 		vkDestroySurfaceKHR(instance, surface, nullptr);
+		for (auto& output : secondaryWindows) {
+			vkDestroySurfaceKHR(instance, output.surface, nullptr);
+		}
 #ifndef NDEBUG
 		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 #endif
 		vkDestroyInstance(instance, nullptr);
+		for (auto& output : secondaryWindows) {
+			glfwDestroyWindow(output.window);
+		}
 		glfwDestroyWindow(window);
 		glfwTerminate();
 	}
 };
 
 int main(int argc, char** argv) {
-	HelloTriangleApplication app;
-	
 	std::cout 
 		<< "LearnVulkan Version "
 		<< LEARN_VULKAN_VERSION_MAJOR
@@ -1555,6 +3544,7 @@ int main(int argc, char** argv) {
 		<< "\n";
 
 	try {
+		HelloTriangleApplication app(parseCommandLine(argc, argv));
 		app.run();
 	}
 	catch (const std::exception& e) {
@@ -0,0 +1,313 @@
+#include "tfwi_vulkan_job_system.hpp"
+
+#include <stdexcept>
+
+// Which worker of which system the calling thread is
+static thread_local const JobSystem* currentJobSystem = nullptr;
+static thread_local uint32_t currentWorkerIndex = 0;
+
+void* FrameAllocator::allocate(size_t size, size_t alignment) {
+	while (currentBlock < blocks.size()) {
+		Block& block = blocks[currentBlock];
+		uintptr_t base = reinterpret_cast<uintptr_t>(block.memory.get());
+		size_t aligned = ((base + offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1)) - base;
+		if (aligned + size <= block.size) {
+			offset = aligned + size;
+			return block.memory.get() + aligned;
+		}
+
+		currentBlock++;
+		offset = 0;
+	}
+
+	Block block{};
+	block.size = std::max(blockSize, size + alignment);
+	block.memory.reset(new uint8_t[block.size]);
+	blocks.push_back(std::move(block));
+	currentBlock = blocks.size() - 1;
+	offset = 0;
+	return allocate(size, alignment);
+}
+
+void FrameAllocator::reset() {
+	currentBlock = 0;
+	offset = 0;
+}
+
+size_t FrameAllocator::getCapacity() const {
+	size_t capacity = 0;
+	for (const auto& block : blocks) {
+		capacity += block.size;
+	}
+	return capacity;
+}
+
+JobSystem::~JobSystem() {
+	stop();
+}
+
+void JobSystem::start(uint32_t threadCount) {
+	if (!workers.empty()) {
+		throw std::runtime_error("Job system already started!");
+	}
+
+	if (threadCount == 0) {
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	stopping = false;
+	for (uint32_t i = 0; i < threadCount; i++) {
+		workers.push_back(std::make_unique<Worker>());
+	}
+
+	currentJobSystem = this;
+	currentWorkerIndex = 0;
+	for (uint32_t i = 1; i < threadCount; i++) {
+		workers[i]->thread = std::thread([this, i]() { workerLoop(i); });
+	}
+}
+
+void JobSystem::stop() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers) {
+		if (worker->thread.joinable()) {
+			worker->thread.join();
+		}
+	}
+	workers.clear();
+
+	if (currentJobSystem == this) {
+		currentJobSystem = nullptr;
+	}
+}
+
+uint32_t JobSystem::getWorkerIndex() const {
+	return currentJobSystem == this ? currentWorkerIndex : 0;
+}
+
+void JobSystem::run(Work work, JobCounter* counter, JobCounter* dependency) {
+	Job job{};
+	job.work = std::move(work);
+	job.counter = counter;
+	if (counter != nullptr) {
+		counter->pending++;
+	}
+
+	// Not started, e.g. while shutting down: nobody else could run it
+	if (workers.empty()) {
+		if (dependency != nullptr && !dependency->isDone()) {
+			throw std::runtime_error("Job depends on unfinished jobs, but the job system is not running!");
+		}
+		std::exception_ptr error = dependency != nullptr ? dependency->error : nullptr;
+		if (!error) {
+			try {
+				job.work();
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+		}
+		finish(job, error);
+		return;
+	}
+
+	if (dependency != nullptr) {
+		std::unique_lock<std::mutex> lock(dependency->mutex);
+		if (dependency->pending != 0) {
+			dependency->waiting.push_back(std::move(job));
+			return;
+		}
+		if (dependency->error) {
+			std::exception_ptr error = dependency->error;
+			lock.unlock();
+			finish(job, error);
+			return;
+		}
+	}
+
+	push(std::move(job));
+}
+
+void JobSystem::wait(JobCounter& counter) {
+	uint32_t workerIndex = getWorkerIndex();
+	while (!counter.isDone()) {
+		if (!tryRunJob(workerIndex)) {
+			// The last jobs are running elsewhere
+			std::this_thread::yield();
+		}
+	}
+
+	// The worker which finished the last job may still hold the lock, the counter must outlive it
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(counter.mutex);
+		error = counter.error;
+		counter.error = nullptr;
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+FrameAllocator& JobSystem::getFrameAllocator() {
+	if (workers.empty()) {
+		throw std::runtime_error("Job system not started!");
+	}
+	return workers[getWorkerIndex()]->frameAllocator;
+}
+
+void JobSystem::beginFrame() {
+	for (auto& worker : workers) {
+		worker->frameAllocator.reset();
+	}
+}
+
+void JobSystem::report(std::ostream& out, Clock::time_point now) {
+	if (lastReport == Clock::time_point{}) {
+		lastReport = now;
+		return;
+	}
+
+	if (now - lastReport < reportPeriod) {
+		return;
+	}
+
+	uint64_t jobs = 0;
+	uint64_t steals = 0;
+	for (const auto& worker : workers) {
+		jobs += worker->executedJobs.load(std::memory_order_relaxed);
+		steals += worker->stolenJobs.load(std::memory_order_relaxed);
+	}
+
+	double elapsed = std::chrono::duration<double>(now - lastReport).count();
+	out << "Jobs: " << (jobs - reportedJobs) << " on " << workers.size() << " threads in " << elapsed << " s, "
+		<< (steals - reportedSteals) << " stolen\n";
+
+	reportedJobs = jobs;
+	reportedSteals = steals;
+	lastReport = now;
+}
+
+void JobSystem::push(Job&& job) {
+	Worker& worker = *workers[getWorkerIndex()];
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.jobs.push_back(std::move(job));
+	}
+	queuedJobs++;
+
+	/*
+	* A worker going to sleep first counts itself, then checks queuedJobs. So
+	* either it sees this job, or this sees it sleeping and wakes it up.
+	*/
+	if (sleepingWorkers.load() > 0) {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wake.notify_one();
+	}
+}
+
+bool JobSystem::tryRunJob(uint32_t workerIndex) {
+	Job job{};
+	bool found = false;
+	bool stolen = false;
+
+	// Newest first from the own deque, its data is most likely still in the cache
+	{
+		Worker& own = *workers[workerIndex];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty()) {
+			job = std::move(own.jobs.back());
+			own.jobs.pop_back();
+			found = true;
+		}
+	}
+
+	// Oldest first from the others, usually the biggest piece of remaining work
+	for (size_t i = 1; i < workers.size() && !found; i++) {
+		Worker& victim = *workers[(workerIndex + i) % workers.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty()) {
+			job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			found = true;
+			stolen = true;
+		}
+	}
+
+	if (!found) {
+		return false;
+	}
+	queuedJobs--;
+
+	std::exception_ptr error;
+	try {
+		job.work();
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	finish(job, error);
+
+	Worker& self = *workers[workerIndex];
+	self.executedJobs.fetch_add(1, std::memory_order_relaxed);
+	if (stolen) {
+		self.stolenJobs.fetch_add(1, std::memory_order_relaxed);
+	}
+	return true;
+}
+
+void JobSystem::finish(Job& job, std::exception_ptr error) {
+	JobCounter* counter = job.counter;
+	if (counter == nullptr) {
+		return;
+	}
+
+	std::vector<Job> released;
+	std::exception_ptr counterError;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (error && !counter->error) {
+			counter->error = error;
+		}
+		if (--counter->pending == 0) {
+			released.swap(counter->waiting);
+			counterError = counter->error;
+		}
+	}
+
+	// Once the lock is released the counter may be gone, only "released" is touched from here on
+	for (auto& dependent : released) {
+		if (counterError) {
+			finish(dependent, counterError);
+		}
+		else {
+			push(std::move(dependent));
+		}
+	}
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex) {
+	currentJobSystem = this;
+	currentWorkerIndex = workerIndex;
+
+	for (;;) {
+		if (tryRunJob(workerIndex)) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers++;
+		wake.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+		sleepingWorkers--;
+		if (stopping) {
+			return;
+		}
+	}
+}
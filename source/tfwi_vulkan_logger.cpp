@@ -0,0 +1,218 @@
+#include "tfwi_vulkan_logger.hpp"
+
+#include <cstring>
+#include <iomanip>
+
+namespace {
+	const size_t ringCapacity = 1024;
+
+	// FNV-1a, groups messages without an id by their text
+	uint64_t hashText(const char* text) {
+		uint64_t hash = 14695981039346656037ull;
+		for (; *text != '\0'; text++) {
+			hash ^= static_cast<unsigned char>(*text);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+Logger::Logger(std::ostream& out)
+	: out(out), ring(ringCapacity) {
+	writer = std::thread([this]() { writerLoop(); });
+}
+
+Logger::~Logger() {
+	running.store(false, std::memory_order_release);
+	writer.join();
+}
+
+void Logger::muteMessageId(int32_t messageId) {
+	std::lock_guard<std::mutex> lock(muteMutex);
+
+	size_t count = mutedIdCount.load(std::memory_order_relaxed);
+	if (count == maxMutedIds) {
+		throw std::runtime_error("Too many muted message ids!");
+	}
+
+	// Publish the id before the count, readers never look past the count
+	mutedIds[count].store(messageId, std::memory_order_relaxed);
+	mutedIdCount.store(count + 1, std::memory_order_release);
+}
+
+bool Logger::isMuted(int32_t messageId) const {
+	size_t count = mutedIdCount.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; i++) {
+		if (mutedIds[i].load(std::memory_order_relaxed) == messageId) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void Logger::log(LogSeverity severity, LogCategory category, int32_t messageId, const char* text) {
+	// Counted before filtering, so they show up even when nobody reads them
+	if (category == LogCategory::Performance) {
+		performanceWarnings.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (static_cast<int>(severity) < minimumSeverity.load(std::memory_order_relaxed) ||
+		(messageId != 0 && isMuted(messageId))) {
+		filtered.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	Message message;
+	message.severity = severity;
+	message.category = category;
+	message.messageId = messageId;
+	// Longer messages are truncated, the ring holds fixed size slots
+	strncpy(message.text, text, maxMessageLength - 1);
+	message.text[maxMessageLength - 1] = '\0';
+
+	if (!ring.tryPush(message)) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+LogStats Logger::getStats() const {
+	LogStats stats;
+	stats.written = written.load(std::memory_order_relaxed);
+	stats.filtered = filtered.load(std::memory_order_relaxed);
+	stats.suppressed = suppressed.load(std::memory_order_relaxed);
+	stats.dropped = dropped.load(std::memory_order_relaxed);
+	stats.performanceWarnings = performanceWarnings.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void Logger::report(std::ostream& reportOut, Clock::time_point now) {
+	if (lastReport == Clock::time_point{}) {
+		lastReport = now;
+		return;
+	}
+
+	if (now - lastReport < reportPeriod) {
+		return;
+	}
+	lastReport = now;
+
+	LogStats stats = getStats();
+	if (stats.performanceWarnings == lastReportedStats.performanceWarnings &&
+		stats.suppressed == lastReportedStats.suppressed &&
+		stats.dropped == lastReportedStats.dropped) {
+		return;
+	}
+
+	reportOut << "Log: " << stats.performanceWarnings - lastReportedStats.performanceWarnings << " performance warnings"
+		<< " (" << stats.performanceWarnings << " total)"
+		<< ", " << stats.written << " written"
+		<< ", " << stats.filtered << " filtered"
+		<< ", " << stats.suppressed << " rate limited"
+		<< ", " << stats.dropped << " dropped\n";
+
+	lastReportedStats = stats;
+}
+
+void Logger::writerLoop() {
+	Message message;
+	for (;;) {
+		// Read the flag first, so everything pushed before shutdown still gets written
+		bool stopping = !running.load(std::memory_order_acquire);
+
+		bool wroteAny = false;
+		while (ring.tryPop(message)) {
+			write(message, Clock::now());
+			wroteAny = true;
+		}
+
+		if (stopping) {
+			break;
+		}
+
+		flushRateWindows(Clock::now(), false);
+		if (wroteAny) {
+			out.flush();
+		}
+		else {
+			std::this_thread::sleep_for(idleSleep);
+		}
+	}
+
+	flushRateWindows(Clock::now(), true);
+	out.flush();
+}
+
+void Logger::write(const Message& message, Clock::time_point now) {
+	uint32_t limit = rateLimit.load(std::memory_order_relaxed);
+	if (limit > 0) {
+		uint64_t key = message.messageId != 0 ? static_cast<uint32_t>(message.messageId) : hashText(message.text);
+		RateWindow& window = rateWindows[key];
+		if (window.start == Clock::time_point{}) {
+			window.start = now;
+			window.messageId = message.messageId;
+		}
+
+		if (window.written >= limit) {
+			window.suppressed++;
+			suppressed.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		window.written++;
+	}
+
+	out << '[' << getLogCategoryName(message.category) << "][" << getLogSeverityName(message.severity) << "] ";
+	if (message.messageId != 0) {
+		out << "(0x" << std::hex << std::setw(8) << std::setfill('0') << static_cast<uint32_t>(message.messageId)
+			<< std::dec << std::setfill(' ') << ") ";
+	}
+	out << message.text << '\n';
+	written.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::flushRateWindows(Clock::time_point now, bool all) {
+	for (auto window = rateWindows.begin(); window != rateWindows.end();) {
+		if (!all && now - window->second.start < rateWindowLength) {
+			++window;
+			continue;
+		}
+
+		if (window->second.suppressed > 0) {
+			out << "[Log] " << window->second.suppressed << " more ";
+			if (window->second.messageId != 0) {
+				out << "of message 0x" << std::hex << std::setw(8) << std::setfill('0') << static_cast<uint32_t>(window->second.messageId)
+					<< std::dec << std::setfill(' ');
+			}
+			else {
+				out << "identical messages";
+			}
+			out << " suppressed\n";
+		}
+		window = rateWindows.erase(window);
+	}
+}
+
+const char* getLogSeverityName(LogSeverity severity) {
+	switch (severity) {
+	case LogSeverity::Verbose:
+		return "Verbose";
+	case LogSeverity::Info:
+		return "Info";
+	case LogSeverity::Warning:
+		return "Warning";
+	default:
+		return "Error";
+	}
+}
+
+const char* getLogCategoryName(LogCategory category) {
+	switch (category) {
+	case LogCategory::Validation:
+		return "Validation";
+	case LogCategory::Performance:
+		return "Performance";
+	case LogCategory::Renderer:
+		return "Renderer";
+	default:
+		return "General";
+	}
+}
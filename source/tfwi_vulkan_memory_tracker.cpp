@@ -0,0 +1,283 @@
+#include "tfwi_vulkan_memory_tracker.hpp"
+
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+	double toMiB(VkDeviceSize size) {
+		return static_cast<double>(size) / (1024.0 * 1024.0);
+	}
+}
+
+const char* getMemoryUsageName(MemoryUsage usage) {
+	switch (usage) {
+	case MemoryUsage::Vertex:
+		return "vertex";
+	case MemoryUsage::Index:
+		return "index";
+	case MemoryUsage::Uniform:
+		return "uniform";
+	case MemoryUsage::Staging:
+		return "staging";
+	case MemoryUsage::Readback:
+		return "readback";
+	case MemoryUsage::Storage:
+		return "storage";
+	case MemoryUsage::RenderTarget:
+		return "render target";
+	default:
+		return "other";
+	}
+}
+
+void DeviceMemoryTracker::init(VkPhysicalDevice physicalDevice, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+	bool budgetExtensionEnabled) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	this->memoryProperties = memoryProperties;
+	this->budgetExtensionEnabled = budgetExtensionEnabled;
+
+	heaps.assign(memoryProperties.memoryHeapCount, HeapState{});
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		heaps[i].budget.size = memoryProperties.memoryHeaps[i].size;
+		heaps[i].budget.flags = memoryProperties.memoryHeaps[i].flags;
+	}
+	memoryTypeUsage.assign(memoryProperties.memoryTypeCount, 0);
+
+	queryBudget();
+}
+
+VkResult DeviceMemoryTracker::allocate(const VkMemoryAllocateInfo& allocInfo, MemoryUsage usage, VkDeviceMemory* memory) {
+	if (allocInfo.memoryTypeIndex >= memoryProperties.memoryTypeCount) {
+		throw std::runtime_error("Memory type index is out of range!");
+	}
+	uint32_t heapIndex = memoryProperties.memoryTypes[allocInfo.memoryTypeIndex].heapIndex;
+
+	VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, memory);
+
+	/*
+	* Out of memory is not necessarily the end: give everyone who holds memory
+	* they can do without a chance to free it, then try once more.
+	*/
+	if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+		notifyPressure({ heapIndex });
+		result = vkAllocateMemory(device, &allocInfo, nullptr, memory);
+	}
+
+	if (result != VK_SUCCESS) {
+		return result;
+	}
+
+	std::vector<uint32_t> pressured;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		Allocation allocation{};
+		allocation.size = allocInfo.allocationSize;
+		allocation.memoryTypeIndex = allocInfo.memoryTypeIndex;
+		allocation.usage = usage;
+		allocations[*memory] = allocation;
+
+		HeapState& heap = heaps[heapIndex];
+		heap.budget.tracked += allocation.size;
+		heap.budget.allocationCount++;
+		memoryTypeUsage[allocation.memoryTypeIndex] += allocation.size;
+		usageTotals[static_cast<size_t>(usage)] += allocation.size;
+
+		refreshUsage(heap);
+		if (checkPressure(heap)) {
+			pressured.push_back(heapIndex);
+		}
+	}
+
+	if (!pressured.empty()) {
+		notifyPressure(pressured);
+	}
+	return VK_SUCCESS;
+}
+
+void DeviceMemoryTracker::free(VkDeviceMemory memory) {
+	if (memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = allocations.find(memory);
+		if (it == allocations.end()) {
+			throw std::runtime_error("Freeing device memory which was not allocated through the tracker!");
+		}
+
+		const Allocation& allocation = it->second;
+		HeapState& heap = heaps[memoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex];
+		heap.budget.tracked -= allocation.size;
+		heap.budget.allocationCount--;
+		memoryTypeUsage[allocation.memoryTypeIndex] -= allocation.size;
+		usageTotals[static_cast<size_t>(allocation.usage)] -= allocation.size;
+		refreshUsage(heap);
+		checkPressure(heap);
+
+		allocations.erase(it);
+	}
+
+	vkFreeMemory(device, memory, nullptr);
+}
+
+void DeviceMemoryTracker::updateBudget() {
+	std::vector<uint32_t> pressured;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		queryBudget();
+		for (uint32_t i = 0; i < heaps.size(); i++) {
+			if (checkPressure(heaps[i])) {
+				pressured.push_back(i);
+			}
+		}
+	}
+
+	if (!pressured.empty()) {
+		notifyPressure(pressured);
+	}
+}
+
+void DeviceMemoryTracker::addPressureCallback(PressureCallback callback) {
+	std::lock_guard<std::mutex> lock(mutex);
+	pressureCallbacks.push_back(std::move(callback));
+}
+
+MemoryHeapBudget DeviceMemoryTracker::getHeapBudget(uint32_t heapIndex) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return heaps.at(heapIndex).budget;
+}
+
+VkDeviceSize DeviceMemoryTracker::getMemoryTypeUsage(uint32_t memoryTypeIndex) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return memoryTypeUsage.at(memoryTypeIndex);
+}
+
+VkDeviceSize DeviceMemoryTracker::getUsageTotal(MemoryUsage usage) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return usageTotals[static_cast<size_t>(usage)];
+}
+
+void DeviceMemoryTracker::report(std::ostream& out, Clock::time_point now) {
+	if (lastReport == Clock::time_point{}) {
+		lastReport = now;
+		return;
+	}
+
+	if (now - lastReport < reportPeriod) {
+		return;
+	}
+	lastReport = now;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(1);
+
+	out << "Device memory" << (budgetExtensionEnabled ? "" : " (estimated budget)") << ':';
+	const char* separator = " ";
+	for (uint32_t i = 0; i < heaps.size(); i++) {
+		const MemoryHeapBudget& heap = heaps[i].budget;
+		if (heap.tracked == 0 && heap.usage == 0) {
+			continue;
+		}
+		out << separator << "heap " << i << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local) " : " ")
+			<< toMiB(heap.usage) << '/' << toMiB(heap.budget) << " MiB";
+		if (heap.budget > 0) {
+			out << " (" << 100.0 * heap.usage / heap.budget << "%)";
+		}
+		separator = ", ";
+	}
+	for (size_t usage = 0; usage < static_cast<size_t>(MemoryUsage::Count); usage++) {
+		if (usageTotals[usage] > 0) {
+			out << separator << getMemoryUsageName(static_cast<MemoryUsage>(usage)) << ' ' << toMiB(usageTotals[usage]) << " MiB";
+			separator = ", ";
+		}
+	}
+	out << separator << allocations.size() << " allocations\n";
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void DeviceMemoryTracker::queryBudget() {
+	if (budgetExtensionEnabled) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+
+		for (uint32_t i = 0; i < heaps.size(); i++) {
+			heaps[i].budget.budget = budgetProperties.heapBudget[i];
+			heaps[i].reportedUsage = budgetProperties.heapUsage[i];
+			heaps[i].trackedAtQuery = heaps[i].budget.tracked;
+			refreshUsage(heaps[i]);
+		}
+	}
+	else {
+		for (auto& heap : heaps) {
+			heap.budget.budget = static_cast<VkDeviceSize>(heap.budget.size * estimatedBudgetShare);
+			refreshUsage(heap);
+		}
+	}
+}
+
+void DeviceMemoryTracker::refreshUsage(HeapState& heap) const {
+	if (!budgetExtensionEnabled) {
+		heap.budget.usage = heap.budget.tracked;
+		return;
+	}
+
+	// The driver only learns about our allocations at the next query, add what happened since
+	if (heap.budget.tracked >= heap.trackedAtQuery) {
+		heap.budget.usage = heap.reportedUsage + (heap.budget.tracked - heap.trackedAtQuery);
+	}
+	else {
+		VkDeviceSize freed = heap.trackedAtQuery - heap.budget.tracked;
+		heap.budget.usage = heap.reportedUsage > freed ? heap.reportedUsage - freed : 0;
+	}
+}
+
+bool DeviceMemoryTracker::checkPressure(HeapState& heap) {
+	if (heap.budget.budget == 0) {
+		return false;
+	}
+
+	double fraction = static_cast<double>(heap.budget.usage) / heap.budget.budget;
+	if (!heap.underPressure && fraction >= pressureThreshold) {
+		heap.underPressure = true;
+		return true;
+	}
+	if (heap.underPressure && fraction < pressureThreshold - pressureHysteresis) {
+		heap.underPressure = false;
+	}
+	return false;
+}
+
+void DeviceMemoryTracker::notifyPressure(const std::vector<uint32_t>& heapIndices) {
+	std::vector<PressureCallback> callbacks;
+	std::vector<MemoryHeapBudget> budgets;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		callbacks = pressureCallbacks;
+		for (uint32_t heapIndex : heapIndices) {
+			budgets.push_back(heaps[heapIndex].budget);
+		}
+	}
+
+	for (size_t i = 0; i < heapIndices.size(); i++) {
+		for (const auto& callback : callbacks) {
+			callback(heapIndices[i], budgets[i]);
+		}
+	}
+}
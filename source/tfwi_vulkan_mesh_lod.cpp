@@ -0,0 +1,379 @@
+#include "tfwi_vulkan_mesh_lod.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+	// Border planes count this much more than triangle planes of the same size
+	const double borderWeight = 10.0;
+
+	/*
+	* Weighted squared distances to a set of planes, summed up as
+	* p^T A p + 2 b^T p + c. A is symmetric, only its upper half is stored.
+	*/
+	typedef struct Quadric {
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+		double c = 0.0;
+		// Sum of the plane weights
+		double weight = 0.0;
+	} Quadric;
+
+	// The plane dot(normal, p) + distance = 0, normal has unit length
+	Quadric makePlaneQuadric(const glm::vec3& normal, float distance, double weight) {
+		Quadric q{};
+		q.a00 = weight * normal.x * normal.x;
+		q.a01 = weight * normal.x * normal.y;
+		q.a02 = weight * normal.x * normal.z;
+		q.a11 = weight * normal.y * normal.y;
+		q.a12 = weight * normal.y * normal.z;
+		q.a22 = weight * normal.z * normal.z;
+		q.b0 = weight * distance * normal.x;
+		q.b1 = weight * distance * normal.y;
+		q.b2 = weight * distance * normal.z;
+		q.c = weight * distance * distance;
+		q.weight = weight;
+		return q;
+	}
+
+	void addQuadric(Quadric& to, const Quadric& q) {
+		to.a00 += q.a00;
+		to.a01 += q.a01;
+		to.a02 += q.a02;
+		to.a11 += q.a11;
+		to.a12 += q.a12;
+		to.a22 += q.a22;
+		to.b0 += q.b0;
+		to.b1 += q.b1;
+		to.b2 += q.b2;
+		to.c += q.c;
+		to.weight += q.weight;
+	}
+
+	// Weighted root mean square distance of "p" from the planes
+	double evaluateQuadric(const Quadric& q, const glm::vec3& p) {
+		if (q.weight <= 0.0) {
+			return 0.0;
+		}
+
+		double x = p.x;
+		double y = p.y;
+		double z = p.z;
+		double error =
+			q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+			2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+			2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) +
+			q.c;
+		return std::sqrt(std::max(error, 0.0) / q.weight);
+	}
+
+	uint64_t getEdgeKey(uint32_t a, uint32_t b) {
+		return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+	}
+
+	/*
+	* Collapses edges in passes. Each pass rates every edge of the current
+	* mesh, then collapses the cheapest ones greedily. A collapse locks every
+	* vertex of the triangles around it for the rest of the pass, so the
+	* flip check of a later collapse never looks at a vertex that already
+	* moved.
+	*/
+	class MeshSimplifier {
+	public:
+		MeshSimplifier(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+		// Until at most targetIndexCount indices are left, or the next collapse would exceed maxError
+		void simplify(size_t targetIndexCount, double maxError);
+
+		const std::vector<uint32_t>& getIndices() const { return indices; }
+		// Largest error of any collapse so far
+		double getError() const { return error; }
+
+	private:
+		typedef struct Collapse {
+			uint32_t source;
+			uint32_t target;
+			// Triangles sharing the edge, all of them degenerate
+			uint32_t triangles;
+			double cost;
+		} Collapse;
+
+		const std::vector<glm::vec3>& positions;
+		std::vector<uint32_t> indices;
+		std::vector<Quadric> quadrics;
+		double error = 0.0;
+
+		// Per pass: the triangles around each vertex
+		std::vector<uint32_t> triangleOffsets;
+		std::vector<uint32_t> vertexTriangles;
+
+		void buildAdjacency();
+		// True if moving source onto target turns one of the remaining triangles around
+		bool flipsTriangle(uint32_t source, uint32_t target) const;
+	};
+
+	MeshSimplifier::MeshSimplifier(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+		: positions(positions), indices(indices), quadrics(positions.size()) {
+		std::vector<uint64_t> edges;
+		edges.reserve(indices.size());
+
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			const glm::vec3& p0 = positions[indices[i]];
+			const glm::vec3& p1 = positions[indices[i + 1]];
+			const glm::vec3& p2 = positions[indices[i + 2]];
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			if (length > 0.0f) {
+				normal = normal / length;
+				// Weighted by area, large triangles matter more
+				Quadric plane = makePlaneQuadric(normal, -glm::dot(normal, p0), 0.5 * length);
+				for (size_t corner = 0; corner < 3; corner++) {
+					addQuadric(quadrics[indices[i + corner]], plane);
+				}
+			}
+
+			for (size_t corner = 0; corner < 3; corner++) {
+				edges.push_back(getEdgeKey(indices[i + corner], indices[i + (corner + 1) % 3]));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		// Edges of only one triangle: a plane through the edge, perpendicular to the triangle
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			const glm::vec3& p0 = positions[indices[i]];
+			glm::vec3 normal = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+
+			for (size_t corner = 0; corner < 3; corner++) {
+				uint32_t a = indices[i + corner];
+				uint32_t b = indices[i + (corner + 1) % 3];
+				auto range = std::equal_range(edges.begin(), edges.end(), getEdgeKey(a, b));
+				if (range.second - range.first != 1) {
+					continue;
+				}
+
+				glm::vec3 edge = positions[b] - positions[a];
+				glm::vec3 borderNormal = glm::cross(edge, normal);
+				float length = glm::length(borderNormal);
+				if (length <= 0.0f) {
+					continue;
+				}
+				borderNormal = borderNormal / length;
+
+				Quadric plane = makePlaneQuadric(borderNormal, -glm::dot(borderNormal, positions[a]),
+					borderWeight * glm::dot(edge, edge));
+				addQuadric(quadrics[a], plane);
+				addQuadric(quadrics[b], plane);
+			}
+		}
+	}
+
+	void MeshSimplifier::simplify(size_t targetIndexCount, double maxError) {
+		const size_t vertexCount = positions.size();
+		std::vector<uint32_t> collapseTargets(vertexCount);
+		std::vector<uint8_t> locked(vertexCount);
+		std::vector<uint64_t> edges;
+		std::vector<Collapse> collapses;
+
+		while (indices.size() > targetIndexCount) {
+			buildAdjacency();
+
+			edges.clear();
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				for (size_t corner = 0; corner < 3; corner++) {
+					edges.push_back(getEdgeKey(indices[i + corner], indices[i + (corner + 1) % 3]));
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+
+			// One candidate per edge, in its cheaper direction
+			collapses.clear();
+			for (size_t first = 0; first < edges.size();) {
+				size_t last = first + 1;
+				while (last < edges.size() && edges[last] == edges[first]) {
+					last++;
+				}
+
+				uint32_t a = static_cast<uint32_t>(edges[first] >> 32);
+				uint32_t b = static_cast<uint32_t>(edges[first] & 0xFFFFFFFF);
+				Quadric merged = quadrics[a];
+				addQuadric(merged, quadrics[b]);
+				double costAtA = evaluateQuadric(merged, positions[a]);
+				double costAtB = evaluateQuadric(merged, positions[b]);
+
+				Collapse collapse{};
+				collapse.source = costAtB <= costAtA ? a : b;
+				collapse.target = costAtB <= costAtA ? b : a;
+				collapse.triangles = static_cast<uint32_t>(last - first);
+				collapse.cost = std::min(costAtA, costAtB);
+				collapses.push_back(collapse);
+
+				first = last;
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+				return x.cost < y.cost;
+			});
+
+			std::iota(collapseTargets.begin(), collapseTargets.end(), 0);
+			std::fill(locked.begin(), locked.end(), 0);
+
+			size_t trianglesToRemove = (indices.size() - targetIndexCount + 2) / 3;
+			size_t removedTriangles = 0;
+			for (const auto& collapse : collapses) {
+				if (removedTriangles >= trianglesToRemove || collapse.cost > maxError) {
+					break;
+				}
+				if (locked[collapse.source] || locked[collapse.target] || flipsTriangle(collapse.source, collapse.target)) {
+					continue;
+				}
+
+				collapseTargets[collapse.source] = collapse.target;
+				addQuadric(quadrics[collapse.target], quadrics[collapse.source]);
+				error = std::max(error, collapse.cost);
+				removedTriangles += collapse.triangles;
+
+				for (uint32_t k = triangleOffsets[collapse.source]; k < triangleOffsets[collapse.source + 1]; k++) {
+					for (size_t corner = 0; corner < 3; corner++) {
+						locked[indices[3 * vertexTriangles[k] + corner]] = 1;
+					}
+				}
+				locked[collapse.target] = 1;
+			}
+
+			if (removedTriangles == 0) {
+				// Every remaining collapse is too expensive or would fold the mesh over
+				break;
+			}
+
+			size_t write = 0;
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				uint32_t a = collapseTargets[indices[i]];
+				uint32_t b = collapseTargets[indices[i + 1]];
+				uint32_t c = collapseTargets[indices[i + 2]];
+				if (a == b || b == c || a == c) {
+					continue;
+				}
+				indices[write++] = a;
+				indices[write++] = b;
+				indices[write++] = c;
+			}
+			indices.resize(write);
+		}
+	}
+
+	void MeshSimplifier::buildAdjacency() {
+		triangleOffsets.assign(positions.size() + 1, 0);
+		for (uint32_t index : indices) {
+			triangleOffsets[index + 1]++;
+		}
+		std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+
+		vertexTriangles.resize(indices.size());
+		std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++) {
+			vertexTriangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	bool MeshSimplifier::flipsTriangle(uint32_t source, uint32_t target) const {
+		for (uint32_t k = triangleOffsets[source]; k < triangleOffsets[source + 1]; k++) {
+			const uint32_t* triangle = &indices[3 * vertexTriangles[k]];
+			if (triangle[0] == target || triangle[1] == target || triangle[2] == target) {
+				// Collapses along with the edge
+				continue;
+			}
+
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for (size_t corner = 0; corner < 3; corner++) {
+				before[corner] = positions[triangle[corner]];
+				after[corner] = triangle[corner] == source ? positions[target] : before[corner];
+			}
+
+			glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if (glm::dot(normalBefore, normalAfter) <= 0.0f) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+MeshLodChain::MeshLodChain(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& sourceIndices, const MeshLodOptions& options) {
+	if (sourceIndices.size() % 3 != 0) {
+		throw std::runtime_error("Mesh index count is not a multiple of 3!");
+	}
+
+	glm::vec3 minimum(FLT_MAX);
+	glm::vec3 maximum(-FLT_MAX);
+	for (uint32_t index : sourceIndices) {
+		if (index >= positions.size()) {
+			throw std::runtime_error("Mesh index out of range!");
+		}
+		minimum = glm::min(minimum, positions[index]);
+		maximum = glm::max(maximum, positions[index]);
+	}
+	if (!sourceIndices.empty()) {
+		center = (minimum + maximum) * 0.5f;
+		for (uint32_t index : sourceIndices) {
+			radius = std::max(radius, glm::distance(center, positions[index]));
+		}
+	}
+
+	indices = sourceIndices;
+	levels.push_back({ 0, static_cast<uint32_t>(sourceIndices.size()), 0.0f });
+
+	MeshSimplifier simplifier(positions, sourceIndices);
+	const double maxError = options.maxRelativeError * radius;
+
+	while (levels.size() < options.maxLevels) {
+		uint32_t previousCount = levels.back().indexCount;
+		size_t targetCount = static_cast<size_t>((previousCount / 3) * options.reduction) * 3;
+
+		simplifier.simplify(targetCount, maxError);
+
+		const std::vector<uint32_t>& simplified = simplifier.getIndices();
+		if (simplified.empty() || simplified.size() > previousCount * (1.0f - options.minReduction)) {
+			break;
+		}
+
+		MeshLod level{};
+		level.firstIndex = static_cast<uint32_t>(indices.size());
+		level.indexCount = static_cast<uint32_t>(simplified.size());
+		level.error = static_cast<float>(simplifier.getError());
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		levels.push_back(level);
+	}
+}
+
+uint32_t MeshLodChain::selectLevel(float pixelsPerUnit, float threshold, uint32_t currentLevel, float hysteresis) const {
+	// Errors only grow with the level, the first one from the coarse end that fits wins
+	for (uint32_t level = getLevelCount(); level-- > 1;) {
+		float allowed = level > currentLevel ? threshold * (1.0f - hysteresis) : threshold;
+		if (levels[level].error * pixelsPerUnit <= allowed) {
+			return level;
+		}
+	}
+	return 0;
+}
+
+float getProjectedPixelsPerUnit(const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj,
+	const glm::vec3& center, float viewportHeight) {
+	float scale = std::max({
+		glm::length(glm::vec3(model[0])),
+		glm::length(glm::vec3(model[1])),
+		glm::length(glm::vec3(model[2]))
+	});
+
+	// w is the view space depth for perspective projections and 1 for orthographic ones
+	glm::vec4 clip = proj * view * model * glm::vec4(center, 1.0f);
+	// Centers at or behind the eye get the finest level, the mesh may still reach into view
+	float w = std::max(clip.w, 1e-3f);
+
+	// proj[1][1] maps view space height to clip space, the viewport covers 2 clip space units
+	return scale * std::fabs(proj[1][1]) * viewportHeight * 0.5f / w;
+}
@@ -0,0 +1,375 @@
+#include "tfwi_vulkan_pipeline_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+bool PipelineKey::operator==(const PipelineKey& other) const {
+	return std::memcmp(this, &other, sizeof(PipelineKey)) == 0;
+}
+
+size_t PipelineKeyHash::operator()(const PipelineKey& key) const {
+	// FNV-1a over the packed key
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&key);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < sizeof(PipelineKey); i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+void PipelineCache::create(VkDevice device, PipelineLayoutCache& layouts, JobSystem& jobs) {
+	this->device = device;
+	this->layouts = &layouts;
+	this->jobs = &jobs;
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &driverCache) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline cache!");
+	}
+}
+
+void PipelineCache::destroy() {
+	jobs->wait(builds);
+
+	std::unique_lock<std::shared_mutex> lock(mutex);
+
+	for (const auto& entry : entries) {
+		if (entry.second.pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, entry.second.pipeline, nullptr);
+		}
+	}
+	for (const auto& shader : shaders) {
+		vkDestroyShaderModule(device, shader.module, nullptr);
+	}
+	vkDestroyPipelineCache(device, driverCache, nullptr);
+
+	entries.clear();
+	shaders.clear();
+	vertexLayouts.clear();
+	renderPasses.clear();
+	pendingCount = 0;
+	driverCache = VK_NULL_HANDLE;
+}
+
+uint16_t PipelineCache::addShader(const std::string& name, ShaderBinary binary, const ShaderReflection& reflection) {
+	std::unique_lock<std::shared_mutex> lock(mutex);
+
+	for (size_t i = 0; i < shaders.size(); i++) {
+		if (shaders[i].name == name) {
+			return static_cast<uint16_t>(i + 1);
+		}
+	}
+	if (shaders.size() >= UINT16_MAX) {
+		throw std::runtime_error("Too many shaders in the pipeline cache!");
+	}
+
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = binary.size;
+	createInfo.pCode = binary.code;
+
+	Shader shader{};
+	shader.name = name;
+	shader.reflection = &reflection;
+	if (vkCreateShaderModule(device, &createInfo, nullptr, &shader.module) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shader module for " + name + "!");
+	}
+
+	shaders.push_back(shader);
+	return static_cast<uint16_t>(shaders.size());
+}
+
+uint16_t PipelineCache::addVertexLayout(const std::vector<VkVertexInputBindingDescription>& bindings,
+	const std::vector<VkVertexInputAttributeDescription>& attributes) {
+	std::unique_lock<std::shared_mutex> lock(mutex);
+
+	for (size_t i = 0; i < vertexLayouts.size(); i++) {
+		const VertexLayout& layout = vertexLayouts[i];
+		bool sameBindings = std::equal(layout.bindings.begin(), layout.bindings.end(), bindings.begin(), bindings.end(),
+			[](const VkVertexInputBindingDescription& a, const VkVertexInputBindingDescription& b) {
+				return a.binding == b.binding && a.stride == b.stride && a.inputRate == b.inputRate;
+			});
+		bool sameAttributes = std::equal(layout.attributes.begin(), layout.attributes.end(), attributes.begin(), attributes.end(),
+			[](const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b) {
+				return a.location == b.location && a.binding == b.binding && a.format == b.format && a.offset == b.offset;
+			});
+		if (sameBindings && sameAttributes) {
+			return static_cast<uint16_t>(i + 1);
+		}
+	}
+	if (vertexLayouts.size() >= UINT16_MAX) {
+		throw std::runtime_error("Too many vertex layouts in the pipeline cache!");
+	}
+
+	vertexLayouts.push_back({ bindings, attributes });
+	return static_cast<uint16_t>(vertexLayouts.size());
+}
+
+uint16_t PipelineCache::setRenderPass(VkRenderPass renderPass, const std::vector<uint32_t>& compatibility) {
+	std::unique_lock<std::shared_mutex> lock(mutex);
+
+	for (size_t i = 0; i < renderPasses.size(); i++) {
+		if (renderPasses[i].compatibility != compatibility) {
+			continue;
+		}
+
+		if (renderPasses[i].handle != renderPass) {
+			// Builds starting from now on take the new one, the caller may destroy the old one once the running builds are done
+			renderPasses[i].handle = renderPass;
+			lock.unlock();
+			jobs->wait(builds);
+		}
+		return static_cast<uint16_t>(i + 1);
+	}
+	if (renderPasses.size() >= UINT16_MAX) {
+		throw std::runtime_error("Too many render passes in the pipeline cache!");
+	}
+
+	renderPasses.push_back({ compatibility, renderPass });
+	return static_cast<uint16_t>(renderPasses.size());
+}
+
+VkPipeline PipelineCache::get(const PipelineKey& key, const PipelineKey* fallback) {
+	bool missing = false;
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		auto found = entries.find(key);
+		if (found == entries.end()) {
+			missing = true;
+		}
+		else if (found->second.state == EntryState::Ready) {
+			return found->second.pipeline;
+		}
+		else if (found->second.state == EntryState::Failed) {
+			std::rethrow_exception(found->second.error);
+		}
+	}
+
+	if (missing) {
+		bool inserted = false;
+		{
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			inserted = entries.try_emplace(key).second;
+			if (inserted) {
+				pendingCount++;
+			}
+		}
+
+		// Not under the lock, without running workers the job runs right here
+		if (inserted) {
+			jobs->run([this, key]() { buildQueued(key); }, &builds);
+		}
+	}
+
+	return fallback != nullptr ? get(*fallback) : VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineCache::build(const PipelineKey& key) {
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		if (entries.try_emplace(key).second) {
+			pendingCount++;
+		}
+	}
+
+	// A queued job finds the entry taken and does nothing
+	buildQueued(key);
+
+	std::unique_lock<std::shared_mutex> lock(mutex);
+	built.wait(lock, [this, &key]() {
+		EntryState state = entries.at(key).state;
+		return state == EntryState::Ready || state == EntryState::Failed;
+	});
+
+	const Entry& entry = entries.at(key);
+	if (entry.state == EntryState::Failed) {
+		std::rethrow_exception(entry.error);
+	}
+	return entry.pipeline;
+}
+
+VkPipelineLayout PipelineCache::getPipelineLayout(const PipelineKey& key) {
+	std::vector<const ShaderReflection*> stages;
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		if (key.vertexShader == 0 || key.vertexShader > shaders.size() ||
+			key.fragmentShader == 0 || key.fragmentShader > shaders.size()) {
+			throw std::runtime_error("Pipeline key names an unknown shader!");
+		}
+		stages.push_back(shaders[key.vertexShader - 1].reflection);
+		stages.push_back(shaders[key.fragmentShader - 1].reflection);
+	}
+
+	return layouts->getPipelineLayout(stages);
+}
+
+size_t PipelineCache::getPipelineCount() const {
+	std::shared_lock<std::shared_mutex> lock(mutex);
+	return entries.size() - pendingCount;
+}
+
+size_t PipelineCache::getPendingCount() const {
+	std::shared_lock<std::shared_mutex> lock(mutex);
+	return pendingCount;
+}
+
+void PipelineCache::buildQueued(const PipelineKey& key) {
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		Entry& entry = entries.at(key);
+		if (entry.state != EntryState::Queued) {
+			return;
+		}
+		entry.state = EntryState::Building;
+	}
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	std::exception_ptr error;
+	try {
+		pipeline = createPipeline(key);
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+
+	{
+		// The map may have rehashed in the meantime, but the entry is still there
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		Entry& entry = entries.at(key);
+		entry.pipeline = pipeline;
+		entry.error = error;
+		entry.state = error ? EntryState::Failed : EntryState::Ready;
+		pendingCount--;
+	}
+	built.notify_all();
+}
+
+VkPipeline PipelineCache::createPipeline(const PipelineKey& key) {
+	// Copied, shaders, layouts and render passes may be added while this builds
+	Shader vertexShader;
+	Shader fragmentShader;
+	VertexLayout vertexLayout;
+	VkRenderPass renderPass;
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		if (key.vertexShader == 0 || key.vertexShader > shaders.size() ||
+			key.fragmentShader == 0 || key.fragmentShader > shaders.size()) {
+			throw std::runtime_error("Pipeline key names an unknown shader!");
+		}
+		if (key.vertexLayout == 0 || key.vertexLayout > vertexLayouts.size()) {
+			throw std::runtime_error("Pipeline key names an unknown vertex layout!");
+		}
+		if (key.renderPass == 0 || key.renderPass > renderPasses.size()) {
+			throw std::runtime_error("Pipeline key names an unknown render pass!");
+		}
+		vertexShader = shaders[key.vertexShader - 1];
+		fragmentShader = shaders[key.fragmentShader - 1];
+		vertexLayout = vertexLayouts[key.vertexLayout - 1];
+		renderPass = renderPasses[key.renderPass - 1].handle;
+	}
+
+	vertexShader.reflection->checkVertexAttributes(
+		vertexLayout.attributes.data(), static_cast<uint32_t>(vertexLayout.attributes.size()));
+
+	VkPipelineShaderStageCreateInfo shaderStages[2]{};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertexShader.module;
+	shaderStages[0].pName = vertexShader.reflection->getEntryPoint().c_str();
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragmentShader.module;
+	shaderStages[1].pName = fragmentShader.reflection->getEntryPoint().c_str();
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexLayout.bindings.size());
+	vertexInputInfo.pVertexBindingDescriptions = vertexLayout.bindings.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexLayout.attributes.size());
+	vertexInputInfo.pVertexAttributeDescriptions = vertexLayout.attributes.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = static_cast<VkPrimitiveTopology>(key.topology);
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	// Both dynamic, only the counts matter
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = static_cast<VkPolygonMode>(key.polygonMode);
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = key.cullMode;
+	rasterizer.frontFace = static_cast<VkFrontFace>(key.frontFace);
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = static_cast<VkSampleCountFlagBits>(key.samples);
+	multisampling.minSampleShading = 1.0f;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = key.colorWriteMask;
+	colorBlendAttachment.blendEnable = key.blend != PipelineBlend::Opaque ? VK_TRUE : VK_FALSE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = key.blend == PipelineBlend::Additive ?
+		VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.logicOp = VK_LOGIC_OP_COPY;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	static const VkDynamicState dynamicStates[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = nullptr;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = layouts->getPipelineLayout({ vertexShader.reflection, fragmentShader.reflection });
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	// The driver cache is internally synchronized, workers may build at the same time
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(device, driverCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create graphics pipeline for " + vertexShader.name + " and " + fragmentShader.name + "!");
+	}
+	return pipeline;
+}
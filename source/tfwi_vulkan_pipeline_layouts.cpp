@@ -0,0 +1,168 @@
+#include "tfwi_vulkan_pipeline_layouts.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+void PipelineLayoutCache::create(VkDevice device) {
+	this->device = device;
+}
+
+void PipelineLayoutCache::destroy() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (const auto& layout : pipelineLayouts) {
+		vkDestroyPipelineLayout(device, layout.second, nullptr);
+	}
+	for (const auto& layout : descriptorSetLayouts) {
+		vkDestroyDescriptorSetLayout(device, layout.second, nullptr);
+	}
+	pipelineLayouts.clear();
+	descriptorSetLayouts.clear();
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::getDescriptorSetLayout(const std::vector<const ShaderReflection*>& stages, uint32_t set) {
+	std::vector<VkDescriptorSetLayoutBinding> bindings = mergeBindings(stages, set);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	return findOrCreateSetLayout(bindings);
+}
+
+VkPipelineLayout PipelineLayoutCache::getPipelineLayout(const std::vector<const ShaderReflection*>& stages) {
+	uint32_t setCount = 0;
+	VkPushConstantRange pushConstantRange{};
+	for (const ShaderReflection* stage : stages) {
+		for (const auto& binding : stage->getDescriptorBindings()) {
+			setCount = std::max(setCount, binding.set + 1);
+		}
+
+		// GLSL has one push constant block, every stage declaring it sees it from offset 0
+		const VkPushConstantRange& stageRange = stage->getPushConstantRange();
+		if (stageRange.size > 0) {
+			pushConstantRange.stageFlags |= stageRange.stageFlags;
+			pushConstantRange.size = std::max(pushConstantRange.size, stageRange.offset + stageRange.size);
+		}
+	}
+
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> setBindings(setCount);
+	for (uint32_t set = 0; set < setCount; set++) {
+		setBindings[set] = mergeBindings(stages, set);
+	}
+
+	// The signatures of all sets, then the push constants
+	Signature signature;
+	for (const auto& bindings : setBindings) {
+		Signature setSignature = getSignature(bindings);
+		signature.push_back(static_cast<uint32_t>(setSignature.size()));
+		signature.insert(signature.end(), setSignature.begin(), setSignature.end());
+	}
+	signature.push_back(pushConstantRange.stageFlags);
+	signature.push_back(pushConstantRange.size);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto found = pipelineLayouts.find(signature);
+	if (found != pipelineLayouts.end()) {
+		return found->second;
+	}
+
+	std::vector<VkDescriptorSetLayout> setLayouts(setCount);
+	for (uint32_t set = 0; set < setCount; set++) {
+		setLayouts[set] = findOrCreateSetLayout(setBindings[set]);
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = setCount;
+	pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = pushConstantRange.size > 0 ? 1 : 0;
+	pipelineLayoutInfo.pPushConstantRanges = pushConstantRange.size > 0 ? &pushConstantRange : nullptr;
+
+	VkPipelineLayout pipelineLayout;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout!");
+	}
+
+	pipelineLayouts[signature] = pipelineLayout;
+	return pipelineLayout;
+}
+
+size_t PipelineLayoutCache::getDescriptorSetLayoutCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return descriptorSetLayouts.size();
+}
+
+size_t PipelineLayoutCache::getPipelineLayoutCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return pipelineLayouts.size();
+}
+
+std::vector<VkDescriptorSetLayoutBinding> PipelineLayoutCache::mergeBindings(const std::vector<const ShaderReflection*>& stages, uint32_t set) {
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+	for (const ShaderReflection* stage : stages) {
+		for (const auto& reflected : stage->getDescriptorBindings()) {
+			if (reflected.set != set) {
+				continue;
+			}
+
+			auto existing = std::find_if(bindings.begin(), bindings.end(), [&](const VkDescriptorSetLayoutBinding& binding) {
+				return binding.binding == reflected.binding;
+			});
+			if (existing != bindings.end()) {
+				if (existing->descriptorType != reflected.type || existing->descriptorCount != reflected.count) {
+					throw std::runtime_error("Shader stages disagree on set " + std::to_string(set) + ", binding " + std::to_string(reflected.binding) + "!");
+				}
+				existing->stageFlags |= reflected.stageFlags;
+				continue;
+			}
+
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = reflected.binding;
+			binding.descriptorType = reflected.type;
+			binding.descriptorCount = reflected.count;
+			binding.stageFlags = reflected.stageFlags;
+			binding.pImmutableSamplers = nullptr;
+			bindings.push_back(binding);
+		}
+	}
+
+	std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+		return a.binding < b.binding;
+	});
+	return bindings;
+}
+
+PipelineLayoutCache::Signature PipelineLayoutCache::getSignature(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+	Signature signature;
+	signature.reserve(bindings.size() * 4);
+	for (const auto& binding : bindings) {
+		signature.push_back(binding.binding);
+		signature.push_back(static_cast<uint32_t>(binding.descriptorType));
+		signature.push_back(binding.descriptorCount);
+		signature.push_back(binding.stageFlags);
+	}
+	return signature;
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::findOrCreateSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+	Signature signature = getSignature(bindings);
+
+	auto found = descriptorSetLayouts.find(signature);
+	if (found != descriptorSetLayouts.end()) {
+		return found->second;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	VkDescriptorSetLayout descriptorSetLayout;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create descriptor set layout!");
+	}
+
+	descriptorSetLayouts[signature] = descriptorSetLayout;
+	return descriptorSetLayout;
+}
@@ -0,0 +1,853 @@
+#include "tfwi_vulkan_render_graph.hpp"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+namespace {
+	typedef struct AccessInfo {
+		VkImageLayout layout;
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageUsageFlags usage;
+		bool write;
+	} AccessInfo;
+
+	AccessInfo getAccessInfo(RenderGraphAccess access, RenderGraphPassType passType) {
+		// Shader reads happen in the fragment stage for graphics passes, and in the compute stage otherwise
+		VkPipelineStageFlags shaderStage = passType == RenderGraphPassType::Graphics ?
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT :
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		switch (access) {
+		case RenderGraphAccess::ColorAttachment:
+		case RenderGraphAccess::ResolveAttachment:
+			return {
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+				true };
+		case RenderGraphAccess::SampledRead:
+			return {
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				shaderStage,
+				VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_USAGE_SAMPLED_BIT,
+				false };
+		case RenderGraphAccess::StorageRead:
+			return {
+				VK_IMAGE_LAYOUT_GENERAL,
+				shaderStage,
+				VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_USAGE_STORAGE_BIT,
+				false };
+		case RenderGraphAccess::StorageWrite:
+			return {
+				VK_IMAGE_LAYOUT_GENERAL,
+				shaderStage,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_USAGE_STORAGE_BIT,
+				true };
+		case RenderGraphAccess::TransferRead:
+			return {
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+				false };
+		case RenderGraphAccess::TransferWrite:
+			return {
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+				true };
+		}
+
+		throw std::runtime_error("Unknown render graph access!");
+	}
+
+	bool isAttachment(RenderGraphAccess access) {
+		return access == RenderGraphAccess::ColorAttachment ||
+			access == RenderGraphAccess::ResolveAttachment;
+	}
+
+	/*
+	* A resource overwritten in full by a pass does not need the contents
+	* produced by earlier passes (used for culling).
+	*/
+	bool overwritesContents(const RenderGraphImageUse& use) {
+		return use.access == RenderGraphAccess::ResolveAttachment ||
+			(use.access == RenderGraphAccess::ColorAttachment && use.clear);
+	}
+}
+
+void RenderGraphPass::addColorOutput(RenderGraphResource resource) {
+	RenderGraphImageUse use{};
+	use.resource = resource;
+	use.access = RenderGraphAccess::ColorAttachment;
+	uses.push_back(use);
+}
+
+void RenderGraphPass::addColorOutput(RenderGraphResource resource, VkClearValue clearValue) {
+	RenderGraphImageUse use{};
+	use.resource = resource;
+	use.access = RenderGraphAccess::ColorAttachment;
+	use.clear = true;
+	use.clearValue = clearValue;
+	uses.push_back(use);
+}
+
+void RenderGraphPass::addResolveOutput(RenderGraphResource resource, RenderGraphResource colorSource) {
+	bool sourceFound = std::any_of(uses.begin(), uses.end(), [colorSource](const RenderGraphImageUse& use) {
+		return use.resource == colorSource && use.access == RenderGraphAccess::ColorAttachment;
+	});
+
+	if (!sourceFound) {
+		throw std::runtime_error("Resolve output of pass \"" + name + "\" must follow its color output!");
+	}
+
+	RenderGraphImageUse use{};
+	use.resource = resource;
+	use.access = RenderGraphAccess::ResolveAttachment;
+	use.resolveSource = colorSource;
+	uses.push_back(use);
+}
+
+void RenderGraphPass::addTextureInput(RenderGraphResource resource) {
+	RenderGraphImageUse use{};
+	use.resource = resource;
+	use.access = RenderGraphAccess::SampledRead;
+	uses.push_back(use);
+}
+
+void RenderGraphPass::addStorageInput(RenderGraphResource resource) {
+	RenderGraphImageUse use{};
+	use.resource = resource;
+	use.access = RenderGraphAccess::StorageRead;
+	uses.push_back(use);
+}
+
+void RenderGraphPass::addStorageOutput(RenderGraphResource resource) {
+	RenderGraphImageUse use{};
+	use.resource = resource;
+	use.access = RenderGraphAccess::StorageWrite;
+	uses.push_back(use);
+}
+
+void RenderGraphPass::addTransferInput(RenderGraphResource resource) {
+	RenderGraphImageUse use{};
+	use.resource = resource;
+	use.access = RenderGraphAccess::TransferRead;
+	uses.push_back(use);
+}
+
+void RenderGraphPass::addTransferOutput(RenderGraphResource resource) {
+	RenderGraphImageUse use{};
+	use.resource = resource;
+	use.access = RenderGraphAccess::TransferWrite;
+	uses.push_back(use);
+}
+
+void RenderGraphPass::setRecordCallback(RenderGraphRecordCallback callback) {
+	record = std::move(callback);
+}
+
+RenderGraphResource RenderGraph::importSwapChain(
+	const std::string& name,
+	VkFormat format,
+	VkExtent2D extent,
+	const std::vector<VkImage>& images,
+	const std::vector<VkImageView>& views,
+	VkImageLayout finalLayout) {
+
+	if (images.empty() || images.size() != views.size()) {
+		throw std::runtime_error("Swap chain imported into the render graph has mismatched images and views!");
+	}
+
+	Resource resource{};
+	resource.name = name;
+	resource.desc.format = format;
+	resource.desc.extent = extent;
+	resource.imported = true;
+	resource.finalLayout = finalLayout;
+	resource.images = images;
+	resource.views = views;
+
+	/*
+	* Frames wait on the image acquisition semaphore at the color attachment
+	* output stage, so that is where the first access has to synchronize with.
+	*/
+	resource.initialState.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	resource.initialState.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	resource.initialState.writeAccess = 0;
+
+	imageCount = std::max(imageCount, static_cast<uint32_t>(images.size()));
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::createTransientImage(const std::string& name, const RenderGraphImageDesc& desc) {
+	Resource resource{};
+	resource.name = name;
+	resource.desc = desc;
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphPass& RenderGraph::addPass(const std::string& name, RenderGraphPassType type) {
+	passes.emplace_back(name, type);
+	return passes.back();
+}
+
+void RenderGraph::setOutput(RenderGraphResource resource) {
+	outputs.push_back(resource);
+}
+
+void RenderGraph::compile(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+	DeviceMemoryTracker* memoryTracker) {
+	this->device = device;
+	this->memoryTracker = memoryTracker;
+
+	for (const auto& pass : passes) {
+		for (const auto& use : pass.getUses()) {
+			if (use.resource >= resources.size()) {
+				throw std::runtime_error("Pass \"" + pass.getName() + "\" uses an unknown render graph resource!");
+			}
+		}
+	}
+
+	cullPasses();
+	deriveUsageAndLifetimes();
+	allocateTransientImages(memoryProperties);
+	buildPasses();
+}
+
+/*
+* Walk the passes backwards, keeping track of which resources still need a
+* producer. A pass survives if it writes one of them; its own inputs then
+* become needed in turn.
+*/
+void RenderGraph::cullPasses() {
+	std::set<RenderGraphResource> needed(outputs.begin(), outputs.end());
+	passCulled.assign(passes.size(), true);
+
+	for (size_t i = passes.size(); i-- > 0;) {
+		const auto& uses = passes[i].getUses();
+
+		bool contributes = std::any_of(uses.begin(), uses.end(), [&needed](const RenderGraphImageUse& use) {
+			return getAccessInfo(use.access, RenderGraphPassType::Graphics).write && needed.count(use.resource);
+		});
+
+		if (!contributes && !passes[i].isNeverCulled()) {
+			continue;
+		}
+
+		passCulled[i] = false;
+
+		for (const auto& use : uses) {
+			if (overwritesContents(use)) {
+				needed.erase(use.resource);
+			}
+		}
+
+		for (const auto& use : uses) {
+			bool write = getAccessInfo(use.access, passes[i].getType()).write;
+			// Loading a color attachment reads whatever earlier passes left in it
+			if (!write || (use.access == RenderGraphAccess::ColorAttachment && !use.clear)) {
+				needed.insert(use.resource);
+			}
+		}
+	}
+}
+
+void RenderGraph::deriveUsageAndLifetimes() {
+	int32_t executionIndex = 0;
+	for (size_t i = 0; i < passes.size(); i++) {
+		if (passCulled[i]) {
+			continue;
+		}
+
+		for (const auto& use : passes[i].getUses()) {
+			Resource& resource = resources[use.resource];
+			resource.usage |= getAccessInfo(use.access, passes[i].getType()).usage;
+
+			if (resource.firstPass < 0) {
+				resource.firstPass = executionIndex;
+			}
+			resource.lastPass = executionIndex;
+		}
+
+		executionIndex++;
+	}
+}
+
+/*
+* Transient images are placed into as few memory blocks as possible: an
+* image may share a block with every image whose lifetime (in executed pass
+* order) does not overlap its own. Images are placed largest first so a block
+* is sized by its first resident.
+*/
+void RenderGraph::allocateTransientImages(const VkPhysicalDeviceMemoryProperties& memoryProperties) {
+	std::vector<RenderGraphResource> transients;
+	std::vector<VkMemoryRequirements> requirements(resources.size());
+
+	for (RenderGraphResource r = 0; r < resources.size(); r++) {
+		Resource& resource = resources[r];
+		if (resource.imported || resource.firstPass < 0) {
+			continue;
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = resource.desc.format;
+		imageInfo.extent.width = resource.desc.extent.width;
+		imageInfo.extent.height = resource.desc.extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = resource.desc.samples;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = resource.usage | resource.desc.additionalUsage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		resource.images.resize(1);
+		if (vkCreateImage(device, &imageInfo, nullptr, &resource.images[0]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create render graph image \"" + resource.name + "\"!");
+		}
+
+		vkGetImageMemoryRequirements(device, resource.images[0], &requirements[r]);
+		transientMemoryRequested += requirements[r].size;
+		transients.push_back(r);
+	}
+
+	std::sort(transients.begin(), transients.end(), [&requirements](RenderGraphResource a, RenderGraphResource b) {
+		return requirements[a].size > requirements[b].size;
+	});
+
+	for (RenderGraphResource r : transients) {
+		Resource& resource = resources[r];
+
+		/*
+		* Attachments that never leave tile memory (MSAA color, depth...) are
+		* created with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT. On tile-based GPUs
+		* they can live in lazily allocated memory, which is never backed by
+		* actual VRAM unless the driver needs to spill.
+		*/
+		bool lazy = ((resource.usage | resource.desc.additionalUsage) & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0;
+
+		for (size_t b = 0; b < memoryBlocks.size() && resource.memoryBlock < 0; b++) {
+			MemoryBlock& block = memoryBlocks[b];
+			if (!(requirements[r].memoryTypeBits & (1 << block.memoryTypeIndex)) ||
+				requirements[r].size > block.size ||
+				block.lazilyAllocated != lazy) {
+				continue;
+			}
+
+			bool overlaps = std::any_of(block.residents.begin(), block.residents.end(), [this, &resource](RenderGraphResource other) {
+				return !(resources[other].lastPass < resource.firstPass || resource.lastPass < resources[other].firstPass);
+			});
+
+			if (!overlaps) {
+				resource.memoryBlock = static_cast<int32_t>(b);
+				block.residents.push_back(r);
+			}
+		}
+
+		if (resource.memoryBlock >= 0) {
+			continue;
+		}
+
+		MemoryBlock block{};
+		block.size = requirements[r].size;
+		block.lazilyAllocated = lazy;
+		block.residents.push_back(r);
+
+		bool typeFound = false;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && lazy && !typeFound; i++) {
+			if ((requirements[r].memoryTypeBits & (1 << i)) &&
+				(memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+				block.memoryTypeIndex = i;
+				typeFound = true;
+			}
+		}
+
+		// Desktop GPUs usually expose no lazily allocated memory, use regular VRAM there
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && !typeFound; i++) {
+			if ((requirements[r].memoryTypeBits & (1 << i)) &&
+				(memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+				block.memoryTypeIndex = i;
+				typeFound = true;
+			}
+		}
+
+		if (!typeFound) {
+			throw std::runtime_error("Failed to find suitable memory type for render graph image \"" + resource.name + "\"!");
+		}
+
+		resource.memoryBlock = static_cast<int32_t>(memoryBlocks.size());
+		memoryBlocks.push_back(block);
+	}
+
+	for (auto& block : memoryBlocks) {
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = block.size;
+		allocInfo.memoryTypeIndex = block.memoryTypeIndex;
+
+		VkResult result = memoryTracker != nullptr
+			? memoryTracker->allocate(allocInfo, MemoryUsage::RenderTarget, &block.memory)
+			: vkAllocateMemory(device, &allocInfo, nullptr, &block.memory);
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate render graph memory!");
+		}
+		transientMemorySize += block.size;
+
+		/*
+		* Every resident of a block starts its lifetime with undefined contents,
+		* but it must still wait for whatever touched the block before it: an
+		* earlier resident in this frame, or the last resident of the previous frame.
+		*/
+		ResourceState blockState{};
+		for (RenderGraphResource r : block.residents) {
+			for (size_t i = 0; i < passes.size(); i++) {
+				if (passCulled[i]) {
+					continue;
+				}
+				for (const auto& use : passes[i].getUses()) {
+					if (use.resource == r) {
+						AccessInfo info = getAccessInfo(use.access, passes[i].getType());
+						blockState.stages |= info.stages;
+						blockState.writeAccess |= info.write ? info.access : 0;
+					}
+				}
+			}
+		}
+
+		for (RenderGraphResource r : block.residents) {
+			Resource& resource = resources[r];
+			resource.initialState = blockState;
+
+			if (vkBindImageMemory(device, resource.images[0], block.memory, 0) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to bind render graph image \"" + resource.name + "\"!");
+			}
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = resource.images[0];
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = resource.desc.format;
+			viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+			viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+			viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+			viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+
+			resource.views.resize(1);
+			if (vkCreateImageView(device, &viewInfo, nullptr, &resource.views[0]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create render graph image view \"" + resource.name + "\"!");
+			}
+		}
+	}
+}
+
+/*
+* Simulates one frame, tracking the layout and last access of every image,
+* and records the barrier (or render pass dependency) each access needs.
+* The resulting barriers are identical every frame, so they are computed once.
+*/
+void RenderGraph::buildPasses() {
+	std::vector<ResourceState> states(resources.size());
+	for (size_t r = 0; r < resources.size(); r++) {
+		states[r] = resources[r].initialState;
+	}
+
+	for (size_t i = 0; i < passes.size(); i++) {
+		if (passCulled[i]) {
+			continue;
+		}
+
+		const RenderGraphPass& pass = passes[i];
+		CompiledPass compiled{};
+		compiled.pass = static_cast<uint32_t>(i);
+
+		for (const auto& use : pass.getUses()) {
+			if (pass.getType() == RenderGraphPassType::Graphics && isAttachment(use.access)) {
+				// Handled by the render pass itself
+				continue;
+			}
+
+			AccessInfo info = getAccessInfo(use.access, pass.getType());
+			ResourceState& state = states[use.resource];
+
+			bool layoutChange = state.layout != info.layout;
+			bool hazard = state.writeAccess != 0 || info.write;
+			if (layoutChange || hazard) {
+				ImageBarrier barrier{};
+				barrier.resource = use.resource;
+				barrier.oldLayout = state.layout;
+				barrier.newLayout = info.layout;
+				barrier.srcStages = state.stages;
+				barrier.srcAccess = state.writeAccess;
+				barrier.dstStages = info.stages;
+				barrier.dstAccess = info.access;
+				compiled.barriers.push_back(barrier);
+
+				state.layout = info.layout;
+				state.stages = info.stages;
+				state.writeAccess = info.write ? info.access : 0;
+			}
+			else {
+				// Read after read in the same layout: just widen the stages later writers wait on
+				state.stages |= info.stages;
+			}
+		}
+
+		if (pass.getType() == RenderGraphPassType::Graphics) {
+			createRenderPass(compiled, states);
+		}
+
+		compiledPasses.push_back(compiled);
+	}
+
+	for (RenderGraphResource r = 0; r < resources.size(); r++) {
+		const Resource& resource = resources[r];
+		if (!resource.imported || resource.firstPass < 0 ||
+			resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+			states[r].layout == resource.finalLayout) {
+			continue;
+		}
+
+		ImageBarrier barrier{};
+		barrier.resource = r;
+		barrier.oldLayout = states[r].layout;
+		barrier.newLayout = resource.finalLayout;
+		barrier.srcStages = states[r].stages;
+		barrier.srcAccess = states[r].writeAccess;
+		barrier.dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		barrier.dstAccess = 0;
+		finalBarriers.push_back(barrier);
+	}
+}
+
+void RenderGraph::createRenderPass(CompiledPass& compiled, std::vector<ResourceState>& states) {
+	const RenderGraphPass& pass = passes[compiled.pass];
+	const int32_t executionIndex = static_cast<int32_t>(compiledPasses.size());
+
+	std::vector<VkAttachmentDescription> attachments;
+	std::vector<RenderGraphResource> attachmentResources;
+	std::vector<VkAttachmentReference> colorRefs;
+	std::vector<VkAttachmentReference> resolveRefs;
+	bool hasResolve = false;
+
+	VkSubpassDependency dependency{};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+
+	for (const auto& use : pass.getUses()) {
+		if (!isAttachment(use.access)) {
+			continue;
+		}
+
+		const Resource& resource = resources[use.resource];
+		ResourceState& state = states[use.resource];
+		AccessInfo info = getAccessInfo(use.access, pass.getType());
+
+		VkAttachmentDescription attachment{};
+		attachment.format = resource.desc.format;
+		attachment.samples = resource.desc.samples;
+
+		/*
+		* Only load what an earlier pass actually produced this frame, and only
+		* store what a later pass (or the presentation engine) is going to read.
+		*
+		* VK_ATTACHMENT_LOAD_OP_LOAD: Preserve the existing contents of the attachment
+		* VK_ATTACHMENT_LOAD_OP_CLEAR: Clear the values to a constant at the start
+		* VK_ATTACHMENT_LOAD_OP_DONT_CARE: Existing contents are undefined; we don't care about them
+		* VK_ATTACHMENT_STORE_OP_STORE: Rendered contents will be stored in memory and can be read later
+		* VK_ATTACHMENT_STORE_OP_DONT_CARE: Contents of the framebuffer will be undefined after the rendering operation
+		*/
+		bool load = use.access == RenderGraphAccess::ColorAttachment &&
+			!use.clear &&
+			state.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+		bool store = resource.imported || resource.lastPass > executionIndex;
+
+		if (use.clear) {
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		}
+		else if (load) {
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		}
+		else {
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		}
+		attachment.storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		attachment.initialLayout = load ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		// Let the render pass do the final transition of imported images when this is their last use
+		attachment.finalLayout = (resource.imported && resource.lastPass == executionIndex) ?
+			resource.finalLayout :
+			info.layout;
+
+		dependency.srcStageMask |= state.stages;
+		dependency.srcAccessMask |= state.writeAccess;
+		dependency.dstStageMask |= info.stages;
+		dependency.dstAccessMask |= info.access | (load ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0);
+
+		state.layout = attachment.finalLayout;
+		state.stages = info.stages;
+		state.writeAccess = info.access;
+
+		VkAttachmentReference ref{};
+		ref.attachment = static_cast<uint32_t>(attachments.size());
+		ref.layout = info.layout;
+
+		if (use.access == RenderGraphAccess::ColorAttachment) {
+			colorRefs.push_back(ref);
+			VkAttachmentReference unused{};
+			unused.attachment = VK_ATTACHMENT_UNUSED;
+			unused.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			resolveRefs.push_back(unused);
+			compiled.clearValues.push_back(use.clearValue);
+		}
+		else {
+			// Place the resolve reference in the slot of the color attachment it resolves
+			for (size_t c = 0; c < colorRefs.size(); c++) {
+				if (attachmentResources[colorRefs[c].attachment] == use.resolveSource) {
+					resolveRefs[c] = ref;
+				}
+			}
+			hasResolve = true;
+			compiled.clearValues.push_back(VkClearValue{});
+		}
+
+		attachments.push_back(attachment);
+		attachmentResources.push_back(use.resource);
+
+		if (compiled.extent.width == 0) {
+			compiled.extent = resource.desc.extent;
+		}
+		else if (compiled.extent.width != resource.desc.extent.width ||
+			compiled.extent.height != resource.desc.extent.height) {
+			throw std::runtime_error("Attachments of pass \"" + pass.getName() + "\" differ in size!");
+		}
+	}
+
+	if (attachments.empty()) {
+		throw std::runtime_error("Graphics pass \"" + pass.getName() + "\" has no attachments!");
+	}
+	compiled.renderArea = compiled.extent;
+
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+	subpass.pColorAttachments = colorRefs.data();
+	subpass.pResolveAttachments = hasResolve ? resolveRefs.data() : nullptr;
+
+	VkRenderPassCreateInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderPassInfo.pAttachments = attachments.data();
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	renderPassInfo.dependencyCount = 1;
+	renderPassInfo.pDependencies = &dependency;
+
+	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &compiled.renderPass) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create render pass for \"" + pass.getName() + "\"!");
+	}
+
+	// Passes touching the swap chain need one framebuffer per swap chain image
+	bool perImage = std::any_of(attachmentResources.begin(), attachmentResources.end(), [this](RenderGraphResource r) {
+		return resources[r].imported;
+	});
+
+	compiled.framebuffers.resize(perImage ? imageCount : 1);
+	for (uint32_t imageIndex = 0; imageIndex < compiled.framebuffers.size(); imageIndex++) {
+		std::vector<VkImageView> views;
+		for (RenderGraphResource r : attachmentResources) {
+			views.push_back(getImageView(r, imageIndex));
+		}
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = compiled.renderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+		framebufferInfo.pAttachments = views.data();
+		framebufferInfo.width = compiled.extent.width;
+		framebufferInfo.height = compiled.extent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &compiled.framebuffers[imageIndex]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create framebuffer for \"" + pass.getName() + "\"!");
+		}
+	}
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t imageIndex) const {
+	for (const auto& compiled : compiledPasses) {
+		const RenderGraphPass& pass = passes[compiled.pass];
+
+		recordBarriers(commandBuffer, compiled.barriers, imageIndex);
+
+		if (pass.getType() == RenderGraphPassType::Graphics) {
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = compiled.renderPass;
+			renderPassInfo.framebuffer = compiled.framebuffers.size() > 1 ?
+				compiled.framebuffers[imageIndex] :
+				compiled.framebuffers[0];
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = compiled.renderArea;
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(compiled.clearValues.size());
+			renderPassInfo.pClearValues = compiled.clearValues.data();
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		}
+
+		if (pass.getRecordCallback()) {
+			pass.getRecordCallback()(commandBuffer, imageIndex);
+		}
+
+		if (pass.getType() == RenderGraphPassType::Graphics) {
+			vkCmdEndRenderPass(commandBuffer);
+		}
+	}
+
+	recordBarriers(commandBuffer, finalBarriers, imageIndex);
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<ImageBarrier>& barriers, uint32_t imageIndex) const {
+	if (barriers.empty()) {
+		return;
+	}
+
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	VkPipelineStageFlags srcStages = 0;
+	VkPipelineStageFlags dstStages = 0;
+
+	for (const auto& barrier : barriers) {
+		VkImageMemoryBarrier imageBarrier{};
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrier.oldLayout = barrier.oldLayout;
+		imageBarrier.newLayout = barrier.newLayout;
+		imageBarrier.srcAccessMask = barrier.srcAccess;
+		imageBarrier.dstAccessMask = barrier.dstAccess;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = getImage(barrier.resource, imageIndex);
+		imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageBarrier.subresourceRange.baseMipLevel = 0;
+		imageBarrier.subresourceRange.levelCount = 1;
+		imageBarrier.subresourceRange.baseArrayLayer = 0;
+		imageBarrier.subresourceRange.layerCount = 1;
+		imageBarriers.push_back(imageBarrier);
+
+		srcStages |= barrier.srcStages;
+		dstStages |= barrier.dstStages;
+	}
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		srcStages,
+		dstStages,
+		0,
+		0, nullptr,
+		0, nullptr,
+		static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+void RenderGraph::reset() {
+	for (auto& compiled : compiledPasses) {
+		for (auto framebuffer : compiled.framebuffers) {
+			vkDestroyFramebuffer(device, framebuffer, nullptr);
+		}
+		vkDestroyRenderPass(device, compiled.renderPass, nullptr);
+	}
+
+	for (auto& resource : resources) {
+		if (resource.imported) {
+			continue;
+		}
+		for (auto view : resource.views) {
+			vkDestroyImageView(device, view, nullptr);
+		}
+		for (auto image : resource.images) {
+			vkDestroyImage(device, image, nullptr);
+		}
+	}
+
+	for (auto& block : memoryBlocks) {
+		if (memoryTracker != nullptr) {
+			memoryTracker->free(block.memory);
+		}
+		else {
+			vkFreeMemory(device, block.memory, nullptr);
+		}
+	}
+
+	resources.clear();
+	passes.clear();
+	outputs.clear();
+	passCulled.clear();
+	compiledPasses.clear();
+	finalBarriers.clear();
+	memoryBlocks.clear();
+	imageCount = 1;
+	transientMemorySize = 0;
+	transientMemoryRequested = 0;
+}
+
+VkRenderPass RenderGraph::getRenderPass(const std::string& passName) const {
+	int32_t pass = findPass(passName);
+	for (const auto& compiled : compiledPasses) {
+		if (compiled.pass == static_cast<uint32_t>(pass)) {
+			return compiled.renderPass;
+		}
+	}
+	return VK_NULL_HANDLE;
+}
+
+bool RenderGraph::isPassCulled(const std::string& passName) const {
+	return passCulled[findPass(passName)];
+}
+
+void RenderGraph::setRenderArea(const std::string& passName, VkExtent2D renderArea) {
+	int32_t pass = findPass(passName);
+	for (auto& compiled : compiledPasses) {
+		if (compiled.pass == static_cast<uint32_t>(pass)) {
+			compiled.renderArea.width = std::min(renderArea.width, compiled.extent.width);
+			compiled.renderArea.height = std::min(renderArea.height, compiled.extent.height);
+			return;
+		}
+	}
+	throw std::runtime_error("Render area set on render graph pass \"" + passName + "\" which was culled!");
+}
+
+VkImageView RenderGraph::getImageView(RenderGraphResource resource, uint32_t imageIndex) const {
+	const auto& views = resources[resource].views;
+	return views.size() > 1 ? views[imageIndex] : views[0];
+}
+
+VkImage RenderGraph::getImage(RenderGraphResource resource, uint32_t imageIndex) const {
+	const auto& images = resources[resource].images;
+	return images.size() > 1 ? images[imageIndex] : images[0];
+}
+
+int32_t RenderGraph::findPass(const std::string& passName) const {
+	for (size_t i = 0; i < passes.size(); i++) {
+		if (passes[i].getName() == passName) {
+			return static_cast<int32_t>(i);
+		}
+	}
+	throw std::runtime_error("Render graph has no pass named \"" + passName + "\"!");
+}
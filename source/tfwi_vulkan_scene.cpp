@@ -0,0 +1,303 @@
+#include "tfwi_vulkan_scene.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+SceneObject SceneStore::createObject(SceneObject parent, uint32_t renderHandle,
+	const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	SceneObject object = getObjectCount();
+	if (parent != SCENE_OBJECT_NONE && parent >= object) {
+		throw std::runtime_error("Scene object parent does not exist!");
+	}
+
+	glm::quat unitRotation = glm::normalize(rotation);
+	positionX.push_back(position.x);
+	positionY.push_back(position.y);
+	positionZ.push_back(position.z);
+	rotationX.push_back(unitRotation.x);
+	rotationY.push_back(unitRotation.y);
+	rotationZ.push_back(unitRotation.z);
+	rotationW.push_back(unitRotation.w);
+	scaleX.push_back(scale.x);
+	scaleY.push_back(scale.y);
+	scaleZ.push_back(scale.z);
+
+	parents.push_back(parent);
+	firstChildren.push_back(SCENE_OBJECT_NONE);
+	nextSiblings.push_back(SCENE_OBJECT_NONE);
+	if (parent != SCENE_OBJECT_NONE) {
+		nextSiblings[object] = firstChildren[parent];
+		firstChildren[parent] = object;
+	}
+
+	localMatrices.resize(localMatrices.size() + 16, 0.0f);
+	worldMatrices.resize(worldMatrices.size() + 16, 0.0f);
+
+	localCenterX.push_back(0.0f);
+	localCenterY.push_back(0.0f);
+	localCenterZ.push_back(0.0f);
+	localRadius.push_back(0.0f);
+	worldCenterX.push_back(0.0f);
+	worldCenterY.push_back(0.0f);
+	worldCenterZ.push_back(0.0f);
+	worldRadius.push_back(0.0f);
+
+	renderHandles.push_back(renderHandle);
+	worldVersions.push_back(0);
+	dirtyFlags.push_back(0);
+	markDirty(object);
+
+	return object;
+}
+
+void SceneStore::setPosition(SceneObject object, const glm::vec3& position) {
+	positionX[object] = position.x;
+	positionY[object] = position.y;
+	positionZ[object] = position.z;
+	markDirty(object);
+}
+
+void SceneStore::setRotation(SceneObject object, const glm::quat& rotation) {
+	// The kernels expect unit quaternions
+	glm::quat unitRotation = glm::normalize(rotation);
+	rotationX[object] = unitRotation.x;
+	rotationY[object] = unitRotation.y;
+	rotationZ[object] = unitRotation.z;
+	rotationW[object] = unitRotation.w;
+	markDirty(object);
+}
+
+void SceneStore::setScale(SceneObject object, const glm::vec3& scale) {
+	scaleX[object] = scale.x;
+	scaleY[object] = scale.y;
+	scaleZ[object] = scale.z;
+	markDirty(object);
+}
+
+void SceneStore::setLocalBounds(SceneObject object, const glm::vec3& center, float radius) {
+	localCenterX[object] = center.x;
+	localCenterY[object] = center.y;
+	localCenterZ[object] = center.z;
+	localRadius[object] = radius;
+	markDirty(object);
+}
+
+bool SceneStore::update(JobSystem* jobs) {
+	if (dirtyObjects.empty()) {
+		return false;
+	}
+
+	// Ascending order visits parents first, so a dirty object's parent is always up to date
+	std::sort(dirtyObjects.begin(), dirtyObjects.end());
+	composeLocalMatrices(jobs);
+
+	version++;
+	changedObjects.clear();
+	for (SceneObject object : dirtyObjects) {
+		// Already refreshed as part of a dirty ancestor's subtree
+		if (worldVersions[object] != version) {
+			updateWorld(object);
+		}
+		dirtyFlags[object] = 0;
+	}
+	dirtyObjects.clear();
+
+	// Merge the touched objects into ranges for the uploads
+	std::sort(changedObjects.begin(), changedObjects.end());
+	ChangeSet changes;
+	changes.version = version;
+	for (SceneObject object : changedObjects) {
+		if (!changes.ranges.empty() && changes.ranges.back().first + changes.ranges.back().count == object) {
+			changes.ranges.back().count++;
+		}
+		else {
+			changes.ranges.push_back({ object, 1 });
+		}
+	}
+
+	history.push_back(std::move(changes));
+	if (history.size() > maxHistory) {
+		history.pop_front();
+	}
+
+	return true;
+}
+
+const glm::mat4& SceneStore::getWorldMatrix(SceneObject object) const {
+	return *reinterpret_cast<const glm::mat4*>(&worldMatrices[static_cast<size_t>(object) * 16]);
+}
+
+BoundingSphereSoA SceneStore::getWorldBounds() const {
+	BoundingSphereSoA bounds{};
+	bounds.centerX = worldCenterX.data();
+	bounds.centerY = worldCenterY.data();
+	bounds.centerZ = worldCenterZ.data();
+	bounds.radius = worldRadius.data();
+	bounds.count = worldRadius.size();
+	return bounds;
+}
+
+void SceneStore::getChangedRanges(uint64_t sinceVersion, std::vector<SceneRange>& ranges) const {
+	if (sinceVersion >= version) {
+		return;
+	}
+
+	// The history does not reach back far enough, everything may have changed
+	if (history.empty() || history.front().version > sinceVersion + 1) {
+		ranges.push_back({ 0, getObjectCount() });
+		return;
+	}
+
+	size_t firstNew = ranges.size();
+	for (const auto& changes : history) {
+		if (changes.version > sinceVersion) {
+			ranges.insert(ranges.end(), changes.ranges.begin(), changes.ranges.end());
+		}
+	}
+
+	std::sort(ranges.begin() + firstNew, ranges.end(), [](const SceneRange& a, const SceneRange& b) {
+		return a.first < b.first;
+	});
+
+	// Merge overlapping and adjacent ranges in place
+	size_t last = firstNew;
+	for (size_t i = firstNew + 1; i < ranges.size(); i++) {
+		uint32_t end = ranges[last].first + ranges[last].count;
+		if (ranges[i].first <= end) {
+			uint32_t newEnd = std::max(end, ranges[i].first + ranges[i].count);
+			ranges[last].count = newEnd - ranges[last].first;
+		}
+		else {
+			ranges[++last] = ranges[i];
+		}
+	}
+	ranges.resize(std::min(ranges.size(), last + 1));
+}
+
+void SceneStore::markDirty(SceneObject object) {
+	if (dirtyFlags[object] == 0) {
+		dirtyFlags[object] = 1;
+		dirtyObjects.push_back(object);
+	}
+}
+
+void SceneStore::composeLocalMatrices(JobSystem* jobs) {
+	// One kernel call per run of consecutive dirty objects, long runs split into batches
+	dirtyRuns.clear();
+	size_t runStart = 0;
+	for (size_t i = 1; i <= dirtyObjects.size(); i++) {
+		if (i < dirtyObjects.size() && dirtyObjects[i] == dirtyObjects[i - 1] + 1) {
+			continue;
+		}
+
+		for (size_t first = runStart; first < i; first += composeBatchSize) {
+			uint32_t count = static_cast<uint32_t>(std::min(i - first, static_cast<size_t>(composeBatchSize)));
+			dirtyRuns.push_back({ dirtyObjects[first], count });
+		}
+		runStart = i;
+	}
+
+	// Every run writes its own objects' matrices
+	auto composeRuns = [this](uint32_t firstRun, uint32_t lastRun) {
+		const TransformKernels& kernels = getTransformKernels();
+		for (uint32_t run = firstRun; run < lastRun; run++) {
+			size_t first = dirtyRuns[run].first;
+			TransformSoA transforms{};
+			transforms.positionX = positionX.data() + first;
+			transforms.positionY = positionY.data() + first;
+			transforms.positionZ = positionZ.data() + first;
+			transforms.rotationX = rotationX.data() + first;
+			transforms.rotationY = rotationY.data() + first;
+			transforms.rotationZ = rotationZ.data() + first;
+			transforms.rotationW = rotationW.data() + first;
+			transforms.scaleX = scaleX.data() + first;
+			transforms.scaleY = scaleY.data() + first;
+			transforms.scaleZ = scaleZ.data() + first;
+			transforms.count = dirtyRuns[run].count;
+			kernels.composeTransforms(transforms, &localMatrices[first * 16]);
+		}
+	};
+
+	uint32_t runCount = static_cast<uint32_t>(dirtyRuns.size());
+	if (jobs != nullptr) {
+		jobs->parallelFor(runCount, 1, composeRuns);
+	}
+	else {
+		composeRuns(0, runCount);
+	}
+}
+
+void SceneStore::updateWorld(SceneObject object) {
+	stack.clear();
+	stack.push_back(object);
+
+	while (!stack.empty()) {
+		SceneObject current = stack.back();
+		stack.pop_back();
+
+		const glm::mat4& local = *reinterpret_cast<const glm::mat4*>(&localMatrices[static_cast<size_t>(current) * 16]);
+		glm::mat4& world = *reinterpret_cast<glm::mat4*>(&worldMatrices[static_cast<size_t>(current) * 16]);
+		SceneObject parent = parents[current];
+		world = parent == SCENE_OBJECT_NONE ? local : getWorldMatrix(parent) * local;
+
+		glm::vec4 center = world * glm::vec4(localCenterX[current], localCenterY[current], localCenterZ[current], 1.0f);
+		float maxScale = std::max(glm::length(glm::vec3(world[0])),
+			std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+		worldCenterX[current] = center.x;
+		worldCenterY[current] = center.y;
+		worldCenterZ[current] = center.z;
+		worldRadius[current] = localRadius[current] * maxScale;
+
+		worldVersions[current] = version;
+		changedObjects.push_back(current);
+
+		for (SceneObject child = firstChildren[current]; child != SCENE_OBJECT_NONE; child = nextSiblings[child]) {
+			stack.push_back(child);
+		}
+	}
+}
+
+void SceneCamera::setLookAt(const glm::vec3& eye, const glm::vec3& center, const glm::vec3& up) {
+	if (eye == this->eye && center == this->center && up == this->up) {
+		return;
+	}
+
+	this->eye = eye;
+	this->center = center;
+	this->up = up;
+	viewDirty = true;
+	version++;
+}
+
+void SceneCamera::setPerspective(float fovY, float aspect, float nearPlane, float farPlane) {
+	if (fovY == this->fovY && aspect == this->aspect && nearPlane == this->nearPlane && farPlane == this->farPlane) {
+		return;
+	}
+
+	this->fovY = fovY;
+	this->aspect = aspect;
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+	projectionDirty = true;
+	version++;
+}
+
+const glm::mat4& SceneCamera::getView() {
+	if (viewDirty) {
+		view = glm::lookAt(eye, center, up);
+		viewDirty = false;
+	}
+	return view;
+}
+
+const glm::mat4& SceneCamera::getProjection() {
+	if (projectionDirty) {
+		projection = glm::perspective(fovY, aspect, nearPlane, farPlane);
+		// Invert the y-axis by negating the y-scale factor in the projection matrix
+		projection[1][1] *= -1;
+		projectionDirty = false;
+	}
+	return projection;
+}
@@ -0,0 +1,237 @@
+#include "tfwi_vulkan_settings.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+	const char* requireValue(int argc, char** argv, int& i) {
+		if (i + 1 >= argc) {
+			throw std::runtime_error("Missing value for option " + std::string(argv[i]) + "!\n" + getCommandLineUsage());
+		}
+		return argv[++i];
+	}
+
+	uint32_t parseUnsigned(const std::string& option, const std::string& value) {
+		try {
+			// stoull accepts a sign and negates, "-1" would wrap around to the maximum
+			if (value.find('-') != std::string::npos) {
+				throw std::invalid_argument(value);
+			}
+			size_t consumed = 0;
+			unsigned long long parsed = std::stoull(value, &consumed);
+			if (consumed != value.size() || parsed > UINT32_MAX) {
+				throw std::out_of_range(value);
+			}
+			return static_cast<uint32_t>(parsed);
+		}
+		catch (const std::logic_error&) {
+			throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + "!");
+		}
+	}
+
+	float parseFloat(const std::string& option, const std::string& value) {
+		try {
+			size_t consumed = 0;
+			float parsed = std::stof(value, &consumed);
+			// stof accepts "nan" and "inf", NaN would slip past every range check of the options
+			if (consumed != value.size() || !std::isfinite(parsed)) {
+				throw std::invalid_argument(value);
+			}
+			return parsed;
+		}
+		catch (const std::logic_error&) {
+			throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + "!");
+		}
+	}
+
+	// Validation layers print ids as hex ("0x..."), but they are signed 32 bit values
+	int32_t parseMessageId(const std::string& option, const std::string& value) {
+		try {
+			size_t consumed = 0;
+			long long parsed = std::stoll(value, &consumed, 0);
+			if (consumed != value.size() || parsed < INT32_MIN || parsed > UINT32_MAX) {
+				throw std::invalid_argument(value);
+			}
+			return static_cast<int32_t>(static_cast<uint32_t>(parsed));
+		}
+		catch (const std::logic_error&) {
+			throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + "!");
+		}
+	}
+}
+
+ApplicationSettings parseCommandLine(int argc, char** argv) {
+	ApplicationSettings settings{};
+
+	for (int i = 1; i < argc; i++) {
+		std::string option(argv[i]);
+
+		if (option == "--msaa") {
+			settings.msaaSamples = parseUnsigned(option, requireValue(argc, argv, i));
+			if (settings.msaaSamples == 0 || (settings.msaaSamples & (settings.msaaSamples - 1)) != 0) {
+				throw std::runtime_error("MSAA sample count must be a power of two!");
+			}
+		}
+		else if (option == "--frames-in-flight") {
+			settings.framesInFlight = parseUnsigned(option, requireValue(argc, argv, i));
+			if (settings.framesInFlight == 0) {
+				throw std::runtime_error("At least one frame has to be in flight!");
+			}
+		}
+		else if (option == "--present-mode") {
+			std::string mode(requireValue(argc, argv, i));
+			if (mode == "mailbox") {
+				settings.presentMode = PresentModeSetting::Mailbox;
+			}
+			else if (mode == "fifo") {
+				settings.presentMode = PresentModeSetting::Fifo;
+			}
+			else if (mode == "fifo-relaxed") {
+				settings.presentMode = PresentModeSetting::FifoRelaxed;
+			}
+			else if (mode == "immediate") {
+				settings.presentMode = PresentModeSetting::Immediate;
+			}
+			else {
+				throw std::runtime_error("Invalid value \"" + mode + "\" for option " + option + "!");
+			}
+		}
+		else if (option == "--low-latency") {
+			settings.lowLatency = true;
+		}
+		else if (option == "--device") {
+			settings.device = requireValue(argc, argv, i);
+		}
+		else if (option == "--verbose") {
+			settings.verbose = true;
+		}
+		else if (option == "--init-threads") {
+			settings.initThreads = parseUnsigned(option, requireValue(argc, argv, i));
+		}
+		else if (option == "--job-threads") {
+			settings.jobThreads = parseUnsigned(option, requireValue(argc, argv, i));
+		}
+		else if (option == "--shader-dir") {
+			settings.shaderDirectory = requireValue(argc, argv, i);
+		}
+		else if (option == "--log-level") {
+			std::string level(requireValue(argc, argv, i));
+			if (level == "verbose") {
+				settings.logLevel = LogSeverity::Verbose;
+			}
+			else if (level == "info") {
+				settings.logLevel = LogSeverity::Info;
+			}
+			else if (level == "warning") {
+				settings.logLevel = LogSeverity::Warning;
+			}
+			else if (level == "error") {
+				settings.logLevel = LogSeverity::Error;
+			}
+			else {
+				throw std::runtime_error("Invalid value \"" + level + "\" for option " + option + "!");
+			}
+		}
+		else if (option == "--mute-message") {
+			settings.mutedMessageIds.push_back(parseMessageId(option, requireValue(argc, argv, i)));
+		}
+		else if (option == "--log-rate-limit") {
+			settings.logRateLimit = parseUnsigned(option, requireValue(argc, argv, i));
+		}
+		else if (option == "--capture") {
+			settings.captureFile = requireValue(argc, argv, i);
+		}
+		else if (option == "--replay") {
+			settings.replayFile = requireValue(argc, argv, i);
+		}
+		else if (option == "--fixed-timestep") {
+			settings.fixedTimestepRate = parseUnsigned(option, requireValue(argc, argv, i));
+		}
+		else if (option == "--dynamic-resolution") {
+			settings.dynamicResolutionTarget = parseFloat(option, requireValue(argc, argv, i));
+			if (settings.dynamicResolutionTarget < 0.0f) {
+				throw std::runtime_error("Dynamic resolution target frame time can't be negative!");
+			}
+		}
+		else if (option == "--min-render-scale") {
+			settings.minRenderScale = parseUnsigned(option, requireValue(argc, argv, i));
+			if (settings.minRenderScale < 10 || settings.minRenderScale > 100) {
+				throw std::runtime_error("Minimum render scale must be between 10 and 100 percent!");
+			}
+		}
+		else if (option == "--record") {
+			settings.recordPath = requireValue(argc, argv, i);
+		}
+		else if (option == "--record-format") {
+			std::string format(requireValue(argc, argv, i));
+			if (format == "raw") {
+				settings.recordFormat = RecordingFormat::Raw;
+			}
+			else if (format == "png") {
+				settings.recordFormat = RecordingFormat::Png;
+			}
+			else {
+				throw std::runtime_error("Invalid value \"" + format + "\" for option " + option + "!");
+			}
+		}
+		else if (option == "--on-demand") {
+			settings.onDemand = true;
+		}
+		else if (option == "--max-fps") {
+			settings.maxFrameRate = parseUnsigned(option, requireValue(argc, argv, i));
+		}
+		else if (option == "--refresh-interval") {
+			settings.refreshInterval = parseUnsigned(option, requireValue(argc, argv, i));
+		}
+		else if (option == "--lod-threshold") {
+			settings.lodThreshold = parseFloat(option, requireValue(argc, argv, i));
+			if (settings.lodThreshold < 0.0f) {
+				throw std::runtime_error("LOD threshold can't be negative!");
+			}
+		}
+		else if (option == "--windows") {
+			settings.windowCount = parseUnsigned(option, requireValue(argc, argv, i));
+			if (settings.windowCount < 1 || settings.windowCount > 8) {
+				throw std::runtime_error("Window count must be between 1 and 8!");
+			}
+		}
+		else {
+			throw std::runtime_error("Unknown option " + option + "!\n" + getCommandLineUsage());
+		}
+	}
+
+	if (!settings.captureFile.empty() && !settings.replayFile.empty()) {
+		throw std::runtime_error("--capture and --replay can't be combined!");
+	}
+
+	return settings;
+}
+
+std::string getCommandLineUsage() {
+	return
+		"Usage: LearnVulkan [options]\n"
+		"\t--msaa <samples>\tMSAA sample count (1, 2, 4, 8...), capped by the device\n"
+		"\t--frames-in-flight <n>\tFrames the CPU may queue ahead of the GPU (default 2)\n"
+		"\t--present-mode <mode>\tmailbox (default), fifo, fifo-relaxed or immediate\n"
+		"\t--low-latency\t\tDelay frame starts to sample input as late as possible\n"
+		"\t--device <index|name>\tGPU to use instead of the best scoring one\n"
+		"\t--verbose\t\tList every extension and layer during startup\n"
+		"\t--init-threads <n>\tThreads for the startup steps (default 0: one per core, up to 4)\n"
+		"\t--job-threads <n>\tThreads for the per-frame jobs (default 0: one per core)\n"
+		"\t--shader-dir <dir>\tLoad the .spv files from <dir> instead of the embedded shaders\n"
+		"\t--log-level <level>\tverbose, info, warning (default) or error\n"
+		"\t--mute-message <id>\tDrop validation messages with this id (repeatable)\n"
+		"\t--log-rate-limit <n>\tCopies of one message written per second (default 5, 0 for all)\n"
+		"\t--capture <file>\tRecord the inputs of every frame\n"
+		"\t--replay <file>\t\tRender the frames of a capture, then exit\n"
+		"\t--fixed-timestep <hz>\tAdvance live frames by 1/hz seconds instead of the clock\n"
+		"\t--dynamic-resolution <ms>\tScale the render resolution to hold this GPU frame time\n"
+		"\t--min-render-scale <percent>\tLowest dynamic resolution scale (default 50)\n"
+		"\t--record <path>\t\tWrite every presented frame to a file (or files with --record-format png)\n"
+		"\t--record-format <format>\traw (default, one video file) or png (one file per frame)\n"
+		"\t--windows <n>\t\tRender the scene into n windows (default 1)\n"
+		"\t--on-demand\t\tOnly redraw after input, resizes or scene changes\n"
+		"\t--max-fps <hz>\t\tCap the frame rate (default 0, uncapped)\n"
+		"\t--refresh-interval <ms>\tWith --on-demand, redraw at least this often\n"
+		"\t--lod-threshold <px>\tScreen space error allowed for mesh LODs (default 1, 0 for full detail)\n";
+}
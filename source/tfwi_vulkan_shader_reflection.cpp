@@ -0,0 +1,435 @@
+#include "tfwi_vulkan_shader_reflection.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+// The few parts of the SPIR-V specification the reflection needs
+namespace spirv {
+	const uint32_t magicNumber = 0x07230203;
+	const uint32_t headerWordCount = 5;
+
+	enum Op : uint32_t {
+		OpName = 5,
+		OpEntryPoint = 15,
+		OpTypeBool = 20,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpSpecConstantTrue = 48,
+		OpSpecConstantFalse = 49,
+		OpSpecConstant = 50,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72
+	};
+
+	enum ExecutionModel : uint32_t {
+		Vertex = 0,
+		TessellationControl = 1,
+		TessellationEvaluation = 2,
+		Geometry = 3,
+		Fragment = 4,
+		GLCompute = 5
+	};
+
+	enum Decoration : uint32_t {
+		SpecId = 1,
+		Block = 2,
+		BufferBlock = 3,
+		ArrayStride = 6,
+		MatrixStride = 7,
+		BuiltIn = 11,
+		Location = 30,
+		Binding = 33,
+		DescriptorSet = 34,
+		Offset = 35
+	};
+
+	enum StorageClass : uint32_t {
+		UniformConstant = 0,
+		Input = 1,
+		Uniform = 2,
+		PushConstant = 9,
+		StorageBuffer = 12
+	};
+
+	enum Dim : uint32_t {
+		DimBuffer = 5,
+		DimSubpassData = 6
+	};
+}
+
+ShaderReflection::ShaderReflection(ShaderBinary binary) {
+	parse(binary);
+	reflectVariables();
+
+	names.clear();
+	decorations.clear();
+	types.clear();
+	constants.clear();
+	variables.clear();
+	specConstants.clear();
+}
+
+void ShaderReflection::checkVertexAttributes(const VkVertexInputAttributeDescription* attributes, uint32_t attributeCount) const {
+	for (const auto& input : vertexInputs) {
+		const VkVertexInputAttributeDescription* attribute = nullptr;
+		for (uint32_t i = 0; i < attributeCount; i++) {
+			if (attributes[i].location == input.location) {
+				attribute = &attributes[i];
+			}
+		}
+
+		if (attribute == nullptr) {
+			throw std::runtime_error("No vertex attribute feeds shader input \"" + input.name + "\" at location " + std::to_string(input.location) + "!");
+		}
+		if (attribute->format != input.format) {
+			throw std::runtime_error("The vertex attribute at location " + std::to_string(input.location) + " does not have the format of shader input \"" + input.name + "\"!");
+		}
+	}
+}
+
+void ShaderReflection::parse(ShaderBinary binary) {
+	const uint32_t* code = binary.code;
+	size_t wordCount = binary.size / sizeof(uint32_t);
+	if (code == nullptr || wordCount < spirv::headerWordCount || code[0] != spirv::magicNumber) {
+		throw std::runtime_error("Can't reflect a shader which is not SPIR-V!");
+	}
+
+	bool foundEntryPoint = false;
+	size_t position = spirv::headerWordCount;
+	while (position < wordCount) {
+		uint32_t instructionWordCount = code[position] >> 16;
+		uint32_t opcode = code[position] & 0xffff;
+		if (instructionWordCount == 0 || position + instructionWordCount > wordCount) {
+			throw std::runtime_error("Malformed SPIR-V instruction stream!");
+		}
+		const uint32_t* operands = code + position + 1;
+		uint32_t operandCount = instructionWordCount - 1;
+
+		switch (opcode) {
+		case spirv::OpName:
+			names[operands[0]] = reinterpret_cast<const char*>(operands + 1);
+			break;
+		case spirv::OpEntryPoint:
+			if (!foundEntryPoint) {
+				switch (operands[0]) {
+				case spirv::Vertex: stage = VK_SHADER_STAGE_VERTEX_BIT; break;
+				case spirv::TessellationControl: stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; break;
+				case spirv::TessellationEvaluation: stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; break;
+				case spirv::Geometry: stage = VK_SHADER_STAGE_GEOMETRY_BIT; break;
+				case spirv::Fragment: stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
+				case spirv::GLCompute: stage = VK_SHADER_STAGE_COMPUTE_BIT; break;
+				default:
+					throw std::runtime_error("Unsupported shader execution model!");
+				}
+				entryPoint = reinterpret_cast<const char*>(operands + 2);
+				foundEntryPoint = true;
+			}
+			break;
+		case spirv::OpDecorate: {
+			Decorations& target = decorations[operands[0]];
+			uint32_t literal = operandCount > 2 ? operands[2] : 0;
+			switch (operands[1]) {
+			case spirv::SpecId: target.specId = literal; break;
+			case spirv::Block: target.block = true; break;
+			case spirv::BufferBlock: target.bufferBlock = true; break;
+			case spirv::ArrayStride: target.arrayStride = literal; break;
+			case spirv::BuiltIn: target.builtIn = true; break;
+			case spirv::Location: target.location = literal; break;
+			case spirv::Binding: target.binding = literal; break;
+			case spirv::DescriptorSet: target.set = literal; break;
+			}
+			break;
+		}
+		case spirv::OpMemberDecorate: {
+			Decorations& target = decorations[operands[0]];
+			uint32_t member = operands[1];
+			uint32_t literal = operandCount > 3 ? operands[3] : 0;
+			if (target.memberOffsets.size() <= member) {
+				target.memberOffsets.resize(member + 1, 0);
+				target.memberMatrixStrides.resize(member + 1, 0);
+			}
+			if (operands[2] == spirv::Offset) {
+				target.memberOffsets[member] = literal;
+			}
+			else if (operands[2] == spirv::MatrixStride) {
+				target.memberMatrixStrides[member] = literal;
+			}
+			break;
+		}
+		case spirv::OpTypeBool:
+		case spirv::OpTypeSampler:
+			types[operands[0]].opcode = opcode;
+			break;
+		case spirv::OpTypeInt:
+		case spirv::OpTypeFloat: {
+			Type& type = types[operands[0]];
+			type.opcode = opcode;
+			type.width = operands[1];
+			type.flags = opcode == spirv::OpTypeInt ? operands[2] : 1;
+			break;
+		}
+		case spirv::OpTypeVector:
+		case spirv::OpTypeMatrix: {
+			Type& type = types[operands[0]];
+			type.opcode = opcode;
+			type.elementType = operands[1];
+			type.count = operands[2];
+			break;
+		}
+		case spirv::OpTypeImage: {
+			Type& type = types[operands[0]];
+			type.opcode = opcode;
+			type.elementType = operands[1];
+			type.width = operands[2];
+			type.flags = operands[6];
+			break;
+		}
+		case spirv::OpTypeSampledImage:
+		case spirv::OpTypeRuntimeArray: {
+			Type& type = types[operands[0]];
+			type.opcode = opcode;
+			type.elementType = operands[1];
+			type.count = 0;
+			break;
+		}
+		case spirv::OpTypeArray: {
+			Type& type = types[operands[0]];
+			type.opcode = opcode;
+			type.elementType = operands[1];
+			// The length is the id of a constant, which always comes first
+			auto length = constants.find(operands[2]);
+			if (length == constants.end()) {
+				throw std::runtime_error("Arrays sized by specialization constants can't be reflected!");
+			}
+			type.count = length->second;
+			break;
+		}
+		case spirv::OpTypeStruct: {
+			Type& type = types[operands[0]];
+			type.opcode = opcode;
+			type.members.assign(operands + 1, operands + operandCount);
+			break;
+		}
+		case spirv::OpTypePointer: {
+			Type& type = types[operands[0]];
+			type.opcode = opcode;
+			type.flags = operands[1];
+			type.elementType = operands[2];
+			break;
+		}
+		case spirv::OpConstant:
+			// Only 32 bit constants can be array lengths
+			constants[operands[1]] = operands[2];
+			break;
+		case spirv::OpSpecConstantTrue:
+		case spirv::OpSpecConstantFalse:
+		case spirv::OpSpecConstant:
+			specConstants.push_back({ operands[1], operands[0] });
+			break;
+		case spirv::OpVariable:
+			variables.push_back({ operands[1], operands[0], operands[2] });
+			break;
+		}
+
+		position += instructionWordCount;
+	}
+
+	if (!foundEntryPoint) {
+		throw std::runtime_error("SPIR-V module has no entry point!");
+	}
+}
+
+void ShaderReflection::reflectVariables() {
+	for (const auto& variable : variables) {
+		const Decorations* variableDecorations = findDecorations(variable.id);
+		uint32_t typeId = getType(variable.pointerType).elementType;
+		const Type& type = getType(typeId);
+
+		switch (variable.storageClass) {
+		case spirv::Input:
+			if (stage != VK_SHADER_STAGE_VERTEX_BIT || variableDecorations == nullptr ||
+				variableDecorations->builtIn || variableDecorations->location == UINT32_MAX) {
+				break;
+			}
+			vertexInputs.push_back({ variableDecorations->location, getVertexFormat(type), getName(variable.id) });
+			break;
+		case spirv::UniformConstant:
+		case spirv::Uniform:
+		case spirv::StorageBuffer: {
+			if (variableDecorations == nullptr || variableDecorations->binding == UINT32_MAX) {
+				break;
+			}
+
+			ShaderDescriptorBinding binding{};
+			binding.set = variableDecorations->set;
+			binding.binding = variableDecorations->binding;
+			binding.count = 1;
+			binding.stageFlags = stage;
+
+			// Arrays of descriptors
+			uint32_t elementTypeId = typeId;
+			while (getType(elementTypeId).opcode == spirv::OpTypeArray || getType(elementTypeId).opcode == spirv::OpTypeRuntimeArray) {
+				const Type& array = getType(elementTypeId);
+				if (array.opcode == spirv::OpTypeRuntimeArray) {
+					throw std::runtime_error("Unbounded descriptor arrays (\"" + getName(variable.id) + "\") are not supported!");
+				}
+				binding.count *= array.count;
+				elementTypeId = array.elementType;
+			}
+
+			binding.type = getDescriptorType(getType(elementTypeId), variable.storageClass, elementTypeId);
+			// Blocks are usually only named by their type
+			binding.name = getName(variable.id);
+			if (binding.name.empty()) {
+				binding.name = getName(elementTypeId);
+			}
+			descriptorBindings.push_back(binding);
+			break;
+		}
+		case spirv::PushConstant:
+			pushConstantRange.stageFlags = stage;
+			pushConstantRange.offset = 0;
+			pushConstantRange.size = getTypeSize(typeId, 0);
+			break;
+		}
+	}
+
+	for (const auto& specConstant : specConstants) {
+		const Decorations* constantDecorations = findDecorations(specConstant.first);
+		if (constantDecorations == nullptr || constantDecorations->specId == UINT32_MAX) {
+			continue;
+		}
+
+		const Type& type = getType(specConstant.second);
+		uint32_t size = type.opcode == spirv::OpTypeBool ? static_cast<uint32_t>(sizeof(VkBool32)) : type.width / 8;
+		specializationConstants.push_back({ constantDecorations->specId, size, getName(specConstant.first) });
+	}
+
+	std::sort(vertexInputs.begin(), vertexInputs.end(), [](const ShaderVertexInput& a, const ShaderVertexInput& b) {
+		return a.location < b.location;
+	});
+	std::sort(descriptorBindings.begin(), descriptorBindings.end(), [](const ShaderDescriptorBinding& a, const ShaderDescriptorBinding& b) {
+		return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+	});
+	std::sort(specializationConstants.begin(), specializationConstants.end(), [](const ShaderSpecializationConstant& a, const ShaderSpecializationConstant& b) {
+		return a.constantId < b.constantId;
+	});
+}
+
+const ShaderReflection::Type& ShaderReflection::getType(uint32_t id) const {
+	auto type = types.find(id);
+	if (type == types.end()) {
+		throw std::runtime_error("SPIR-V references an unknown type!");
+	}
+	return type->second;
+}
+
+const ShaderReflection::Decorations* ShaderReflection::findDecorations(uint32_t id) const {
+	auto found = decorations.find(id);
+	return found != decorations.end() ? &found->second : nullptr;
+}
+
+std::string ShaderReflection::getName(uint32_t id) const {
+	auto name = names.find(id);
+	return name != names.end() ? name->second : std::string();
+}
+
+VkDescriptorType ShaderReflection::getDescriptorType(const Type& type, uint32_t storageClass, uint32_t typeId) const {
+	if (storageClass == spirv::StorageBuffer) {
+		return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	}
+
+	if (storageClass == spirv::Uniform) {
+		// Before SPIR-V 1.3, storage buffers were uniform blocks decorated BufferBlock
+		const Decorations* blockDecorations = findDecorations(typeId);
+		if (blockDecorations != nullptr && blockDecorations->bufferBlock) {
+			return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}
+		return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	}
+
+	switch (type.opcode) {
+	case spirv::OpTypeSampler:
+		return VK_DESCRIPTOR_TYPE_SAMPLER;
+	case spirv::OpTypeSampledImage:
+		return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	case spirv::OpTypeImage:
+		// "sampled" is 1 for images used with a sampler, 2 for storage images
+		if (type.width == spirv::DimBuffer) {
+			return type.flags == 1 ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+		}
+		if (type.width == spirv::DimSubpassData) {
+			return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		}
+		return type.flags == 1 ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	default:
+		throw std::runtime_error("Unsupported descriptor type in SPIR-V!");
+	}
+}
+
+VkFormat ShaderReflection::getVertexFormat(const Type& type) const {
+	const Type& component = type.opcode == spirv::OpTypeVector ? getType(type.elementType) : type;
+	uint32_t componentCount = type.opcode == spirv::OpTypeVector ? type.count : 1;
+	if ((component.opcode != spirv::OpTypeFloat && component.opcode != spirv::OpTypeInt) ||
+		component.width != 32 || componentCount < 1 || componentCount > 4) {
+		throw std::runtime_error("Only 32 bit scalar and vector vertex inputs are supported!");
+	}
+
+	static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+	static const VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+	static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+	if (component.opcode == spirv::OpTypeFloat) {
+		return floatFormats[componentCount - 1];
+	}
+	return component.flags != 0 ? intFormats[componentCount - 1] : uintFormats[componentCount - 1];
+}
+
+uint32_t ShaderReflection::getTypeSize(uint32_t typeId, uint32_t matrixStride) const {
+	const Type& type = getType(typeId);
+	switch (type.opcode) {
+	case spirv::OpTypeBool:
+		return 4;
+	case spirv::OpTypeInt:
+	case spirv::OpTypeFloat:
+		return type.width / 8;
+	case spirv::OpTypeVector:
+		return type.count * getTypeSize(type.elementType, 0);
+	case spirv::OpTypeMatrix:
+		return type.count * (matrixStride > 0 ? matrixStride : getTypeSize(type.elementType, 0));
+	case spirv::OpTypeArray: {
+		const Decorations* arrayDecorations = findDecorations(typeId);
+		uint32_t stride = arrayDecorations != nullptr && arrayDecorations->arrayStride > 0
+			? arrayDecorations->arrayStride : getTypeSize(type.elementType, matrixStride);
+		return type.count * stride;
+	}
+	case spirv::OpTypeStruct: {
+		// Explicit layout: the end of the member reaching furthest
+		const Decorations* structDecorations = findDecorations(typeId);
+		uint32_t size = 0;
+		for (size_t i = 0; i < type.members.size(); i++) {
+			uint32_t offset = 0;
+			uint32_t memberMatrixStride = 0;
+			if (structDecorations != nullptr && i < structDecorations->memberOffsets.size()) {
+				offset = structDecorations->memberOffsets[i];
+				memberMatrixStride = structDecorations->memberMatrixStrides[i];
+			}
+			size = std::max(size, offset + getTypeSize(type.members[i], memberMatrixStride));
+		}
+		return size;
+	}
+	default:
+		throw std::runtime_error("Can't compute the size of an opaque SPIR-V type!");
+	}
+}
@@ -0,0 +1,76 @@
+#include "tfwi_vulkan_shaders.hpp"
+
+#include <fstream>
+#include <stdexcept>
+
+// First word of every SPIR-V module, in the host's byte order
+static const uint32_t spirvMagicNumber = 0x07230203;
+
+void ShaderLibrary::load(const std::vector<std::string>& names, const std::string& looseDirectory) {
+	size_t embeddedCount = 0;
+	const EmbeddedShader* embeddedShaders = getEmbeddedShaders(embeddedCount);
+
+	binaries.clear();
+	files.clear();
+	embedded = looseDirectory.empty() && embeddedCount > 0;
+
+	for (const auto& name : names) {
+		ShaderBinary binary{};
+		if (embedded) {
+			for (size_t i = 0; i < embeddedCount; i++) {
+				if (name == embeddedShaders[i].name) {
+					binary.code = embeddedShaders[i].code;
+					binary.size = embeddedShaders[i].wordCount * sizeof(uint32_t);
+				}
+			}
+			if (binary.code == nullptr) {
+				throw std::runtime_error("Shader \"" + name + "\" is not embedded in the executable!");
+			}
+		}
+		else {
+			std::string directory = looseDirectory.empty() ? "shaders" : looseDirectory;
+			std::vector<uint32_t>& words = files[name];
+			words = readFile(directory + "/" + name);
+			binary.code = words.data();
+			binary.size = words.size() * sizeof(uint32_t);
+		}
+
+		validate(name, binary);
+		binaries[name] = binary;
+	}
+}
+
+ShaderBinary ShaderLibrary::get(const std::string& name) const {
+	auto binary = binaries.find(name);
+	if (binary == binaries.end()) {
+		throw std::runtime_error("Shader \"" + name + "\" was not loaded!");
+	}
+	return binary->second;
+}
+
+std::vector<uint32_t> ShaderLibrary::readFile(const std::string& filename) {
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open file:\n\"" + filename + "\"!");
+	}
+
+	size_t fileSize = (size_t)file.tellg();
+	if (fileSize % sizeof(uint32_t) != 0) {
+		throw std::runtime_error("\"" + filename + "\" is not SPIR-V, its size is not a multiple of 4 bytes!");
+	}
+
+	// Read straight into words, SPIR-V has to be 4 byte aligned
+	std::vector<uint32_t> words(fileSize / sizeof(uint32_t));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(words.data()), fileSize);
+	file.close();
+
+	return words;
+}
+
+void ShaderLibrary::validate(const std::string& name, const ShaderBinary& binary) {
+	if (binary.size < 5 * sizeof(uint32_t) || binary.code[0] != spirvMagicNumber) {
+		throw std::runtime_error("Shader \"" + name + "\" is not SPIR-V (or has the wrong byte order)!");
+	}
+}
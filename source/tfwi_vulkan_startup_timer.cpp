@@ -0,0 +1,34 @@
+#include "tfwi_vulkan_startup_timer.hpp"
+
+namespace {
+	double toMilliseconds(StartupTimer::Clock::duration duration) {
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+}
+
+void StartupTimer::record(const char* name, Clock::time_point begin, Clock::time_point end) {
+	Step step{};
+	step.name = name;
+	step.begin = begin - start;
+	step.duration = end - begin;
+
+	std::lock_guard<std::mutex> lock(stepsMutex);
+	steps.push_back(step);
+}
+
+void StartupTimer::report(std::ostream& out) const {
+	out << "Startup time breakdown (start offset, duration):\n";
+
+	std::lock_guard<std::mutex> lock(stepsMutex);
+	Clock::duration total = Clock::duration::zero();
+	for (const auto& step : steps) {
+		out << '\t' << step.name << ": +" << toMilliseconds(step.begin) << " ms, " << toMilliseconds(step.duration) << " ms\n";
+		total += step.duration;
+	}
+	// Larger than the wall time when steps overlapped
+	out << "\tSum of steps: " << toMilliseconds(total) << " ms\n";
+
+	if (isFirstFramePresented()) {
+		out << "Time to first frame: " << toMilliseconds(firstFrame - start) << " ms\n";
+	}
+}
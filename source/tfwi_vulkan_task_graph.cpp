@@ -0,0 +1,96 @@
+#include "tfwi_vulkan_task_graph.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+TaskGraph::TaskId TaskGraph::addTask(const std::string& name, Work work, const std::vector<TaskId>& dependencies) {
+	TaskId id = tasks.size();
+
+	for (TaskId dependency : dependencies) {
+		if (dependency >= id) {
+			throw std::runtime_error("Task \"" + name + "\" depends on a task which was not added before it!");
+		}
+		tasks[dependency].dependents.push_back(id);
+	}
+
+	Task task{};
+	task.name = name;
+	task.work = std::move(work);
+	task.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	tasks.push_back(std::move(task));
+
+	return id;
+}
+
+void TaskGraph::execute(uint32_t threadCount) {
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<TaskId> ready;
+	std::vector<uint32_t> remainingDependencies(tasks.size());
+	size_t finished = 0;
+	std::exception_ptr error;
+
+	for (TaskId id = 0; id < tasks.size(); id++) {
+		remainingDependencies[id] = tasks[id].dependencyCount;
+		if (remainingDependencies[id] == 0) {
+			ready.push_back(id);
+		}
+	}
+
+	auto worker = [&]() {
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			changed.wait(lock, [&]() { return error || finished == tasks.size() || !ready.empty(); });
+			if (error || finished == tasks.size()) {
+				return;
+			}
+
+			TaskId id = ready.front();
+			ready.pop_front();
+
+			lock.unlock();
+			std::exception_ptr taskError;
+			try {
+				tasks[id].work();
+			}
+			catch (...) {
+				taskError = std::current_exception();
+			}
+			lock.lock();
+
+			if (taskError) {
+				if (!error) {
+					error = taskError;
+				}
+			}
+			else {
+				finished++;
+				for (TaskId dependent : tasks[id].dependents) {
+					if (--remainingDependencies[dependent] == 0) {
+						ready.push_back(dependent);
+					}
+				}
+			}
+			changed.notify_all();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	uint32_t extraThreads = std::max<uint32_t>(threadCount, 1) - 1;
+	for (uint32_t i = 0; i < extraThreads; i++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
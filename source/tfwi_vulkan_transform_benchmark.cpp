@@ -0,0 +1,181 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "tfwi_vulkan_transform_kernels.hpp"
+
+/*
+* Microbenchmark for the transform kernels: composes and culls a random scene
+* with the plain glm code the renderer would otherwise use, then with every
+* SIMD level the CPU supports, and checks that all of them agree.
+*
+* Usage: TransformKernelBenchmark [object count] [iterations]
+*/
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	typedef struct Scene {
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+		std::vector<float> scaleX, scaleY, scaleZ;
+		std::vector<float> radius;
+
+		// The same data the way a glm based renderer stores it
+		std::vector<glm::vec3> positions;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+
+		TransformSoA transforms() const {
+			return { positionX.data(), positionY.data(), positionZ.data(),
+				rotationX.data(), rotationY.data(), rotationZ.data(), rotationW.data(),
+				scaleX.data(), scaleY.data(), scaleZ.data(), positionX.size() };
+		}
+
+		BoundingSphereSoA spheres() const {
+			return { positionX.data(), positionY.data(), positionZ.data(), radius.data(), positionX.size() };
+		}
+	} Scene;
+
+	Scene createScene(size_t count) {
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+		Scene scene;
+		for (size_t i = 0; i < count; i++) {
+			glm::vec3 p(position(random), position(random), position(random));
+			glm::quat q = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+			glm::vec3 s(scale(random), scale(random), scale(random));
+
+			scene.positions.push_back(p);
+			scene.rotations.push_back(q);
+			scene.scales.push_back(s);
+
+			scene.positionX.push_back(p.x);
+			scene.positionY.push_back(p.y);
+			scene.positionZ.push_back(p.z);
+			scene.rotationX.push_back(q.x);
+			scene.rotationY.push_back(q.y);
+			scene.rotationZ.push_back(q.z);
+			scene.rotationW.push_back(q.w);
+			scene.scaleX.push_back(s.x);
+			scene.scaleY.push_back(s.y);
+			scene.scaleZ.push_back(s.z);
+			scene.radius.push_back(std::max(s.x, std::max(s.y, s.z)));
+		}
+		return scene;
+	}
+
+	void composeWithGlm(const Scene& scene, std::vector<glm::mat4>& matrices) {
+		for (size_t i = 0; i < scene.positions.size(); i++) {
+			matrices[i] = glm::translate(glm::mat4(1.0f), scene.positions[i])
+				* glm::mat4_cast(scene.rotations[i])
+				* glm::scale(glm::mat4(1.0f), scene.scales[i]);
+		}
+	}
+
+	uint32_t cullWithGlm(const Scene& scene, const Frustum& frustum, std::vector<uint32_t>& visibleIndices) {
+		uint32_t visibleCount = 0;
+		for (size_t i = 0; i < scene.positions.size(); i++) {
+			bool inside = true;
+			for (const auto& plane : frustum.planes) {
+				if (glm::dot(glm::vec3(plane[0], plane[1], plane[2]), scene.positions[i]) + plane[3] < -scene.radius[i]) {
+					inside = false;
+					break;
+				}
+			}
+			if (inside) {
+				visibleIndices[visibleCount++] = static_cast<uint32_t>(i);
+			}
+		}
+		return visibleCount;
+	}
+
+	// Best of "iterations" runs, in milliseconds
+	double measure(uint32_t iterations, const std::function<void()>& body) {
+		double best = 0.0;
+		for (uint32_t i = 0; i < iterations; i++) {
+			auto start = Clock::now();
+			body();
+			double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			best = i == 0 ? elapsed : std::min(best, elapsed);
+		}
+		return best;
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	uint32_t iterations = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 50;
+	if (count == 0 || iterations == 0) {
+		std::cerr << "Usage: TransformKernelBenchmark [object count] [iterations]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Scene scene = createScene(count);
+
+	glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.2f, 0.5f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 viewProjection = proj * view;
+	Frustum frustum = extractFrustum(glm::value_ptr(viewProjection));
+
+	size_t paddedCount = (count + 7) / 8 * 8;
+	std::vector<glm::mat4> referenceMatrices(count);
+	std::vector<uint32_t> referenceVisible(paddedCount);
+	uint32_t referenceVisibleCount = 0;
+
+	std::cout << count << " objects, best of " << iterations << " iterations, detected " << getSimdLevelName(detectSimdLevel()) << "\n";
+
+	double glmCompose = measure(iterations, [&]() { composeWithGlm(scene, referenceMatrices); });
+	double glmCull = measure(iterations, [&]() { referenceVisibleCount = cullWithGlm(scene, frustum, referenceVisible); });
+	std::cout << "glm:\tcompose " << glmCompose << " ms\tcull " << glmCull << " ms\t(" << referenceVisibleCount << " visible)\n";
+
+	int status = EXIT_SUCCESS;
+	std::vector<float> matrices(count * 16);
+	std::vector<uint32_t> visible(paddedCount);
+
+	for (int level = 0; level <= static_cast<int>(detectSimdLevel()); level++) {
+		const TransformKernels& kernels = getTransformKernels(static_cast<SimdLevel>(level));
+		TransformSoA transforms = scene.transforms();
+		BoundingSphereSoA spheres = scene.spheres();
+		uint32_t visibleCount = 0;
+
+		double compose = measure(iterations, [&]() { kernels.composeTransforms(transforms, matrices.data()); });
+		double cull = measure(iterations, [&]() { visibleCount = kernels.cullSpheres(spheres, frustum, visible.data()); });
+
+		float maxError = 0.0f;
+		for (size_t i = 0; i < count; i++) {
+			const float* reference = glm::value_ptr(referenceMatrices[i]);
+			for (size_t e = 0; e < 16; e++) {
+				maxError = std::max(maxError, std::abs(reference[e] - matrices[i * 16 + e]));
+			}
+		}
+		bool cullMatches = visibleCount == referenceVisibleCount
+			&& std::equal(visible.begin(), visible.begin() + visibleCount, referenceVisible.begin());
+
+		std::cout << getSimdLevelName(kernels.level) << ":\tcompose " << compose << " ms (" << glmCompose / compose << "x)"
+			<< "\tcull " << cull << " ms (" << glmCull / cull << "x)"
+			<< "\tmax error " << maxError << (cullMatches ? "" : "\tVISIBLE LIST MISMATCH") << "\n";
+
+		if (maxError > 1e-4f || !cullMatches) {
+			status = EXIT_FAILURE;
+		}
+	}
+
+	return status;
+}
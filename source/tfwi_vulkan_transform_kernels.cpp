@@ -0,0 +1,201 @@
+#include "tfwi_vulkan_transform_kernels.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#ifdef TFWI_VULKAN_SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+	void composeTransformsScalar(const TransformSoA& transforms, float* matrices) {
+		composeTransformsScalarRange(transforms, 0, matrices);
+	}
+
+	uint32_t cullSpheresScalar(const BoundingSphereSoA& spheres, const Frustum& frustum, uint32_t* visibleIndices) {
+		return cullSpheresScalarRange(spheres, frustum, 0, visibleIndices, 0);
+	}
+
+#ifdef TFWI_VULKAN_SIMD_X86
+	void cpuid(int registers[4], int leaf, int subleaf) {
+#if defined(_MSC_VER)
+		__cpuidex(registers, leaf, subleaf);
+#else
+		unsigned int eax, ebx, ecx, edx;
+		__cpuid_count(leaf, subleaf, eax, ebx, ecx, edx);
+		registers[0] = static_cast<int>(eax);
+		registers[1] = static_cast<int>(ebx);
+		registers[2] = static_cast<int>(ecx);
+		registers[3] = static_cast<int>(edx);
+#endif
+	}
+
+	uint64_t readExtendedControlRegister() {
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+	}
+#endif
+
+	SimdLevel queryCpu() {
+#ifdef TFWI_VULKAN_SIMD_X86
+		int registers[4];
+		cpuid(registers, 0, 0);
+		int maxLeaf = registers[0];
+
+		cpuid(registers, 1, 0);
+		bool sse2 = (registers[3] >> 26) & 1;
+		bool fma = (registers[2] >> 12) & 1;
+		bool osxsave = (registers[2] >> 27) & 1;
+		bool avx = (registers[2] >> 28) & 1;
+
+		bool avx2 = false;
+		if (maxLeaf >= 7 && osxsave && avx && fma) {
+			// The CPU having AVX is not enough, the OS has to save the YMM registers on context switches
+			bool ymmStateEnabled = (readExtendedControlRegister() & 0x6) == 0x6;
+			cpuid(registers, 7, 0);
+			avx2 = ymmStateEnabled && ((registers[1] >> 5) & 1);
+		}
+
+		if (avx2) {
+			return SimdLevel::AVX2;
+		}
+		if (sse2) {
+			return SimdLevel::SSE2;
+		}
+#endif
+		return SimdLevel::Scalar;
+	}
+}
+
+void composeTransformsScalarRange(const TransformSoA& transforms, size_t first, float* matrices) {
+	for (size_t i = first; i < transforms.count; i++) {
+		float x = transforms.rotationX[i];
+		float y = transforms.rotationY[i];
+		float z = transforms.rotationZ[i];
+		float w = transforms.rotationW[i];
+
+		float xx = 2.0f * x * x, yy = 2.0f * y * y, zz = 2.0f * z * z;
+		float xy = 2.0f * x * y, xz = 2.0f * x * z, yz = 2.0f * y * z;
+		float wx = 2.0f * w * x, wy = 2.0f * w * y, wz = 2.0f * w * z;
+
+		float sx = transforms.scaleX[i];
+		float sy = transforms.scaleY[i];
+		float sz = transforms.scaleZ[i];
+
+		float* m = matrices + i * 16;
+		m[0] = (1.0f - (yy + zz)) * sx;
+		m[1] = (xy + wz) * sx;
+		m[2] = (xz - wy) * sx;
+		m[3] = 0.0f;
+		m[4] = (xy - wz) * sy;
+		m[5] = (1.0f - (xx + zz)) * sy;
+		m[6] = (yz + wx) * sy;
+		m[7] = 0.0f;
+		m[8] = (xz + wy) * sz;
+		m[9] = (yz - wx) * sz;
+		m[10] = (1.0f - (xx + yy)) * sz;
+		m[11] = 0.0f;
+		m[12] = transforms.positionX[i];
+		m[13] = transforms.positionY[i];
+		m[14] = transforms.positionZ[i];
+		m[15] = 1.0f;
+	}
+}
+
+uint32_t cullSpheresScalarRange(const BoundingSphereSoA& spheres, const Frustum& frustum, size_t first, uint32_t* visibleIndices, uint32_t visibleCount) {
+	for (size_t i = first; i < spheres.count; i++) {
+		float negativeRadius = -spheres.radius[i];
+
+		bool inside = true;
+		for (const auto& plane : frustum.planes) {
+			float distance = plane[0] * spheres.centerX[i] + plane[1] * spheres.centerY[i] + plane[2] * spheres.centerZ[i] + plane[3];
+			inside &= distance >= negativeRadius;
+		}
+
+		// Branchless compaction, the slot is simply overwritten by the next index if this one is culled
+		visibleIndices[visibleCount] = static_cast<uint32_t>(i);
+		visibleCount += inside ? 1 : 0;
+	}
+	return visibleCount;
+}
+
+SimdLevel detectSimdLevel() {
+	static const SimdLevel level = queryCpu();
+	return level;
+}
+
+const char* getSimdLevelName(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::SSE2:
+		return "SSE2";
+	case SimdLevel::AVX2:
+		return "AVX2";
+	default:
+		return "Scalar";
+	}
+}
+
+const TransformKernels& getTransformKernels() {
+	return getTransformKernels(detectSimdLevel());
+}
+
+const TransformKernels& getTransformKernels(SimdLevel level) {
+	if (static_cast<int>(level) > static_cast<int>(detectSimdLevel())) {
+		throw std::runtime_error(std::string("The CPU does not support ") + getSimdLevelName(level) + "!");
+	}
+
+	static const TransformKernels scalarKernels = { SimdLevel::Scalar, composeTransformsScalar, cullSpheresScalar };
+#ifdef TFWI_VULKAN_SIMD_X86
+	static const TransformKernels sse2Kernels = { SimdLevel::SSE2, composeTransformsSSE2, cullSpheresSSE2 };
+	static const TransformKernels avx2Kernels = { SimdLevel::AVX2, composeTransformsAVX2, cullSpheresAVX2 };
+
+	switch (level) {
+	case SimdLevel::SSE2:
+		return sse2Kernels;
+	case SimdLevel::AVX2:
+		return avx2Kernels;
+	default:
+		break;
+	}
+#endif
+	return scalarKernels;
+}
+
+Frustum extractFrustum(const float* viewProjection) {
+	// Row r of the column-major matrix
+	auto row = [viewProjection](int r, int column) { return viewProjection[column * 4 + r]; };
+
+	/*
+	* Gribb/Hartmann: a clip space point is inside when -w <= x <= w,
+	* -w <= y <= w and 0 <= z <= w (Vulkan depth range).
+	*/
+	Frustum frustum{};
+	for (int column = 0; column < 4; column++) {
+		frustum.planes[0][column] = row(3, column) + row(0, column);	// Left
+		frustum.planes[1][column] = row(3, column) - row(0, column);	// Right
+		frustum.planes[2][column] = row(3, column) + row(1, column);	// Bottom
+		frustum.planes[3][column] = row(3, column) - row(1, column);	// Top
+		frustum.planes[4][column] = row(2, column);					// Near
+		frustum.planes[5][column] = row(3, column) - row(2, column);	// Far
+	}
+
+	// Normalized, so plane distances compare directly against radii
+	for (auto& plane : frustum.planes) {
+		float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		for (float& component : plane) {
+			component /= length;
+		}
+	}
+
+	return frustum;
+}
@@ -0,0 +1,170 @@
+#include "tfwi_vulkan_transform_kernels.hpp"
+
+#ifdef TFWI_VULKAN_SIMD_X86
+#include <immintrin.h>
+
+/*
+* This file is compiled with AVX2 and FMA enabled and is only ever called after
+* detectSimdLevel() confirmed the CPU supports both.
+*/
+
+namespace {
+	// Turns 8 registers of "component k of objects 0..7" into "components 0..7 of object k"
+	inline void transpose8x8(__m256& r0, __m256& r1, __m256& r2, __m256& r3, __m256& r4, __m256& r5, __m256& r6, __m256& r7) {
+		__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+		__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+		__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+		__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+		__m256 t4 = _mm256_unpacklo_ps(r4, r5);
+		__m256 t5 = _mm256_unpackhi_ps(r4, r5);
+		__m256 t6 = _mm256_unpacklo_ps(r6, r7);
+		__m256 t7 = _mm256_unpackhi_ps(r6, r7);
+
+		__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+		r0 = _mm256_permute2f128_ps(s0, s4, 0x20);
+		r1 = _mm256_permute2f128_ps(s1, s5, 0x20);
+		r2 = _mm256_permute2f128_ps(s2, s6, 0x20);
+		r3 = _mm256_permute2f128_ps(s3, s7, 0x20);
+		r4 = _mm256_permute2f128_ps(s0, s4, 0x31);
+		r5 = _mm256_permute2f128_ps(s1, s5, 0x31);
+		r6 = _mm256_permute2f128_ps(s2, s6, 0x31);
+		r7 = _mm256_permute2f128_ps(s3, s7, 0x31);
+	}
+
+	/*
+	* For every 8 bit visibility mask, the lanes to move to the front and how
+	* many of them there are.
+	*/
+	typedef struct CompactionTable {
+		alignas(32) uint32_t permutations[256][8];
+		uint32_t counts[256];
+	} CompactionTable;
+
+	CompactionTable buildCompactionTable() {
+		CompactionTable table{};
+		for (uint32_t mask = 0; mask < 256; mask++) {
+			uint32_t count = 0;
+			for (uint32_t lane = 0; lane < 8; lane++) {
+				if (mask & (1u << lane)) {
+					table.permutations[mask][count++] = lane;
+				}
+			}
+			table.counts[mask] = count;
+		}
+		return table;
+	}
+
+	const CompactionTable& getCompactionTable() {
+		static const CompactionTable table = buildCompactionTable();
+		return table;
+	}
+}
+
+void composeTransformsAVX2(const TransformSoA& transforms, float* matrices) {
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	size_t i = 0;
+	for (; i + 8 <= transforms.count; i += 8) {
+		__m256 x = _mm256_loadu_ps(transforms.rotationX + i);
+		__m256 y = _mm256_loadu_ps(transforms.rotationY + i);
+		__m256 z = _mm256_loadu_ps(transforms.rotationZ + i);
+		__m256 w = _mm256_loadu_ps(transforms.rotationW + i);
+
+		__m256 x2 = _mm256_add_ps(x, x);
+		__m256 y2 = _mm256_add_ps(y, y);
+		__m256 z2 = _mm256_add_ps(z, z);
+
+		__m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+		__m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+		__m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+		__m256 sx = _mm256_loadu_ps(transforms.scaleX + i);
+		__m256 sy = _mm256_loadu_ps(transforms.scaleY + i);
+		__m256 sz = _mm256_loadu_ps(transforms.scaleZ + i);
+
+		// Matrix elements 0..7: the first two columns
+		__m256 e0 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx);
+		__m256 e1 = _mm256_mul_ps(_mm256_add_ps(xy, wz), sx);
+		__m256 e2 = _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx);
+		__m256 e3 = zero;
+		__m256 e4 = _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy);
+		__m256 e5 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy);
+		__m256 e6 = _mm256_mul_ps(_mm256_add_ps(yz, wx), sy);
+		__m256 e7 = zero;
+
+		// Matrix elements 8..15: the last two columns
+		__m256 e8 = _mm256_mul_ps(_mm256_add_ps(xz, wy), sz);
+		__m256 e9 = _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz);
+		__m256 e10 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz);
+		__m256 e11 = zero;
+		__m256 e12 = _mm256_loadu_ps(transforms.positionX + i);
+		__m256 e13 = _mm256_loadu_ps(transforms.positionY + i);
+		__m256 e14 = _mm256_loadu_ps(transforms.positionZ + i);
+		__m256 e15 = one;
+
+		transpose8x8(e0, e1, e2, e3, e4, e5, e6, e7);
+		transpose8x8(e8, e9, e10, e11, e12, e13, e14, e15);
+
+		float* m = matrices + i * 16;
+		_mm256_storeu_ps(m + 0 * 16, e0);
+		_mm256_storeu_ps(m + 0 * 16 + 8, e8);
+		_mm256_storeu_ps(m + 1 * 16, e1);
+		_mm256_storeu_ps(m + 1 * 16 + 8, e9);
+		_mm256_storeu_ps(m + 2 * 16, e2);
+		_mm256_storeu_ps(m + 2 * 16 + 8, e10);
+		_mm256_storeu_ps(m + 3 * 16, e3);
+		_mm256_storeu_ps(m + 3 * 16 + 8, e11);
+		_mm256_storeu_ps(m + 4 * 16, e4);
+		_mm256_storeu_ps(m + 4 * 16 + 8, e12);
+		_mm256_storeu_ps(m + 5 * 16, e5);
+		_mm256_storeu_ps(m + 5 * 16 + 8, e13);
+		_mm256_storeu_ps(m + 6 * 16, e6);
+		_mm256_storeu_ps(m + 6 * 16 + 8, e14);
+		_mm256_storeu_ps(m + 7 * 16, e7);
+		_mm256_storeu_ps(m + 7 * 16 + 8, e15);
+	}
+
+	composeTransformsScalarRange(transforms, i, matrices);
+}
+
+uint32_t cullSpheresAVX2(const BoundingSphereSoA& spheres, const Frustum& frustum, uint32_t* visibleIndices) {
+	const CompactionTable& table = getCompactionTable();
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	uint32_t visibleCount = 0;
+	size_t i = 0;
+	for (; i + 8 <= spheres.count; i += 8) {
+		__m256 cx = _mm256_loadu_ps(spheres.centerX + i);
+		__m256 cy = _mm256_loadu_ps(spheres.centerY + i);
+		__m256 cz = _mm256_loadu_ps(spheres.centerZ + i);
+		__m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(spheres.radius + i), signMask);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const auto& plane : frustum.planes) {
+			__m256 distance = _mm256_fmadd_ps(_mm256_set1_ps(plane[0]), cx,
+				_mm256_fmadd_ps(_mm256_set1_ps(plane[1]), cy,
+				_mm256_fmadd_ps(_mm256_set1_ps(plane[2]), cz, _mm256_set1_ps(plane[3]))));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+
+		// Move the visible indices to the front and store the whole register, only the first "count" lanes matter
+		int mask = _mm256_movemask_ps(inside);
+		__m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), laneOffsets);
+		__m256i permutation = _mm256_load_si256(reinterpret_cast<const __m256i*>(table.permutations[mask]));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(visibleIndices + visibleCount), _mm256_permutevar8x32_epi32(indices, permutation));
+		visibleCount += table.counts[mask];
+	}
+
+	return cullSpheresScalarRange(spheres, frustum, i, visibleIndices, visibleCount);
+}
+#endif
@@ -0,0 +1,110 @@
+#include "tfwi_vulkan_transform_kernels.hpp"
+
+#ifdef TFWI_VULKAN_SIMD_X86
+#include <emmintrin.h>
+
+/*
+* 4 objects per iteration. The matrices are computed component-wise and then
+* transposed, so each register ends up holding one column of one matrix.
+*/
+void composeTransformsSSE2(const TransformSoA& transforms, float* matrices) {
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	size_t i = 0;
+	for (; i + 4 <= transforms.count; i += 4) {
+		__m128 x = _mm_loadu_ps(transforms.rotationX + i);
+		__m128 y = _mm_loadu_ps(transforms.rotationY + i);
+		__m128 z = _mm_loadu_ps(transforms.rotationZ + i);
+		__m128 w = _mm_loadu_ps(transforms.rotationW + i);
+
+		__m128 x2 = _mm_add_ps(x, x);
+		__m128 y2 = _mm_add_ps(y, y);
+		__m128 z2 = _mm_add_ps(z, z);
+
+		__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+		__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+		__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+		__m128 sx = _mm_loadu_ps(transforms.scaleX + i);
+		__m128 sy = _mm_loadu_ps(transforms.scaleY + i);
+		__m128 sz = _mm_loadu_ps(transforms.scaleZ + i);
+
+		__m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+		__m128 c0y = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+		__m128 c0z = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+		__m128 c0w = zero;
+
+		__m128 c1x = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+		__m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+		__m128 c1z = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+		__m128 c1w = zero;
+
+		__m128 c2x = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+		__m128 c2y = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+		__m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+		__m128 c2w = zero;
+
+		__m128 c3x = _mm_loadu_ps(transforms.positionX + i);
+		__m128 c3y = _mm_loadu_ps(transforms.positionY + i);
+		__m128 c3z = _mm_loadu_ps(transforms.positionZ + i);
+		__m128 c3w = one;
+
+		_MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+		_MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+		_MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+		_MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+
+		// After the transpose c<column>x belongs to object 0, c<column>y to object 1 and so on
+		float* m = matrices + i * 16;
+		_mm_storeu_ps(m + 0, c0x);
+		_mm_storeu_ps(m + 4, c1x);
+		_mm_storeu_ps(m + 8, c2x);
+		_mm_storeu_ps(m + 12, c3x);
+		_mm_storeu_ps(m + 16, c0y);
+		_mm_storeu_ps(m + 20, c1y);
+		_mm_storeu_ps(m + 24, c2y);
+		_mm_storeu_ps(m + 28, c3y);
+		_mm_storeu_ps(m + 32, c0z);
+		_mm_storeu_ps(m + 36, c1z);
+		_mm_storeu_ps(m + 40, c2z);
+		_mm_storeu_ps(m + 44, c3z);
+		_mm_storeu_ps(m + 48, c0w);
+		_mm_storeu_ps(m + 52, c1w);
+		_mm_storeu_ps(m + 56, c2w);
+		_mm_storeu_ps(m + 60, c3w);
+	}
+
+	composeTransformsScalarRange(transforms, i, matrices);
+}
+
+uint32_t cullSpheresSSE2(const BoundingSphereSoA& spheres, const Frustum& frustum, uint32_t* visibleIndices) {
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	uint32_t visibleCount = 0;
+	size_t i = 0;
+	for (; i + 4 <= spheres.count; i += 4) {
+		__m128 cx = _mm_loadu_ps(spheres.centerX + i);
+		__m128 cy = _mm_loadu_ps(spheres.centerY + i);
+		__m128 cz = _mm_loadu_ps(spheres.centerZ + i);
+		__m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(spheres.radius + i), signMask);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const auto& plane : frustum.planes) {
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), cx), _mm_mul_ps(_mm_set1_ps(plane[1]), cy)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[2]), cz), _mm_set1_ps(plane[3])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		// SSE2 has no variable permute, so compact branchlessly one lane at a time
+		int mask = _mm_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			visibleIndices[visibleCount] = static_cast<uint32_t>(i) + lane;
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+
+	return cullSpheresScalarRange(spheres, frustum, i, visibleIndices, visibleCount);
+}
+#endif